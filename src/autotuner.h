@@ -0,0 +1,275 @@
+#ifndef AUTOTUNER_H
+#define AUTOTUNER_H
+
+#include "config.h"
+#include "protocol.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <ostream>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <unistd.h>
+
+/**
+ * 参数自动调优：为给定的工作负载（n, N_size, 查询数, 每轮更新量, 更新轮数）选择 (d_1, w, ε, z)
+ *
+ * 不做完整运行，而是对候选网格做短时标定，再按代价模型外推：
+ *   - 每个 (d_1, w, ε)：用一个客户端的完整数据集编码前若干个分区（与Setup同一条路径），
+ *     得到每分区编码 + 掩码耗时、每列聚合耗时与线性系统不相容的比例（编码失败率）
+ *   - 每个 (d_1, ε, z)：以随机 E_total 构建查询快照并执行一批查询，得到每个查询的
+ *     生成 / 服务器 / 解密耗时与快照构建耗时（查询代价与 w 和矩阵内容无关）
+ *
+ * 代价模型（毫秒，b 由 d_1 与 ε 决定）：
+ *   Setup  = n · b · (t_enc + t_agg) + t_rebuild
+ *   Update = 更新轮数 · [n · a · (t_enc + t_agg) + min(b, n · a) · t_rebuild / b]，
+ *            a = b · (1 - (1 - 1/b)^u) 为每个客户端受影响分区数的期望，u 为每轮改动的元素数
+ *   Query  = 查询数 · (t_gen + t_server + t_decrypt)
+ * 编码失败率超过上限或估计内存（见 MFUPSIProtocol::estimate_memory_bytes）超出预算的
+ * 候选不参与选择；其余候选中取 Setup + Update + Query 最小者。
+ *
+ * 标定的耗时为本机实测的墙钟时间（含线程池并行），模型忽略Setup流水线中编码与聚合的重叠。
+ */
+
+class Autotuner {
+public:
+    struct Options {
+        std::vector<size_t> partition_sizes = {128, 256, 512, 1024, 2048};
+        std::vector<size_t> band_widths = {30, 50, 80, 100};
+        std::vector<double> expansion_factors = {0.1, 0.2, 0.3};
+        std::vector<size_t> pir_dimensions = {2, 3};
+        size_t calibration_partitions = 256;   // 每个 (d_1, w, ε) 编码的分区数（0表示全部b个）
+        size_t calibration_queries = 16;       // 每个 (d_1, ε, z) 执行的查询数
+        size_t update_rounds = 1;              // 工作负载中的更新轮数
+        size_t memory_budget_bytes = 0;        // 0 表示物理内存大小
+        double max_failure_rate = 1e-3;        // 允许的分区编码失败率上限
+    };
+
+    struct Result {
+        Config::ExperimentConfig config;
+        MFUPSIProtocol::SetupCalibration setup;
+        bool query_calibrated = false;
+        double rebuild_ms = 0;          // 构建两个查询快照的耗时
+        double query_gen_ms = 0;        // 每个查询
+        double query_server_ms = 0;     // 每个查询（批处理分摊）
+        double query_decrypt_ms = 0;    // 每个查询
+        double setup_ms = 0;            // 以下为代价模型的估计
+        double update_ms = 0;
+        double query_ms = 0;
+        double total_ms = 0;
+        size_t memory_bytes = 0;
+        bool feasible = false;
+        std::string note;               // 不可行的原因
+
+        double failure_rate() const { return rate(setup); }
+    };
+
+    /**
+     * 对 base 的工作负载标定全部候选并估计代价；进度写入 log
+     * base 中除 d_1、w、ε、z 以外的参数（n、N_size、q、N_lwe、线程数等）保持不变
+     */
+    static std::vector<Result> run(const Config::ExperimentConfig& base, const Options& options,
+                                   std::ostream& log) {
+        const size_t budget = options.memory_budget_bytes > 0 ? options.memory_budget_bytes
+                                                              : physical_memory_bytes();
+        std::vector<Result> results;
+
+        // 第一步：编码标定，每个 (d_1, w, ε) 一次
+        std::map<std::tuple<size_t, size_t, double>, MFUPSIProtocol::SetupCalibration> setup_calibrations;
+        for (size_t d1 : options.partition_sizes) {
+            if (base.rlwe_pir && d1 > base.lwe_dimension) continue;
+            for (size_t w : options.band_widths) {
+                if (w >= d1) continue;
+                for (double eps : options.expansion_factors) {
+                    auto cfg = candidate(base, d1, w, eps, base.pir_dimension);
+                    size_t client_bytes = MFUPSIProtocol::estimate_memory_bytes(single_client(cfg));
+                    if (client_bytes > budget) continue;
+                    MFUPSIProtocol protocol(cfg);
+                    auto calibration = protocol.calibrate_setup(options.calibration_partitions);
+                    setup_calibrations[{d1, w, eps}] = calibration;
+                    log << "  编码标定 d_1=" << d1 << " w=" << w << " ε=" << eps
+                        << ": " << calibration.encode_partition_ms << " ms/分区, 失败 "
+                        << calibration.inconsistent << "/" << calibration.partitions << std::endl;
+                }
+            }
+        }
+
+        // 第二步：查询标定，每个 (d_1, ε, z) 一次，只标定至少有一个 w 满足失败率上限的组合
+        struct QueryCalibration {
+            double rebuild_ms, gen_ms, server_ms, decrypt_ms;
+        };
+        std::map<std::tuple<size_t, double, size_t>, QueryCalibration> query_calibrations;
+        for (size_t d1 : options.partition_sizes) {
+            for (double eps : options.expansion_factors) {
+                bool usable = false;
+                for (const auto& entry : setup_calibrations) {
+                    const auto& key = entry.first;
+                    if (std::get<0>(key) == d1 && std::get<2>(key) == eps &&
+                        rate(entry.second) <= options.max_failure_rate) {
+                        usable = true;
+                    }
+                }
+                if (!usable) continue;
+                for (size_t z : options.pir_dimensions) {
+                    auto cfg = candidate(base, d1, options.band_widths.front(), eps, z);
+                    if (MFUPSIProtocol::estimate_memory_bytes(cfg) > budget) continue;
+                    cfg.num_queries = std::max<size_t>(1, options.calibration_queries);
+                    MFUPSIProtocol protocol(cfg);
+                    QueryCalibration calibration{};
+                    {
+                        SilenceOutput silence;
+                        calibration.rebuild_ms = protocol.prepare_query_calibration();
+                        protocol.query_phase();
+                    }
+                    const auto& m = protocol.get_metrics();
+                    double queries = static_cast<double>(std::min(cfg.num_queries, cfg.dataset_size));
+                    calibration.gen_ms = m.query_client_gen_time_ms / queries;
+                    calibration.server_ms = m.query_server_amortized_time_ms;
+                    calibration.decrypt_ms = m.query_client_decrypt_time_ms / queries;
+                    query_calibrations[{d1, eps, z}] = calibration;
+                    log << "  查询标定 d_1=" << d1 << " ε=" << eps << " z=" << z << " (b=" << cfg.num_partitions
+                        << "): " << (calibration.gen_ms + calibration.server_ms + calibration.decrypt_ms)
+                        << " ms/查询, 快照构建 " << calibration.rebuild_ms << " ms" << std::endl;
+                }
+            }
+        }
+
+        // 第三步：组合标定结果，按代价模型估计每个候选
+        for (const auto& entry : setup_calibrations) {
+            size_t d1, w;
+            double eps;
+            std::tie(d1, w, eps) = entry.first;
+            for (size_t z : options.pir_dimensions) {
+                Result r;
+                r.config = candidate(base, d1, w, eps, z);
+                r.setup = entry.second;
+                r.memory_bytes = MFUPSIProtocol::estimate_memory_bytes(r.config);
+
+                auto query = query_calibrations.find({d1, eps, z});
+                if (query != query_calibrations.end()) {
+                    r.query_calibrated = true;
+                    r.rebuild_ms = query->second.rebuild_ms;
+                    r.query_gen_ms = query->second.gen_ms;
+                    r.query_server_ms = query->second.server_ms;
+                    r.query_decrypt_ms = query->second.decrypt_ms;
+                    estimate(r, options);
+                }
+
+                if (r.failure_rate() > options.max_failure_rate) {
+                    r.note = "编码失败率超过上限";
+                } else if (r.memory_bytes > budget) {
+                    r.note = "超出内存预算";
+                } else if (!r.query_calibrated) {
+                    r.note = "未标定查询";
+                } else {
+                    r.feasible = true;
+                }
+                results.push_back(r);
+            }
+        }
+        std::sort(results.begin(), results.end(), [](const Result& a, const Result& b) {
+            if (a.feasible != b.feasible) return a.feasible;
+            return a.total_ms < b.total_ms;
+        });
+        return results;
+    }
+
+    /**
+     * 代价最小的可行候选（run 的结果已按可行性与总代价排序）；无可行候选时返回 nullptr
+     */
+    static const Result* best(const std::vector<Result>& results) {
+        return !results.empty() && results.front().feasible ? &results.front() : nullptr;
+    }
+
+    /**
+     * 打印候选表（可行者在前，按估计总代价升序）
+     */
+    static void report(std::ostream& os, const std::vector<Result>& results) {
+        os << "\n【自动调优候选】" << std::endl;
+        os << "  " << std::right << std::setw(6) << "d_1" << std::setw(5) << "w" << std::setw(6) << "ε"
+           << std::setw(4) << "z" << std::setw(8) << "b" << std::setw(12) << "失败率"
+           << std::setw(12) << "Setup ms" << std::setw(12) << "Update ms" << std::setw(12) << "Query ms"
+           << std::setw(12) << "总计 ms" << std::setw(11) << "内存 MB" << "  备注" << std::endl;
+        for (const auto& r : results) {
+            os << "  " << std::setw(6) << r.config.partition_size << std::setw(5) << r.config.band_width
+               << std::setw(6) << std::fixed << std::setprecision(2) << r.config.expansion_factor
+               << std::setw(4) << r.config.pir_dimension << std::setw(8) << r.config.num_partitions
+               << std::setw(12) << std::scientific << std::setprecision(2) << r.failure_rate()
+               << std::fixed << std::setprecision(1)
+               << std::setw(12) << r.setup_ms << std::setw(12) << r.update_ms << std::setw(12) << r.query_ms
+               << std::setw(12) << r.total_ms << std::setw(11) << r.memory_bytes / (1024.0 * 1024.0)
+               << "  " << r.note << std::endl;
+        }
+    }
+
+private:
+    static Config::ExperimentConfig candidate(const Config::ExperimentConfig& base, size_t d1, size_t w,
+                                              double eps, size_t z) {
+        Config::ExperimentConfig cfg = base;
+        cfg.partition_size = d1;
+        cfg.band_width = w;
+        cfg.expansion_factor = eps;
+        cfg.pir_dimension = z;
+        cfg.encoding_file.clear();
+        cfg.compute_derived_params();
+        return cfg;
+    }
+
+    /**
+     * 编码标定只有一个客户端与服务器矩阵驻留内存（不构建查询快照）
+     */
+    static Config::ExperimentConfig single_client(Config::ExperimentConfig cfg) {
+        cfg.num_clients = 1;
+        cfg.rlwe_pir = false;
+        return cfg;
+    }
+
+    static double rate(const MFUPSIProtocol::SetupCalibration& c) {
+        return c.partitions > 0 ? static_cast<double>(c.inconsistent) / c.partitions : 0.0;
+    }
+
+    static void estimate(Result& r, const Options& options) {
+        const auto& cfg = r.config;
+        const double n = static_cast<double>(cfg.num_clients);
+        const double b = static_cast<double>(cfg.num_partitions);
+        const double per_partition = r.setup.encode_partition_ms + r.setup.aggregate_partition_ms;
+        r.setup_ms = n * b * per_partition + r.rebuild_ms;
+
+        // 与 update_phase 一致：每个客户端每轮添加与删除各 min(N_upd, N_size/100)/2 个元素
+        size_t update_count = std::min(cfg.num_updates, cfg.dataset_size / 100);
+        double u = 2.0 * (update_count / 2);
+        double affected = b * (1.0 - std::pow(1.0 - 1.0 / b, u));
+        double touched = std::min(b, n * affected);
+        r.update_ms = options.update_rounds * (n * affected * per_partition + touched * r.rebuild_ms / b);
+
+        r.query_ms = cfg.num_queries * (r.query_gen_ms + r.query_server_ms + r.query_decrypt_ms);
+        r.total_ms = r.setup_ms + r.update_ms + r.query_ms;
+    }
+
+    static size_t physical_memory_bytes() {
+        long pages = sysconf(_SC_PHYS_PAGES);
+        long page_size = sysconf(_SC_PAGE_SIZE);
+        return pages > 0 && page_size > 0 ? static_cast<size_t>(pages) * page_size : ~size_t(0);
+    }
+
+    /**
+     * 查询标定期间丢弃 query_phase 的控制台输出
+     */
+    class SilenceOutput {
+    public:
+        SilenceOutput() : saved_(std::cout.rdbuf(nullptr)) {}
+        ~SilenceOutput() {
+            std::cout.rdbuf(saved_);
+            std::cout.clear();
+        }
+
+    private:
+        std::streambuf* saved_;
+    };
+};
+
+#endif // AUTOTUNER_H
@@ -0,0 +1,348 @@
+#ifndef BAND_SOLVER_H
+#define BAND_SOLVER_H
+
+#include "utils.h"
+#include "modarith.h"
+#include "instrumentation.h"
+#include <vector>
+#include <memory>
+#include <numeric>
+#include <algorithm>
+
+/**
+ * 带状稀疏线性系统求解器（RB-OKVS风格，有限域Z_q上）
+ *
+ * RandVector生成的每一行最多只有w个非零元素，且全部落在一个连续窗口
+ * [start, start + w) 内。因此无需构造 m × d_1 的稠密矩阵：
+ *   - 每行只存储 (起始偏移 start, w宽系数窗口, 右侧常数 rhs)
+ *   - 按start对行排序后，主元行只会影响起始偏移不超过主元列的后续行，
+ *     且消元产生的填充始终落在目标行自身的窗口内
+ *
+ * 复杂度：O(m · w²)，与d_1无关；而稠密高斯消元为 O(m · d_1²)
+ *
+ * 系数表示：
+ *   RandVector的系数只取0/1，因此每行初始以w位的位图存储
+ *   （w=80或100时仅需两个uint64_t字）。由于q是奇素数，行相减后系数
+ *   不再是0/1，不能用XOR代替Z_q减法；位图行在第一次被消元修改时才
+ *   展开为Z_q系数窗口（"稠密行"）。
+ *   - 位图行的主元恒为1，无需求逆和归一化
+ *   - 目标行在主元列的位为0时，直接跳过（一次字操作）
+ *   - 主元行为位图行时，消元只需沿置位位做减法，不需要模乘
+ *   只有"稠密行 - 因子 × 稠密行"才需要模乘
+ */
+
+class BandSolver {
+public:
+    using VectorType = std::vector<uint64_t>;
+
+    /**
+     * 带状线性系统 M * e = y (mod q)
+     * 第i行的位图为 bits[i*words, (i+1)*words)，第t位对应列 start[i] + t
+     */
+    struct System {
+        size_t num_vars = 0;             // 变量个数 d_1
+        size_t band_width = 0;           // 带宽 w
+        size_t words_per_row = 0;        // ceil(w / 64)
+        std::vector<size_t> start;       // 每行窗口的起始列
+        std::vector<uint64_t> bits;      // m × words 的系数位图
+        VectorType rhs;                  // 右侧常数 y
+
+        // 消元过程中惰性展开的Z_q系数窗口（m × w，只写入稠密行）
+        std::unique_ptr<uint64_t[]> coeffs;
+        size_t coeffs_capacity = 0;
+        std::vector<uint8_t> dense;      // 该行是否已展开
+
+        // 求解过程的簿记（排序后的行序、主元列与主元值、批量求逆的前缀积）
+        std::vector<size_t> order;
+        std::vector<size_t> pivot_col;
+        VectorType pivot_val;
+        VectorType prefix;
+
+        /**
+         * 清空系统并设置维度，保留已分配的容量
+         */
+        void reset(size_t d1, size_t w, size_t expected_rows = 0) {
+            num_vars = d1;
+            band_width = w;
+            words_per_row = (w + 63) / 64;
+            start.clear();
+            bits.clear();
+            rhs.clear();
+            start.reserve(expected_rows);
+            bits.reserve(expected_rows * words_per_row);
+            rhs.reserve(expected_rows);
+        }
+
+        size_t num_rows() const { return start.size(); }
+
+        /**
+         * 当前线程的可复用系统：各缓冲区只增不减，分区规模稳定后 reset + solve 不再分配堆内存
+         */
+        static System& local() {
+            thread_local System sys;
+            return sys;
+        }
+
+        /**
+         * 追加一行，返回该行的位图指针（words_per_row个字，已置零）供调用者填写
+         */
+        uint64_t* add_row(size_t row_start, uint64_t row_rhs) {
+            start.push_back(row_start);
+            rhs.push_back(row_rhs);
+            bits.resize(bits.size() + words_per_row, 0);
+            return bits.data() + bits.size() - words_per_row;
+        }
+    };
+
+    /**
+     * 求解带状系统，结果写入 result（长度d_1，自由变量取0）
+     *
+     * 算法：
+     *   1) 按窗口起始偏移对行排序
+     *   2) 依序处理每一行：在窗口内找首个非零元素作为主元，
+     *      然后对所有 start <= 主元列 的后续行执行
+     *      Row_j = pivot * Row_j - a_j[col] * Row_p（无除法消元）
+     *      （起始偏移更大的行在该列必为0，不需要处理）
+     *   3) 对所有主元做一次批量求逆，然后逆序回代
+     *
+     * 注意：求解过程会原地修改 sys 的系数和右侧常数
+     *
+     * 返回：系统是否相容（存在全零行但右侧非零时返回false，
+     *       此时其余方程仍被满足）
+     */
+    static bool solve(System& sys, uint64_t q, VectorType& result) {
+        result.resize(sys.num_vars);
+        return solve(sys, q, result.data());
+    }
+
+    /**
+     * 同上，结果直接写入调用者提供的 d_1 个字（如编码矩阵的一列），不分配结果向量
+     */
+    static bool solve(System& sys, uint64_t q, uint64_t* result) {
+        return ModArith::dispatch(q, [&](const auto& mod) {
+            return solve(sys, mod, result);
+        });
+    }
+
+    template <typename Mod>
+    static bool solve(System& sys, const Mod& mod, VectorType& result) {
+        result.resize(sys.num_vars);
+        return solve(sys, mod, result.data());
+    }
+
+    template <typename Mod>
+    static bool solve(System& sys, const Mod& mod, uint64_t* result) {
+        const size_t m = sys.num_rows();
+        const size_t d1 = sys.num_vars;
+        const size_t w = sys.band_width;
+        const size_t words = sys.words_per_row;
+
+        std::fill_n(result, d1, 0);
+        if (m == 0) {
+            return true;
+        }
+        MFUPSI_SCOPE(BandSolve);
+        MFUPSI_INSTRUMENT_ONLY(uint64_t modmuls = 0;)
+
+        // 稠密窗口缓冲区：按需增长，不初始化（只有展开后的行会被读取）
+        if (sys.coeffs_capacity < m * w) {
+            sys.coeffs.reset(new uint64_t[m * w]);
+            sys.coeffs_capacity = m * w;
+        }
+        sys.dense.assign(m, 0);
+
+        // ============ 第一步：按起始偏移排序 ============
+        // 起始偏移相同时按行号排序，与稳定排序结果相同且不需要临时缓冲区
+        std::vector<size_t>& order = sys.order;
+        order.resize(m);
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return sys.start[a] != sys.start[b] ? sys.start[a] < sys.start[b] : a < b;
+        });
+
+        // pivot_col[k]: 排序后第k行的主元列（无主元时为d1）
+        std::vector<size_t>& pivot_col = sys.pivot_col;
+        pivot_col.assign(m, d1);
+        // pivot_val[k]: 主元值（位图行恒为1），回代前统一批量求逆
+        VectorType& pivot_val = sys.pivot_val;
+        pivot_val.assign(m, 1);
+        bool consistent = true;
+
+        // ============ 第二步：带内前向消元（无除法） ============
+        for (size_t k = 0; k < m; k++) {
+            const size_t p = order[k];
+            const uint64_t* bits_p = sys.bits.data() + p * words;
+            const uint64_t* row_p = sys.coeffs.get() + p * w;
+            const bool dense_p = sys.dense[p];
+            const size_t s_p = sys.start[p];
+
+            // --- 2.1 在窗口内寻找主元 ---
+            size_t offset = dense_p ? first_nonzero(row_p, w) : first_set_bit(bits_p, words, w);
+            if (offset == w) {
+                // 全零行：0 = rhs
+                if (sys.rhs[p] != 0) {
+                    consistent = false;
+                }
+                continue;
+            }
+            const size_t col = s_p + offset;
+            const uint64_t pivot = dense_p ? row_p[offset] : 1;
+            pivot_col[k] = col;
+            pivot_val[k] = pivot;
+
+            // --- 2.2 消去后续行在主元列上的元素 ---
+            // Row_r = pivot * Row_r - factor * Row_p，避免逐主元求逆
+            for (size_t k2 = k + 1; k2 < m; k2++) {
+                const size_t r = order[k2];
+                const size_t s_r = sys.start[r];
+                if (s_r > col) {
+                    break;  // 排序保证之后的行都不覆盖该列
+                }
+                uint64_t* row_r = sys.coeffs.get() + r * w;
+                const uint64_t* bits_r = sys.bits.data() + r * words;
+                const size_t shift = s_r - s_p;  // 主元行列t对应目标行列 t - shift
+                const size_t target = col - s_r;
+
+                uint64_t factor;
+                if (sys.dense[r]) {
+                    factor = row_r[target];
+                    if (factor == 0) continue;
+                    if (pivot != 1) {
+                        for (size_t t = 0; t < w; t++) {
+                            if (row_r[t] == 0) continue;
+                            row_r[t] = mod.mul(row_r[t], pivot);
+                            MFUPSI_INSTRUMENT_ONLY(modmuls++;)
+                        }
+                        sys.rhs[r] = mod.mul(sys.rhs[r], pivot);
+                        MFUPSI_INSTRUMENT_ONLY(modmuls++;)
+                    }
+                } else {
+                    // 位图行：因子只可能是0或1，展开时直接按位选择 pivot 或 0
+                    if (!test_bit(bits_r, target)) continue;
+                    expand_bits(bits_r, w, pivot, row_r);
+                    if (pivot != 1) {
+                        sys.rhs[r] = mod.mul(sys.rhs[r], pivot);
+                        MFUPSI_INSTRUMENT_ONLY(modmuls++;)
+                    }
+                    sys.dense[r] = 1;
+                    factor = 1;
+                }
+
+                if (dense_p) {
+                    if (factor == 1) {
+                        for (size_t t = offset; t < w; t++) {
+                            row_r[t - shift] = mod.sub(row_r[t - shift], row_p[t]);
+                        }
+                    } else {
+                        for (size_t t = offset; t < w; t++) {
+                            if (row_p[t] == 0) continue;
+                            uint64_t term = mod.mul(factor, row_p[t]);
+                            row_r[t - shift] = mod.sub(row_r[t - shift], term);
+                            MFUPSI_INSTRUMENT_ONLY(modmuls++;)
+                        }
+                    }
+                } else {
+                    // 主元行为位图：只在置位位置减去factor
+                    for (size_t wi = offset / 64; wi < words; wi++) {
+                        uint64_t word = bits_p[wi];
+                        if (wi == offset / 64) {
+                            word &= ~0ULL << (offset % 64);
+                        }
+                        while (word) {
+                            size_t t = wi * 64 + __builtin_ctzll(word);
+                            row_r[t - shift] = mod.sub(row_r[t - shift], factor);
+                            word &= word - 1;
+                        }
+                    }
+                }
+
+                uint64_t term = (factor == 1) ? sys.rhs[p] : mod.mul(factor, sys.rhs[p]);
+                sys.rhs[r] = mod.sub(sys.rhs[r], term);
+                MFUPSI_INSTRUMENT_ONLY(modmuls += factor != 1;)
+            }
+        }
+
+        // 所有主元的逆只需一次模幂（Montgomery批量求逆）
+        ModArith::batch_inverse(mod, pivot_val, sys.prefix);
+        MFUPSI_INSTRUMENT_ONLY(modmuls += 3 * m;)
+
+        // ============ 第三步：逆序回代 ============
+        for (size_t k = m; k-- > 0;) {
+            const size_t col = pivot_col[k];
+            if (col == d1) continue;
+
+            const size_t p = order[k];
+            const size_t s_p = sys.start[p];
+            const size_t offset = col - s_p;
+
+            uint64_t sum = sys.rhs[p];
+            if (sys.dense[p]) {
+                const uint64_t* row_p = sys.coeffs.get() + p * w;
+                for (size_t t = offset + 1; t < w; t++) {
+                    if (row_p[t] == 0) continue;
+                    uint64_t term = mod.mul(row_p[t], result[s_p + t]);
+                    sum = mod.sub(sum, term);
+                    MFUPSI_INSTRUMENT_ONLY(modmuls++;)
+                }
+                if (pivot_val[k] != 1) {
+                    sum = mod.mul(sum, pivot_val[k]);
+                    MFUPSI_INSTRUMENT_ONLY(modmuls++;)
+                }
+            } else {
+                // 位图行：系数为1，直接减去已求解变量
+                const uint64_t* bits_p = sys.bits.data() + p * words;
+                for (size_t wi = 0; wi < words; wi++) {
+                    uint64_t word = bits_p[wi];
+                    while (word) {
+                        size_t t = wi * 64 + __builtin_ctzll(word);
+                        if (t > offset) {
+                            sum = mod.sub(sum, result[s_p + t]);
+                        }
+                        word &= word - 1;
+                    }
+                }
+            }
+            result[col] = sum;
+        }
+
+        // 字节按位图行、右侧常数与起始偏移计（不含惰性展开的稠密窗口）
+        MFUPSI_COUNT(BandSolve, m, m * (words * 8 + 16), modmuls);
+        return consistent;
+    }
+
+private:
+    static bool test_bit(const uint64_t* bits, size_t t) {
+        return (bits[t / 64] >> (t % 64)) & 1;
+    }
+
+    /**
+     * 位图中第一个置位的位置（无置位时返回w）
+     */
+    static size_t first_set_bit(const uint64_t* bits, size_t words, size_t w) {
+        for (size_t wi = 0; wi < words; wi++) {
+            if (bits[wi]) {
+                return wi * 64 + __builtin_ctzll(bits[wi]);
+            }
+        }
+        return w;
+    }
+
+    static size_t first_nonzero(const uint64_t* row, size_t w) {
+        size_t t = 0;
+        while (t < w && row[t] == 0) {
+            t++;
+        }
+        return t;
+    }
+
+    /**
+     * 将位图展开为Z_q系数窗口：置位处取value，其余为0（按位选择，无乘法）
+     */
+    static void expand_bits(const uint64_t* bits, size_t w, uint64_t value, uint64_t* row) {
+        for (size_t t = 0; t < w; t++) {
+            row[t] = value & (0 - static_cast<uint64_t>(test_bit(bits, t)));
+        }
+    }
+};
+
+#endif // BAND_SOLVER_H
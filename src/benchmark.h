@@ -0,0 +1,361 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * 基准测试框架：命令行选项、样本统计与机器可读的结果输出
+ *
+ * 每个配置先运行 warmup 次（不记录），再运行 repetitions 次，
+ * 每次运行的各阶段耗时与逐操作样本（如每个查询的生成耗时）汇总为一个指标的样本集，
+ * 报告 count/mean/stddev/min/p50/p95/p99/max。
+ * 所有耗时均由 Utils::Timer（steady_clock，纳秒分辨率）测得，单位 ms。
+ */
+
+class Benchmark {
+public:
+    /**
+     * 命令行选项
+     */
+    struct Options {
+        std::vector<std::string> configs;   // 配置名（test / default / performance）
+        size_t warmup = 0;                  // 每个配置的预热次数
+        size_t repetitions = 1;             // 每个配置的计量次数
+        std::string format = "csv";         // csv 或 json
+        std::string output;                 // 结果文件路径（空则按时间戳命名）
+        std::string encoding_dir;           // 非空时Setup后持久化 global_encoding 到该目录并热重启
+        bool help = false;
+
+        // 工作负载覆盖（0 表示使用配置中的值）
+        size_t clients = 0;
+        size_t dataset_size = 0;
+        size_t queries = 0;
+        size_t updates = 0;
+        bool concurrent_updates = false;    // Query阶段期间后台持续执行Update
+
+        // 自动调优模式（见 autotuner.h）：对第一个配置的工作负载搜索 (d_1, w, ε, z)
+        bool autotune = false;
+        size_t tune_partitions = 256;       // 每个 (d_1, w, ε) 标定的分区数（0表示全部）
+        size_t tune_queries = 16;           // 每个 (d_1, ε, z) 标定的查询数
+        size_t update_rounds = 1;           // 代价模型中的更新轮数
+        size_t memory_budget_mb = 0;        // 内存预算（0表示物理内存）
+        double max_failure_rate = 1e-3;     // 分区编码失败率上限
+        
+        // 联网部署（见 transport.h）：服务器与客户端在不同进程中运行，只运行第一个配置一次
+        std::string serve;                  // 非空时作为服务器进程监听该端口
+        std::vector<std::string> connect;   // 非空时作为客户端进程依次连接各服务器分片的 HOST:PORT
+        size_t shard = 0;                   // 服务器进程的分片编号 K 与分片数 S（--shard K/S）
+        size_t num_shards = 1;
+        size_t client_first = 0;            // 客户端进程托管的客户端范围 [first, last)
+        size_t client_last = 0;             // 0 表示到n为止
+        uint64_t key_seed = 0;              // 全局密钥种子（客户端分布在多个进程时必须指定）
+        
+        bool networked() const { return !serve.empty() || !connect.empty(); }
+
+        /**
+         * 解析 argv；参数非法时抛出 std::invalid_argument
+         */
+        static Options parse(int argc, char** argv) {
+            Options options;
+            for (int i = 1; i < argc; i++) {
+                std::string arg = argv[i];
+                auto value = [&]() -> std::string {
+                    if (i + 1 >= argc) {
+                        throw std::invalid_argument("missing value for " + arg);
+                    }
+                    return argv[++i];
+                };
+                if (arg == "-h" || arg == "--help") {
+                    options.help = true;
+                } else if (arg == "-c" || arg == "--config") {
+                    std::stringstream list(value());
+                    std::string name;
+                    while (std::getline(list, name, ',')) {
+                        if (!name.empty()) options.configs.push_back(name);
+                    }
+                } else if (arg == "-w" || arg == "--warmup") {
+                    options.warmup = parse_count(arg, value());
+                } else if (arg == "-r" || arg == "--reps") {
+                    options.repetitions = parse_count(arg, value());
+                    if (options.repetitions == 0) {
+                        throw std::invalid_argument("--reps must be positive");
+                    }
+                } else if (arg == "-f" || arg == "--format") {
+                    options.format = value();
+                    if (options.format != "csv" && options.format != "json") {
+                        throw std::invalid_argument("unknown format: " + options.format);
+                    }
+                } else if (arg == "-o" || arg == "--output") {
+                    options.output = value();
+                } else if (arg == "-e" || arg == "--encoding-dir") {
+                    options.encoding_dir = value();
+                } else if (arg == "--clients") {
+                    options.clients = parse_count(arg, value());
+                } else if (arg == "--dataset-size") {
+                    options.dataset_size = parse_count(arg, value());
+                } else if (arg == "--queries") {
+                    options.queries = parse_count(arg, value());
+                } else if (arg == "--updates") {
+                    options.updates = parse_count(arg, value());
+                } else if (arg == "--concurrent-updates") {
+                    options.concurrent_updates = true;
+                } else if (arg == "-t" || arg == "--autotune") {
+                    options.autotune = true;
+                } else if (arg == "--tune-partitions") {
+                    options.tune_partitions = parse_count(arg, value());
+                } else if (arg == "--tune-queries") {
+                    options.tune_queries = parse_count(arg, value());
+                } else if (arg == "--update-rounds") {
+                    options.update_rounds = parse_count(arg, value());
+                } else if (arg == "--memory-budget") {
+                    options.memory_budget_mb = parse_count(arg, value());
+                } else if (arg == "--max-failure") {
+                    options.max_failure_rate = parse_rate(arg, value());
+                } else if (arg == "--serve") {
+                    options.serve = value();
+                } else if (arg == "--connect") {
+                    std::stringstream list(value());
+                    std::string endpoint;
+                    while (std::getline(list, endpoint, ',')) {
+                        if (!endpoint.empty()) options.connect.push_back(endpoint);
+                    }
+                    if (options.connect.empty()) {
+                        throw std::invalid_argument("--connect needs at least one HOST:PORT");
+                    }
+                } else if (arg == "--shard") {
+                    std::string shard = value();
+                    size_t slash = shard.find('/');
+                    if (slash == std::string::npos) {
+                        throw std::invalid_argument("--shard must be K/S");
+                    }
+                    options.shard = parse_count(arg, shard.substr(0, slash));
+                    options.num_shards = parse_count(arg, shard.substr(slash + 1));
+                    if (options.shard >= options.num_shards) {
+                        throw std::invalid_argument("--shard index must be less than the number of shards");
+                    }
+                } else if (arg == "--client-range") {
+                    std::string range = value();
+                    size_t colon = range.find(':');
+                    if (colon == std::string::npos) {
+                        throw std::invalid_argument("--client-range must be FIRST:LAST");
+                    }
+                    options.client_first = parse_count(arg, range.substr(0, colon));
+                    options.client_last = parse_count(arg, range.substr(colon + 1));
+                    if (options.client_last <= options.client_first) {
+                        throw std::invalid_argument("--client-range is empty");
+                    }
+                } else if (arg == "--key-seed") {
+                    options.key_seed = parse_count(arg, value());
+                } else {
+                    throw std::invalid_argument("unknown option: " + arg);
+                }
+            }
+            if (!options.serve.empty() && !options.connect.empty()) {
+                throw std::invalid_argument("--serve and --connect are mutually exclusive");
+            }
+            if (options.serve.empty() && options.num_shards != 1) {
+                throw std::invalid_argument("--shard requires --serve");
+            }
+            if (!options.connect.empty()) {
+                options.num_shards = options.connect.size();
+            }
+            if (options.networked() && options.autotune) {
+                throw std::invalid_argument("--autotune cannot be combined with --serve/--connect");
+            }
+            if (options.configs.empty()) {
+                if (options.networked()) {
+                    options.configs = {"test"};
+                } else if (options.autotune) {
+                    options.configs = {"default"};
+                } else {
+                    options.configs = {"test", "default"};
+                }
+            }
+            return options;
+        }
+
+        static void print_usage(std::ostream& os, const char* program) {
+            os << "用法: " << program << " [选项]\n"
+               << "  -c, --config NAME[,NAME...]  运行的配置（test, default, performance；默认 test,default）\n"
+               << "  -w, --warmup N               每个配置的预热次数（默认 0）\n"
+               << "  -r, --reps N                 每个配置的计量次数（默认 1）\n"
+               << "  -f, --format csv|json        结果文件格式（默认 csv）\n"
+               << "  -o, --output PATH            结果文件路径（默认 results_<时间戳>.<格式>）\n"
+               << "  -e, --encoding-dir DIR       Setup后将 global_encoding 写入 DIR/global_<配置>.mfmat 并由映射热重启\n"
+               << "      --clients N              覆盖客户端数 n\n"
+               << "      --dataset-size N         覆盖每个客户端的数据集大小 N_size\n"
+               << "      --queries N              覆盖查询数\n"
+               << "      --updates N              覆盖每个客户端每轮的更新量\n"
+               << "      --concurrent-updates     Query阶段期间由后台线程持续执行Update（查询读快照）\n"
+               << "  -t, --autotune               对第一个配置的工作负载自动选择 d_1, w, ε, z（默认配置 default）\n"
+               << "      --tune-partitions N      每个 (d_1, w, ε) 标定的分区数（默认 256，0 表示全部）\n"
+               << "      --tune-queries N         每个 (d_1, ε, z) 标定的查询数（默认 16）\n"
+               << "      --update-rounds N        代价模型中的更新轮数（默认 1）\n"
+               << "      --memory-budget MB       内存预算（默认为物理内存）\n"
+               << "      --max-failure RATE       允许的分区编码失败率（默认 0.001）\n"
+               << "      --serve PORT             作为服务器进程监听 PORT（联网部署，默认配置 test）\n"
+               << "      --shard K/S              服务器进程只持有 S 个分片中的第 K 个（默认 0/1）\n"
+               << "      --connect HOST:PORT[,...] 作为客户端进程连接服务器，多个地址按分片顺序给出\n"
+               << "      --client-range A:B       客户端进程托管的客户端 [A, B)（默认全部；含客户端0的进程负责查询）\n"
+               << "      --key-seed N             全局密钥种子（客户端分布在多个进程时各进程须一致）\n"
+               << "  -h, --help                   显示本帮助\n";
+        }
+
+    private:
+        static double parse_rate(const std::string& option, const std::string& text) {
+            char* end = nullptr;
+            double x = std::strtod(text.c_str(), &end);
+            if (text.empty() || *end != '\0' || !(x >= 0.0 && x <= 1.0)) {
+                throw std::invalid_argument("invalid value for " + option + ": " + text);
+            }
+            return x;
+        }
+
+        static size_t parse_count(const std::string& option, const std::string& text) {
+            char* end = nullptr;
+            unsigned long long n = std::strtoull(text.c_str(), &end, 10);
+            if (text.empty() || *end != '\0' || text[0] == '-') {
+                throw std::invalid_argument("invalid value for " + option + ": " + text);
+            }
+            return static_cast<size_t>(n);
+        }
+    };
+
+    /**
+     * 一组样本的统计量（分位数按相邻秩线性插值）
+     */
+    struct Summary {
+        size_t count = 0;
+        double mean = 0, stddev = 0, min = 0, p50 = 0, p95 = 0, p99 = 0, max = 0;
+
+        static Summary of(std::vector<double> samples) {
+            Summary s;
+            s.count = samples.size();
+            if (samples.empty()) return s;
+            std::sort(samples.begin(), samples.end());
+            double sum = 0;
+            for (double x : samples) sum += x;
+            s.mean = sum / s.count;
+            double sq = 0;
+            for (double x : samples) sq += (x - s.mean) * (x - s.mean);
+            s.stddev = s.count > 1 ? std::sqrt(sq / (s.count - 1)) : 0.0;
+            s.min = samples.front();
+            s.max = samples.back();
+            s.p50 = percentile(samples, 0.50);
+            s.p95 = percentile(samples, 0.95);
+            s.p99 = percentile(samples, 0.99);
+            return s;
+        }
+
+    private:
+        static double percentile(const std::vector<double>& sorted, double p) {
+            double rank = p * (sorted.size() - 1);
+            size_t lo = static_cast<size_t>(rank);
+            size_t hi = std::min(lo + 1, sorted.size() - 1);
+            return sorted[lo] + (rank - lo) * (sorted[hi] - sorted[lo]);
+        }
+    };
+
+    /**
+     * 一个配置的所有指标：按首次出现的顺序保存各指标的样本
+     */
+    class Run {
+    public:
+        Run(std::string name, std::vector<std::pair<std::string, std::string>> params)
+            : name_(std::move(name)), params_(std::move(params)) {}
+
+        void add(const std::string& metric, const std::string& unit, double value) {
+            find(metric, unit).push_back(value);
+        }
+
+        void add(const std::string& metric, const std::string& unit, const std::vector<double>& values) {
+            auto& samples = find(metric, unit);
+            samples.insert(samples.end(), values.begin(), values.end());
+        }
+
+        const std::string& name() const { return name_; }
+        const std::vector<std::pair<std::string, std::string>>& params() const { return params_; }
+
+        struct Metric {
+            std::string name;
+            std::string unit;
+            std::vector<double> samples;
+        };
+        const std::vector<Metric>& metrics() const { return metrics_; }
+
+    private:
+        std::string name_;
+        std::vector<std::pair<std::string, std::string>> params_;
+        std::vector<Metric> metrics_;
+
+        std::vector<double>& find(const std::string& metric, const std::string& unit) {
+            for (auto& m : metrics_) {
+                if (m.name == metric) return m.samples;
+            }
+            metrics_.push_back({metric, unit, {}});
+            return metrics_.back().samples;
+        }
+    };
+
+    /**
+     * CSV：单一表头，每个 (配置, 指标) 一行
+     */
+    static void write_csv(std::ostream& os, const std::vector<Run>& runs) {
+        if (runs.empty()) return;
+        os << "config";
+        for (const auto& param : runs.front().params()) os << "," << param.first;
+        os << ",metric,unit,count,mean,stddev,min,p50,p95,p99,max\n";
+        os << std::setprecision(9);
+        for (const auto& run : runs) {
+            for (const auto& metric : run.metrics()) {
+                Summary s = Summary::of(metric.samples);
+                os << run.name();
+                for (const auto& param : run.params()) os << "," << param.second;
+                os << "," << metric.name << "," << metric.unit << "," << s.count
+                   << "," << s.mean << "," << s.stddev << "," << s.min
+                   << "," << s.p50 << "," << s.p95 << "," << s.p99 << "," << s.max << "\n";
+            }
+        }
+    }
+
+    /**
+     * JSON：{"runs": [{"config", "params", "metrics": {name: {unit, count, ...}}}]}
+     */
+    static void write_json(std::ostream& os, const std::vector<Run>& runs) {
+        os << std::setprecision(9);
+        os << "{\n  \"runs\": [";
+        for (size_t r = 0; r < runs.size(); r++) {
+            const auto& run = runs[r];
+            os << (r ? "," : "") << "\n    {\n      \"config\": \"" << run.name() << "\",\n      \"params\": {";
+            for (size_t i = 0; i < run.params().size(); i++) {
+                const auto& param = run.params()[i];
+                os << (i ? ", " : "") << "\"" << param.first << "\": " << param.second;
+            }
+            os << "},\n      \"metrics\": {";
+            for (size_t i = 0; i < run.metrics().size(); i++) {
+                const auto& metric = run.metrics()[i];
+                Summary s = Summary::of(metric.samples);
+                os << (i ? "," : "") << "\n        \"" << metric.name << "\": {\"unit\": \"" << metric.unit
+                   << "\", \"count\": " << s.count << ", \"mean\": " << s.mean
+                   << ", \"stddev\": " << s.stddev << ", \"min\": " << s.min
+                   << ", \"p50\": " << s.p50 << ", \"p95\": " << s.p95
+                   << ", \"p99\": " << s.p99 << ", \"max\": " << s.max << "}";
+            }
+            os << "\n      }\n    }";
+        }
+        os << "\n  ]\n}\n";
+    }
+};
+
+#endif // BENCHMARK_H
@@ -6,6 +6,8 @@
 #include <cmath>
 #include <numeric>
 #include <limits>
+#include <stdexcept>
+#include <string>
 
 /**
  * 全局参数配置
@@ -26,6 +28,15 @@ public:
         size_t lwe_dimension;    // N_lwe: LWE维度
         uint64_t modulus;        // q: 有限域模数
         size_t band_width;       // w: 带宽参数
+        size_t num_threads;      // 并行编码线程数（0表示使用全部硬件线程）
+        size_t query_batch_size; // 服务器单次数据库扫描处理的查询数
+        size_t setup_chunk_partitions; // Setup流水线中每个上传分块包含的分区（列）数
+        size_t setup_queue_depth;      // 客户端与服务器之间在途上传轮数的上限（每轮为各客户端同一列区间的分块）
+        bool rlwe_pir;           // PIR查询使用RLWE/RGSW密文（false时为明文选择向量基线）
+        std::string encoding_file; // 非空时Setup后将 global_encoding 写入该文件并由映射热重启服务器
+        uint64_t key_seed = 0;     // 非0时全局密钥由该种子派生（联网部署中各客户端进程共用）
+        size_t num_shards = 1;     // 服务器分片数（联网部署中每个分片一个服务器进程，见 shard_map.h）
+        bool concurrent_updates = false; // Query阶段期间由后台线程持续执行Update轮次（查询读快照）
         
         // 派生参数（自动计算）
         size_t num_partitions;   // b: 分区总数 = ceil((1+epsilon)*n_size*n/d_1)
@@ -55,6 +66,11 @@ public:
         cfg.lwe_dimension = 1024;
         cfg.modulus = std::numeric_limits<uint64_t>::max() - 58;  // 接近2^64的最大值 - 59
         cfg.band_width = 80;  // w: 带状矩阵带宽
+        cfg.num_threads = 0;
+        cfg.query_batch_size = 64;
+        cfg.setup_chunk_partitions = 64;
+        cfg.setup_queue_depth = 4;
+        cfg.rlwe_pir = true;
         cfg.compute_derived_params();
         return cfg;
     }
@@ -72,6 +88,11 @@ public:
         cfg.lwe_dimension = 512;
         cfg.modulus = (1ULL << 32) - 5;  // 较小模数以加快测试
         cfg.band_width = 30;
+        cfg.num_threads = 0;
+        cfg.query_batch_size = 64;
+        cfg.setup_chunk_partitions = 64;
+        cfg.setup_queue_depth = 4;
+        cfg.rlwe_pir = true;
         cfg.compute_derived_params();
         return cfg;
     }
@@ -89,9 +110,22 @@ public:
         cfg.lwe_dimension = 2048;
         cfg.modulus = std::numeric_limits<uint64_t>::max() - 58;
         cfg.band_width = 100;
+        cfg.num_threads = 0;
+        cfg.query_batch_size = 64;
+        cfg.setup_chunk_partitions = 64;
+        cfg.setup_queue_depth = 4;
+        cfg.rlwe_pir = true;
         cfg.compute_derived_params();
         return cfg;
     }
+    
+    // 按名称获取配置（命令行选择），名称未知时抛出 std::invalid_argument
+    static ExperimentConfig get_config(const std::string& name) {
+        if (name == "test") return get_test_config();
+        if (name == "default") return get_default_config();
+        if (name == "performance") return get_performance_config();
+        throw std::invalid_argument("unknown config: " + name);
+    }
 };
 
 #endif // CONFIG_H
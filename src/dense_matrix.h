@@ -0,0 +1,234 @@
+#ifndef DENSE_MATRIX_H
+#define DENSE_MATRIX_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <utility>
+
+/**
+ * 连续存储的稠密矩阵（有限域元素，uint64_t）
+ *
+ * 替代 std::vector<std::vector<uint64_t>>：
+ *   - 整个矩阵只有一块64字节对齐的缓冲区，没有逐行堆分配和指针跳转
+ *   - 可选行主序/列主序布局。分区编码 E_i[:, j] 天然是列，
+ *     列主序下写入一个分区就是一次连续的memcpy
+ *   - row()/col() 返回（可能带步长的）视图，布局匹配时为连续视图
+ *   - 缓冲区也可以来自外部（如 matrix_file.h 的文件映射），此时矩阵只持有其引用
+ */
+
+/**
+ * 带步长的一维视图：第i个元素位于 ptr[i * stride]
+ */
+template <typename T>
+class StridedSpan {
+public:
+    StridedSpan(T* ptr, size_t size, size_t stride) : ptr_(ptr), size_(size), stride_(stride) {}
+
+    T& operator[](size_t i) const { return ptr_[i * stride_]; }
+    size_t size() const { return size_; }
+    size_t stride() const { return stride_; }
+    bool is_contiguous() const { return stride_ == 1; }
+    T* data() const { return ptr_; }
+
+private:
+    T* ptr_;
+    size_t size_;
+    size_t stride_;
+};
+
+class DenseMatrix {
+public:
+    enum class Layout { RowMajor, ColMajor };
+
+    static constexpr size_t kAlignment = 64;
+
+    DenseMatrix() = default;
+
+    /**
+     * 创建 rows × cols 的零矩阵
+     */
+    DenseMatrix(size_t rows, size_t cols, Layout layout = Layout::ColMajor)
+        : rows_(rows), cols_(cols), layout_(layout) {
+        allocate();
+        if (size() > 0) {
+            std::memset(data_, 0, size() * sizeof(uint64_t));
+        }
+    }
+
+    /**
+     * 创建不初始化内容的矩阵，供随后会被完整覆盖的输出使用（省去一次清零）
+     */
+    static DenseMatrix uninitialized(size_t rows, size_t cols, Layout layout = Layout::ColMajor) {
+        DenseMatrix M;
+        M.rows_ = rows;
+        M.cols_ = cols;
+        M.layout_ = layout;
+        M.allocate();
+        return M;
+    }
+
+    /**
+     * 使用外部缓冲区的矩阵：data 的生命周期由 storage 保证，矩阵销毁时只释放该引用。
+     * 拷贝得到的是普通的堆内存副本
+     */
+    static DenseMatrix external(uint64_t* data, size_t rows, size_t cols, Layout layout,
+                                std::shared_ptr<void> storage) {
+        DenseMatrix M;
+        M.data_ = data;
+        M.rows_ = rows;
+        M.cols_ = cols;
+        M.layout_ = layout;
+        M.storage_ = std::move(storage);
+        return M;
+    }
+
+    DenseMatrix(const DenseMatrix& other)
+        : rows_(other.rows_), cols_(other.cols_), layout_(other.layout_) {
+        allocate();
+        if (size() > 0) {
+            std::memcpy(data_, other.data_, size() * sizeof(uint64_t));
+        }
+    }
+
+    DenseMatrix(DenseMatrix&& other) noexcept
+        : data_(other.data_), rows_(other.rows_), cols_(other.cols_), layout_(other.layout_),
+          storage_(std::move(other.storage_)) {
+        other.data_ = nullptr;
+        other.rows_ = 0;
+        other.cols_ = 0;
+    }
+
+    DenseMatrix& operator=(const DenseMatrix& other) {
+        if (this != &other) {
+            DenseMatrix tmp(other);
+            swap(tmp);
+        }
+        return *this;
+    }
+
+    DenseMatrix& operator=(DenseMatrix&& other) noexcept {
+        if (this != &other) {
+            release();
+            data_ = other.data_;
+            rows_ = other.rows_;
+            cols_ = other.cols_;
+            layout_ = other.layout_;
+            storage_ = std::move(other.storage_);
+            other.data_ = nullptr;
+            other.rows_ = 0;
+            other.cols_ = 0;
+        }
+        return *this;
+    }
+
+    ~DenseMatrix() { release(); }
+
+    void swap(DenseMatrix& other) noexcept {
+        std::swap(data_, other.data_);
+        std::swap(rows_, other.rows_);
+        std::swap(cols_, other.cols_);
+        std::swap(layout_, other.layout_);
+        std::swap(storage_, other.storage_);
+    }
+
+    size_t rows() const { return rows_; }
+    size_t cols() const { return cols_; }
+    size_t size() const { return rows_ * cols_; }
+    bool empty() const { return size() == 0; }
+    Layout layout() const { return layout_; }
+    bool owns_data() const { return !storage_; }
+
+    uint64_t* data() { return data_; }
+    const uint64_t* data() const { return data_; }
+
+    /**
+     * 元素 (i, j) 在缓冲区中的线性下标
+     */
+    size_t index(size_t i, size_t j) const {
+        return layout_ == Layout::RowMajor ? i * cols_ + j : j * rows_ + i;
+    }
+
+    uint64_t& operator()(size_t i, size_t j) { return data_[index(i, j)]; }
+    const uint64_t& operator()(size_t i, size_t j) const { return data_[index(i, j)]; }
+
+    StridedSpan<uint64_t> row(size_t i) {
+        return layout_ == Layout::RowMajor
+            ? StridedSpan<uint64_t>(data_ + i * cols_, cols_, 1)
+            : StridedSpan<uint64_t>(data_ + i, cols_, rows_);
+    }
+    StridedSpan<const uint64_t> row(size_t i) const {
+        return layout_ == Layout::RowMajor
+            ? StridedSpan<const uint64_t>(data_ + i * cols_, cols_, 1)
+            : StridedSpan<const uint64_t>(data_ + i, cols_, rows_);
+    }
+
+    StridedSpan<uint64_t> col(size_t j) {
+        return layout_ == Layout::ColMajor
+            ? StridedSpan<uint64_t>(data_ + j * rows_, rows_, 1)
+            : StridedSpan<uint64_t>(data_ + j, rows_, cols_);
+    }
+    StridedSpan<const uint64_t> col(size_t j) const {
+        return layout_ == Layout::ColMajor
+            ? StridedSpan<const uint64_t>(data_ + j * rows_, rows_, 1)
+            : StridedSpan<const uint64_t>(data_ + j, rows_, cols_);
+    }
+
+    /**
+     * 用长度为rows()的连续数组覆盖第j列（列主序时为一次memcpy）
+     */
+    void set_col(size_t j, const uint64_t* values) {
+        if (layout_ == Layout::ColMajor) {
+            std::memcpy(data_ + j * rows_, values, rows_ * sizeof(uint64_t));
+        } else {
+            for (size_t i = 0; i < rows_; i++) {
+                data_[i * cols_ + j] = values[i];
+            }
+        }
+    }
+
+    void fill(uint64_t value) {
+        for (size_t k = 0; k < size(); k++) {
+            data_[k] = value;
+        }
+    }
+
+    bool same_shape(const DenseMatrix& other) const {
+        return rows_ == other.rows_ && cols_ == other.cols_;
+    }
+
+private:
+    uint64_t* data_ = nullptr;
+    size_t rows_ = 0;
+    size_t cols_ = 0;
+    Layout layout_ = Layout::ColMajor;
+    std::shared_ptr<void> storage_;  // 外部缓冲区的持有者（为空表示 data_ 由本对象分配）
+
+    void allocate() {
+        size_t bytes = size() * sizeof(uint64_t);
+        if (bytes == 0) {
+            data_ = nullptr;
+            return;
+        }
+        // aligned_alloc 要求大小是对齐值的整数倍
+        bytes = (bytes + kAlignment - 1) / kAlignment * kAlignment;
+        data_ = static_cast<uint64_t*>(std::aligned_alloc(kAlignment, bytes));
+        if (data_ == nullptr) {
+            throw std::bad_alloc();
+        }
+    }
+
+    void release() {
+        if (storage_) {
+            storage_.reset();
+        } else {
+            std::free(data_);
+        }
+        data_ = nullptr;
+    }
+};
+
+#endif // DENSE_MATRIX_H
@@ -0,0 +1,256 @@
+#ifndef FLAT_HASH_SET_H
+#define FLAT_HASH_SET_H
+
+#include <cstdint>
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+#include <vector>
+
+/**
+ * uint64_t 元素的开放寻址哈希集合（客户端数据集 X_i）
+ *
+ * 所有元素存放在一个 2 的幂大小的槽位数组中，线性探测：
+ *   - 槽位值0表示空槽，元素0单独用一个标志位记录
+ *   - 负载因子不超过 3/4，超过时容量翻倍并重新散列
+ *   - erase 使用后移删除（backward shift），不留墓碑，探测链长度不随删除退化
+ * 与 std::set 相比没有逐节点分配，全量遍历是对连续数组的顺序扫描；
+ * 遍历顺序由哈希决定，不是升序。
+ */
+
+class FlatHashSet {
+public:
+    FlatHashSet() = default;
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    /**
+     * 预留至少 n 个元素的容量（批量装入前调用，避免多次重新散列）
+     */
+    void reserve(size_t n) {
+        size_t capacity = kMinCapacity;
+        while (capacity * 3 / 4 < n) {
+            capacity *= 2;
+        }
+        if (capacity > slots_.size()) {
+            rehash(capacity);
+        }
+    }
+
+    void clear() {
+        slots_.assign(slots_.size(), 0);
+        has_zero_ = false;
+        size_ = 0;
+    }
+
+    bool contains(uint64_t x) const {
+        if (x == 0) return has_zero_;
+        if (slots_.empty()) return false;
+        for (size_t i = home(x);; i = (i + 1) & mask()) {
+            if (slots_[i] == x) return true;
+            if (slots_[i] == 0) return false;
+        }
+    }
+
+    /**
+     * 插入元素，返回是否为新元素
+     */
+    bool insert(uint64_t x) {
+        if (x == 0) {
+            if (has_zero_) return false;
+            has_zero_ = true;
+            size_++;
+            return true;
+        }
+        if ((size_ + 1) * 4 > slots_.size() * 3) {
+            rehash(slots_.empty() ? kMinCapacity : slots_.size() * 2);
+        }
+        size_t i = home(x);
+        while (slots_[i] != 0) {
+            if (slots_[i] == x) return false;
+            i = (i + 1) & mask();
+        }
+        slots_[i] = x;
+        size_++;
+        return true;
+    }
+
+    /**
+     * 删除元素，返回元素是否存在
+     */
+    bool erase(uint64_t x) {
+        if (x == 0) {
+            if (!has_zero_) return false;
+            has_zero_ = false;
+            size_--;
+            return true;
+        }
+        if (slots_.empty()) return false;
+        size_t i = home(x);
+        while (slots_[i] != x) {
+            if (slots_[i] == 0) return false;
+            i = (i + 1) & mask();
+        }
+        // 后移删除：把探测链上之后的元素前移到空出的槽位，直到遇到空槽
+        // 或已在自身起始位置之后的元素
+        for (size_t j = (i + 1) & mask(); slots_[j] != 0; j = (j + 1) & mask()) {
+            size_t h = home(slots_[j]);
+            if (((j - h) & mask()) >= ((j - i) & mask())) {
+                slots_[i] = slots_[j];
+                i = j;
+            }
+        }
+        slots_[i] = 0;
+        size_--;
+        return true;
+    }
+
+    /**
+     * 批量装入 [first, last)：一次预留容量后逐个插入，返回新插入的元素数
+     */
+    template <typename It>
+    size_t insert(It first, It last) {
+        return insert(first, last, [](uint64_t) {});
+    }
+
+    /**
+     * 批量增量：插入 [first, last)，对每个新插入的元素调用 on_inserted
+     * （如同步维护分区索引），返回新插入的元素数
+     */
+    template <typename It, typename F>
+    size_t insert(It first, It last, F on_inserted) {
+        if (std::is_base_of<std::forward_iterator_tag,
+                            typename std::iterator_traits<It>::iterator_category>::value) {
+            reserve(size_ + static_cast<size_t>(std::distance(first, last)));
+        }
+        size_t inserted = 0;
+        for (It it = first; it != last; ++it) {
+            if (insert(*it)) {
+                on_inserted(*it);
+                inserted++;
+            }
+        }
+        return inserted;
+    }
+
+    /**
+     * 批量删除 [first, last)，对每个实际删除的元素调用 on_erased，返回删除的元素数
+     */
+    template <typename It, typename F>
+    size_t erase(It first, It last, F on_erased) {
+        size_t erased = 0;
+        for (It it = first; it != last; ++it) {
+            if (erase(*it)) {
+                on_erased(*it);
+                erased++;
+            }
+        }
+        return erased;
+    }
+
+    /**
+     * 均匀随机取一个元素（集合非空）：随机选槽位直到命中非空槽，期望 O(1) 次尝试
+     */
+    template <typename Rng>
+    uint64_t sample(Rng& rng) const {
+        const uint64_t range = slots_.size() + (has_zero_ ? 1 : 0);
+        for (;;) {
+            uint64_t r = rng() % range;
+            if (r == slots_.size()) return 0;
+            if (slots_[r] != 0) return slots_[r];
+        }
+    }
+
+    /**
+     * 前向迭代器：按槽位顺序遍历所有非空槽，元素0（若存在）最后访问
+     */
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = uint64_t;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const uint64_t*;
+        using reference = const uint64_t&;
+
+        const_iterator() = default;
+
+        reference operator*() const {
+            return pos_ < set_->slots_.size() ? set_->slots_[pos_] : kZero;
+        }
+        pointer operator->() const { return &**this; }
+
+        const_iterator& operator++() {
+            pos_++;
+            skip();
+            return *this;
+        }
+        const_iterator operator++(int) {
+            const_iterator old = *this;
+            ++*this;
+            return old;
+        }
+
+        bool operator==(const const_iterator& other) const { return pos_ == other.pos_; }
+        bool operator!=(const const_iterator& other) const { return pos_ != other.pos_; }
+
+    private:
+        friend class FlatHashSet;
+        static constexpr uint64_t kZero = 0;
+
+        const FlatHashSet* set_ = nullptr;
+        size_t pos_ = 0;  // [0, capacity) 为槽位，capacity 为元素0，capacity + 1 为末尾
+
+        const_iterator(const FlatHashSet* set, size_t pos) : set_(set), pos_(pos) { skip(); }
+
+        void skip() {
+            const size_t n = set_->slots_.size();
+            while (pos_ < n && set_->slots_[pos_] == 0) {
+                pos_++;
+            }
+            if (pos_ == n && !set_->has_zero_) {
+                pos_ = n + 1;
+            }
+        }
+    };
+    using iterator = const_iterator;
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, slots_.size() + 1); }
+
+private:
+    static constexpr size_t kMinCapacity = 16;
+
+    std::vector<uint64_t> slots_;  // 0 表示空槽
+    bool has_zero_ = false;
+    size_t size_ = 0;
+
+    size_t mask() const { return slots_.size() - 1; }
+
+    /**
+     * 元素的起始槽位：murmur3 的 64 位终结混合，随机与有规律的输入都能均匀分布
+     */
+    size_t home(uint64_t x) const {
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        x *= 0xc4ceb9fe1a85ec53ULL;
+        x ^= x >> 33;
+        return static_cast<size_t>(x) & mask();
+    }
+
+    void rehash(size_t capacity) {
+        std::vector<uint64_t> old = std::move(slots_);
+        slots_.assign(capacity, 0);
+        for (uint64_t x : old) {
+            if (x == 0) continue;
+            size_t i = home(x);
+            while (slots_[i] != 0) {
+                i = (i + 1) & mask();
+            }
+            slots_[i] = x;
+        }
+    }
+};
+
+#endif // FLAT_HASH_SET_H
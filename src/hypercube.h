@@ -0,0 +1,78 @@
+#ifndef HYPERCUBE_H
+#define HYPERCUBE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+/**
+ * z维PIR超立方体的几何参数（每个配置计算一次）
+ *
+ * 每维大小 L 为满足 L^z ≥ b 的最小整数，用整数乘法逐个试算，
+ * 避免 ceil(pow(b, 1/z)) 在 b 恰为L的幂时因浮点误差多取1。
+ * 分区j视为L进制的z位数：j = Σ_d idx_d · L^(z-1-d)，stride(d) = L^(z-1-d)。
+ */
+
+class Hypercube {
+public:
+    Hypercube() = default;
+
+    Hypercube(size_t num_cells, size_t dimensions) : z_(dimensions) {
+        if (dimensions == 0) {
+            throw std::invalid_argument("hypercube needs at least one dimension");
+        }
+        L_ = 1;
+        while (power(L_, z_) < num_cells) {
+            L_++;
+        }
+        strides_.resize(z_);
+        size_t stride = 1;
+        for (size_t d = z_; d-- > 0;) {
+            strides_[d] = stride;
+            stride *= L_;
+        }
+        size_ = stride;
+    }
+
+    size_t dimensions() const { return z_; }
+    size_t side() const { return L_; }
+    size_t size() const { return size_; }
+    size_t stride(size_t d) const { return strides_[d]; }
+
+    /**
+     * 第d个坐标 idx_d
+     */
+    size_t coordinate(size_t j, size_t d) const {
+        return j / strides_[d] % L_;
+    }
+
+    /**
+     * 除第一个坐标外的其余坐标组成的数 m = j mod L^(z-1)，取值 [0, inner_size())
+     */
+    size_t inner_index(size_t j) const { return j % strides_[0]; }
+    size_t inner_size() const { return strides_[0]; }
+
+private:
+    size_t z_ = 1;
+    size_t L_ = 1;
+    size_t size_ = 1;
+    std::vector<size_t> strides_{1};
+
+    /**
+     * base^exp，溢出时饱和为最大值（此时必然不小于任何 num_cells）
+     */
+    static size_t power(size_t base, size_t exp) {
+        size_t result = 1;
+        for (size_t i = 0; i < exp; i++) {
+            if (result > std::numeric_limits<size_t>::max() / base) {
+                return std::numeric_limits<size_t>::max();
+            }
+            result *= base;
+        }
+        return result;
+    }
+};
+
+#endif // HYPERCUBE_H
@@ -0,0 +1,248 @@
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#if defined(MFUPSI_INSTRUMENT) && defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstring>
+#define MFUPSI_PERF_EVENTS 1
+#endif
+
+/**
+ * 热路径插桩：按探针统计调用次数、耗时、处理元素数、读写字节数与模乘次数
+ *
+ * 由CMake选项 MFUPSI_INSTRUMENTATION 定义 MFUPSI_INSTRUMENT 开启；
+ * 未开启时 MFUPSI_SCOPE / MFUPSI_COUNT / MFUPSI_INSTRUMENT_ONLY 展开为空，参数不会被求值。
+ *
+ * 开启后在Linux上每个线程还会打开一组 perf_event（用户态的 cycles 与 LLC misses），
+ * 在作用域进入与退出时读取差值；perf_event_open 不可用（权限或虚拟化限制）时这两项记为0。
+ *
+ * 计数器是全局原子量，并行任务（如各分区的 encode_partition）的耗时与计数按线程累加，
+ * 因此耗时为各线程工作时间之和；嵌套作用域的计数互相包含。
+ */
+
+class Instrumentation {
+public:
+    enum class Probe : size_t {
+        ClientEncode,
+        EncodePartition,
+        BuildLinearSystem,
+        BandSolve,
+        ApplyMask,
+        ServerAggregate,
+        ClientIncrementalUpdate,
+        ServerIncrementalUpdate,
+        PirFold,
+        ExternalProduct,
+        kCount
+    };
+
+    static constexpr size_t kNumProbes = static_cast<size_t>(Probe::kCount);
+
+    static const char* name(Probe probe) {
+        static const char* const names[kNumProbes] = {
+            "client_encode",
+            "encode_partition",
+            "build_linear_system",
+            "band_solve",
+            "apply_mask",
+            "server_aggregate",
+            "client_incremental_update",
+            "server_incremental_update",
+            "pir_fold",
+            "external_product",
+        };
+        return names[static_cast<size_t>(probe)];
+    }
+
+    struct Counters {
+        std::atomic<uint64_t> calls{0};
+        std::atomic<uint64_t> ns{0};
+        std::atomic<uint64_t> elements{0};
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<uint64_t> modmuls{0};
+        std::atomic<uint64_t> cycles{0};
+        std::atomic<uint64_t> llc_misses{0};
+    };
+
+    static Counters& counters(Probe probe) {
+        static std::array<Counters, kNumProbes> table;
+        return table[static_cast<size_t>(probe)];
+    }
+
+    static void count(Probe probe, uint64_t elements, uint64_t bytes, uint64_t modmuls) {
+        Counters& c = counters(probe);
+        c.elements.fetch_add(elements, std::memory_order_relaxed);
+        c.bytes.fetch_add(bytes, std::memory_order_relaxed);
+        c.modmuls.fetch_add(modmuls, std::memory_order_relaxed);
+    }
+
+    static void reset() {
+        for (size_t i = 0; i < kNumProbes; i++) {
+            Counters& c = counters(static_cast<Probe>(i));
+            c.calls = 0;
+            c.ns = 0;
+            c.elements = 0;
+            c.bytes = 0;
+            c.modmuls = 0;
+            c.cycles = 0;
+            c.llc_misses = 0;
+        }
+    }
+
+    /**
+     * 当前线程能否读取硬件计数器
+     */
+    static bool perf_available() {
+#ifdef MFUPSI_PERF_EVENTS
+        return PerfEvents::local().available();
+#else
+        return false;
+#endif
+    }
+
+    /**
+     * 打印所有被调用过的探针
+     */
+    static void report(std::ostream& os) {
+        os << "\n【插桩计数】" << (perf_available() ? "" : "（硬件计数器不可用）") << std::endl;
+        os << "  " << std::left << std::setw(28) << "probe" << std::right
+           << std::setw(10) << "calls" << std::setw(12) << "ms"
+           << std::setw(14) << "elements" << std::setw(12) << "MB"
+           << std::setw(14) << "modmuls" << std::setw(14) << "cycles"
+           << std::setw(12) << "LLC miss" << std::endl;
+        for (size_t i = 0; i < kNumProbes; i++) {
+            Probe probe = static_cast<Probe>(i);
+            const Counters& c = counters(probe);
+            if (c.calls == 0 && c.elements == 0) continue;
+            os << "  " << std::left << std::setw(28) << name(probe) << std::right
+               << std::setw(10) << c.calls.load()
+               << std::setw(12) << std::fixed << std::setprecision(3) << c.ns.load() / 1e6
+               << std::setw(14) << c.elements.load()
+               << std::setw(12) << std::setprecision(2) << c.bytes.load() / (1024.0 * 1024.0)
+               << std::setw(14) << c.modmuls.load()
+               << std::setw(14) << c.cycles.load()
+               << std::setw(12) << c.llc_misses.load() << std::endl;
+        }
+    }
+
+    /**
+     * 作用域计时：构造时读取时钟与硬件计数器，析构时累加差值并计一次调用
+     */
+    class Scope {
+    public:
+        explicit Scope(Probe probe) : probe_(probe) {
+#ifdef MFUPSI_PERF_EVENTS
+            PerfEvents::local().read(start_events_);
+#endif
+            start_ = std::chrono::steady_clock::now();
+        }
+
+        ~Scope() {
+            auto end = std::chrono::steady_clock::now();
+            Counters& c = counters(probe_);
+            c.calls.fetch_add(1, std::memory_order_relaxed);
+            c.ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start_).count(),
+                           std::memory_order_relaxed);
+#ifdef MFUPSI_PERF_EVENTS
+            uint64_t end_events[PerfEvents::kNumEvents];
+            PerfEvents::local().read(end_events);
+            c.cycles.fetch_add(end_events[0] - start_events_[0], std::memory_order_relaxed);
+            c.llc_misses.fetch_add(end_events[1] - start_events_[1], std::memory_order_relaxed);
+#endif
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        Probe probe_;
+        std::chrono::steady_clock::time_point start_;
+#ifdef MFUPSI_PERF_EVENTS
+        uint64_t start_events_[2];
+#endif
+    };
+
+private:
+#ifdef MFUPSI_PERF_EVENTS
+    /**
+     * 每线程一组 perf_event：cycles 为组长，LLC misses 为成员，一次 read 取回两者
+     */
+    class PerfEvents {
+    public:
+        static constexpr size_t kNumEvents = 2;
+
+        static PerfEvents& local() {
+            thread_local PerfEvents events;
+            return events;
+        }
+
+        bool available() const { return leader_ >= 0; }
+
+        void read(uint64_t* values) const {
+            values[0] = values[1] = 0;
+            if (leader_ < 0) return;
+            uint64_t buffer[1 + kNumEvents] = {0, 0, 0};
+            if (::read(leader_, buffer, sizeof(buffer)) < static_cast<ssize_t>(sizeof(uint64_t))) return;
+            for (size_t i = 0; i < kNumEvents && i < buffer[0]; i++) {
+                values[i] = buffer[1 + i];
+            }
+        }
+
+        ~PerfEvents() {
+            if (member_ >= 0) close(member_);
+            if (leader_ >= 0) close(leader_);
+        }
+
+    private:
+        int leader_ = -1;
+        int member_ = -1;
+
+        PerfEvents() {
+            leader_ = open(PERF_COUNT_HW_CPU_CYCLES, -1);
+            if (leader_ < 0) return;
+            member_ = open(PERF_COUNT_HW_CACHE_MISSES, leader_);
+            ioctl(leader_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(leader_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+
+        static int open(uint64_t config, int group) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.size = sizeof(attr);
+            attr.config = config;
+            attr.disabled = group < 0 ? 1 : 0;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP;
+            return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group, 0));
+        }
+    };
+#endif
+};
+
+#ifdef MFUPSI_INSTRUMENT
+#define MFUPSI_SCOPE_CONCAT_(a, b) a##b
+#define MFUPSI_SCOPE_CONCAT(a, b) MFUPSI_SCOPE_CONCAT_(a, b)
+#define MFUPSI_SCOPE(probe) \
+    Instrumentation::Scope MFUPSI_SCOPE_CONCAT(mfupsi_scope_, __LINE__)(Instrumentation::Probe::probe)
+#define MFUPSI_COUNT(probe, elements, bytes, modmuls) \
+    Instrumentation::count(Instrumentation::Probe::probe, (elements), (bytes), (modmuls))
+#define MFUPSI_INSTRUMENT_ONLY(...) __VA_ARGS__
+#else
+#define MFUPSI_SCOPE(probe) ((void)0)
+#define MFUPSI_COUNT(probe, elements, bytes, modmuls) ((void)0)
+#define MFUPSI_INSTRUMENT_ONLY(...)
+#endif
+
+#endif // INSTRUMENTATION_H
@@ -1,25 +1,40 @@
 #include "protocol.h"
+#include "autotuner.h"
+#include "benchmark.h"
+#include "instrumentation.h"
 #include <iostream>
 #include <iomanip>
 #include <fstream>
 #include <ctime>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
 
 /**
- * 输出性能指标到控制台和文件
+ * 输出性能指标到控制台
  */
 void print_metrics(const MFUPSIProtocol::PerformanceMetrics& metrics,
-                   const Config::ExperimentConfig& config,
-                   std::ofstream& output_file) {
+                   const Config::ExperimentConfig& config) {
     std::cout << "\n========== 性能指标汇总 ==========" << std::endl;
     std::cout << std::fixed << std::setprecision(4);
     
     // Setup阶段
     std::cout << "\n【Setup阶段】" << std::endl;
     std::cout << "  客户端编码耗时: " << metrics.setup_client_encoding_time_ms << " ms" << std::endl;
+    std::cout << "  编码线程数: " << metrics.num_threads
+              << " (并行加速比 " << metrics.setup_encode_speedup() << "x)" << std::endl;
     std::cout << "  服务器聚合耗时: " << metrics.setup_server_aggregation_time_ms << " ms" << std::endl;
     double setup_total_time = metrics.setup_client_encoding_time_ms + metrics.setup_server_aggregation_time_ms;
     std::cout << "  Setup总耗时: " << setup_total_time << " ms" << std::endl;
-    std::cout << "  客户端上传通信: " << metrics.setup_client_comm_bytes / (1024.0 * 1024.0) << " MB" << std::endl;
+    std::cout << "  分区编码失败率: " << metrics.encode_failure_rate()
+              << " (" << metrics.inconsistent_partitions << "/" << metrics.encoded_partitions << ")" << std::endl;
+    const char* comm_note = metrics.comm_measured ? "（实测）" : "";
+    std::cout << "  客户端上传通信: " << metrics.setup_client_comm_bytes / (1024.0 * 1024.0) << " MB" << comm_note << std::endl;
+    if (!config.encoding_file.empty()) {
+        std::cout << "  持久化耗时: " << metrics.setup_persist_time_ms << " ms，热重启耗时: "
+                  << metrics.setup_restore_time_ms << " ms" << std::endl;
+    }
     
     // Update阶段
     std::cout << "\n【Update阶段】" << std::endl;
@@ -27,19 +42,27 @@ void print_metrics(const MFUPSIProtocol::PerformanceMetrics& metrics,
     std::cout << "  服务器更新耗时: " << metrics.update_server_time_ms << " ms" << std::endl;
     double update_total_time = metrics.update_client_time_ms + metrics.update_server_time_ms;
     std::cout << "  Update总耗时: " << update_total_time << " ms" << std::endl;
-    std::cout << "  更新通信: " << metrics.update_client_comm_bytes / (1024.0 * 1024.0) << " MB" << std::endl;
+    std::cout << "  更新通信: " << metrics.update_client_comm_bytes / (1024.0 * 1024.0) << " MB" << comm_note << std::endl;
     
     // Query阶段
     std::cout << "\n【Query阶段】" << std::endl;
     std::cout << "  客户端查询生成耗时: " << metrics.query_client_gen_time_ms << " ms" << std::endl;
     std::cout << "  服务器处理耗时: " << metrics.query_server_process_time_ms << " ms" << std::endl;
+    std::cout << "  每查询分摊服务器耗时: " << metrics.query_server_amortized_time_ms << " ms" << std::endl;
     std::cout << "  客户端解密耗时: " << metrics.query_client_decrypt_time_ms << " ms" << std::endl;
     double query_total_time = metrics.query_client_gen_time_ms + 
                               metrics.query_server_process_time_ms + 
                               metrics.query_client_decrypt_time_ms;
     std::cout << "  Query总耗时: " << query_total_time << " ms" << std::endl;
-    std::cout << "  查询通信: " << metrics.query_comm_bytes / 1024.0 << " KB" << std::endl;
-    std::cout << "  响应通信: " << metrics.response_comm_bytes / 1024.0 << " KB" << std::endl;
+    std::cout << "  查询通信: " << metrics.query_comm_bytes / 1024.0 << " KB" << comm_note << std::endl;
+    std::cout << "  响应通信: " << metrics.response_comm_bytes / 1024.0 << " KB" << comm_note << std::endl;
+    if (metrics.comm_measured) {
+        std::cout << "  网络耗时: " << metrics.query_network_time_ms << " ms" << std::endl;
+    }
+    if (config.concurrent_updates) {
+        std::cout << "  并发Update: " << metrics.concurrent_update_rounds << " 轮, 服务器耗时 "
+                  << metrics.concurrent_update_server_ms << " ms" << std::endl;
+    }
     
     // 参数信息
     std::cout << "\n【参数配置】" << std::endl;
@@ -49,53 +72,244 @@ void print_metrics(const MFUPSIProtocol::PerformanceMetrics& metrics,
     std::cout << "  分区总数: " << config.num_partitions << std::endl;
     std::cout << "  扩展因子: " << config.expansion_factor << std::endl;
     std::cout << "  带宽(w): " << config.band_width << std::endl;
+    std::cout << "  查询批大小: " << config.query_batch_size << std::endl;
     std::cout << "  PIR维度: " << config.pir_dimension << std::endl;
     std::cout << "  LWE维度: " << config.lwe_dimension << std::endl;
-    
-    // 输出到文件
-    if (output_file.is_open()) {
-        output_file << "n,dataset_size,d_1,b,epsilon,w,z,N_lwe,q," 
-                   << "setup_client_time_ms,setup_server_time_ms,setup_comm_MB,"
-                   << "update_client_time_ms,update_server_time_ms,update_comm_MB,"
-                   << "query_client_gen_ms,query_server_ms,query_decrypt_ms,query_comm_KB" << std::endl;
-        
-        output_file << config.num_clients << ","
-                   << config.dataset_size << ","
-                   << config.partition_size << ","
-                   << config.num_partitions << ","
-                   << config.expansion_factor << ","
-                   << config.band_width << ","
-                   << config.pir_dimension << ","
-                   << config.lwe_dimension << ","
-                   << config.modulus << ","
-                   << metrics.setup_client_encoding_time_ms << ","
-                   << metrics.setup_server_aggregation_time_ms << ","
-                   << (metrics.setup_client_comm_bytes / (1024.0 * 1024.0)) << ","
-                   << metrics.update_client_time_ms << ","
-                   << metrics.update_server_time_ms << ","
-                   << (metrics.update_client_comm_bytes / (1024.0 * 1024.0)) << ","
-                   << metrics.query_client_gen_time_ms << ","
-                   << metrics.query_server_process_time_ms << ","
-                   << metrics.query_client_decrypt_time_ms << ","
-                   << (metrics.query_comm_bytes / 1024.0) << std::endl;
-        
-        output_file.flush();
+
+}
+
+/**
+ * 结果文件中记录的配置参数
+ */
+std::vector<std::pair<std::string, std::string>> config_params(const Config::ExperimentConfig& config) {
+    auto str = [](auto value) {
+        std::ostringstream os;
+        os << value;
+        return os.str();
+    };
+    return {
+        {"n", str(config.num_clients)},
+        {"dataset_size", str(config.dataset_size)},
+        {"d_1", str(config.partition_size)},
+        {"b", str(config.num_partitions)},
+        {"epsilon", str(config.expansion_factor)},
+        {"w", str(config.band_width)},
+        {"z", str(config.pir_dimension)},
+        {"N_lwe", str(config.lwe_dimension)},
+        {"q", str(config.modulus)},
+        {"batch", str(config.query_batch_size)},
+        {"rlwe", str(config.rlwe_pir ? 1 : 0)},
+    };
+}
+
+/**
+ * 将一次计量运行的指标加入样本集
+ */
+void record_metrics(Benchmark::Run& run, const MFUPSIProtocol::PerformanceMetrics& metrics,
+                    const Config::ExperimentConfig& config) {
+    double queries = std::max<size_t>(1, std::min(config.num_queries, config.dataset_size));
+    run.add("setup_client_ms", "ms", metrics.setup_client_encoding_time_ms);
+    run.add("setup_client_per_client_ms", "ms", metrics.setup_client_samples_ms);
+    run.add("setup_server_ms", "ms", metrics.setup_server_aggregation_time_ms);
+    run.add("setup_encode_speedup", "x", metrics.setup_encode_speedup());
+    run.add("setup_comm_MB", "MB", metrics.setup_client_comm_bytes / (1024.0 * 1024.0));
+    run.add("encode_failure_rate", "ratio", metrics.encode_failure_rate());
+    if (!config.encoding_file.empty()) {
+        run.add("setup_persist_ms", "ms", metrics.setup_persist_time_ms);
+        run.add("setup_restore_ms", "ms", metrics.setup_restore_time_ms);
+    }
+    run.add("update_client_ms", "ms", metrics.update_client_time_ms);
+    run.add("update_client_per_client_ms", "ms", metrics.update_client_samples_ms);
+    run.add("update_server_ms", "ms", metrics.update_server_time_ms);
+    run.add("update_comm_MB", "MB", metrics.update_client_comm_bytes / (1024.0 * 1024.0));
+    run.add("query_gen_ms", "ms", metrics.query_gen_samples_ms);
+    run.add("query_server_ms", "ms", metrics.query_server_samples_ms);
+    run.add("query_decrypt_ms", "ms", metrics.query_decrypt_samples_ms);
+    run.add("query_comm_KB", "KB", metrics.query_comm_bytes / queries / 1024.0);
+    run.add("response_comm_KB", "KB", metrics.response_comm_bytes / queries / 1024.0);
+    if (metrics.comm_measured) {
+        run.add("query_network_ms", "ms", metrics.query_network_time_ms);
+    }
+    if (config.concurrent_updates) {
+        run.add("concurrent_update_rounds", "count", static_cast<double>(metrics.concurrent_update_rounds));
+        run.add("concurrent_update_server_ms", "ms", metrics.concurrent_update_server_ms);
+    }
+    run.add("num_threads", "threads", static_cast<double>(metrics.num_threads));
+}
+
+/**
+ * 将自动调优的标定结果与估计代价写入结果集（每个候选一个 Run）
+ */
+void record_autotune(std::vector<Benchmark::Run>& runs, const std::string& name,
+                     const std::vector<Autotuner::Result>& results) {
+    for (const auto& r : results) {
+        runs.emplace_back(name, config_params(r.config));
+        auto& run = runs.back();
+        run.add("encode_partition_ms", "ms", r.setup.encode_partition_ms);
+        run.add("aggregate_partition_ms", "ms", r.setup.aggregate_partition_ms);
+        run.add("encode_failure_rate", "ratio", r.failure_rate());
+        if (r.query_calibrated) {
+            run.add("query_ms_per_query", "ms", r.query_gen_ms + r.query_server_ms + r.query_decrypt_ms);
+            run.add("snapshot_rebuild_ms", "ms", r.rebuild_ms);
+            run.add("est_setup_ms", "ms", r.setup_ms);
+            run.add("est_update_ms", "ms", r.update_ms);
+            run.add("est_query_ms", "ms", r.query_ms);
+            run.add("est_total_ms", "ms", r.total_ms);
+        }
+        run.add("memory_MB", "MB", r.memory_bytes / (1024.0 * 1024.0));
+        run.add("feasible", "bool", r.feasible ? 1.0 : 0.0);
+    }
+}
+
+/**
+ * 自动调优模式：对第一个配置的工作负载标定候选参数并报告最优者
+ */
+void run_autotune(const Benchmark::Options& options, const Config::ExperimentConfig& base,
+                  std::vector<Benchmark::Run>& runs) {
+    Autotuner::Options tune;
+    tune.calibration_partitions = options.tune_partitions;
+    tune.calibration_queries = options.tune_queries;
+    tune.update_rounds = options.update_rounds;
+    tune.memory_budget_bytes = options.memory_budget_mb * 1024 * 1024;
+    tune.max_failure_rate = options.max_failure_rate;
+
+    std::cout << "\n【自动调优】工作负载: n=" << base.num_clients << ", N_size=" << base.dataset_size
+              << ", 查询数=" << base.num_queries << ", 每轮更新=" << base.num_updates
+              << ", 更新轮数=" << tune.update_rounds << std::endl;
+    auto results = Autotuner::run(base, tune, std::cout);
+    Autotuner::report(std::cout, results);
+
+    const Autotuner::Result* best = Autotuner::best(results);
+    if (best) {
+        std::cout << "\n  推荐参数: d_1=" << best->config.partition_size << ", w=" << best->config.band_width
+                  << ", ε=" << best->config.expansion_factor << ", z=" << best->config.pir_dimension
+                  << " (b=" << best->config.num_partitions << ", 估计总耗时 "
+                  << best->total_ms << " ms)" << std::endl;
+    } else {
+        std::cout << "\n  没有满足失败率与内存约束的候选" << std::endl;
+    }
+    record_autotune(runs, options.configs.front(), results);
+}
+
+/**
+ * 联网部署：本进程只承担服务器或一组客户端的角色，运行一次并记录本端的指标
+ */
+void run_networked(const Benchmark::Options& options, const Config::ExperimentConfig& config,
+                   std::vector<Benchmark::Run>& runs) {
+    MFUPSIProtocol protocol(config);
+    std::string role;
+    if (!options.serve.empty()) {
+        role = "server";
+        if (config.num_shards > 1) {
+            role += "_shard" + std::to_string(options.shard);
+        }
+        Transport::Listener listener(Transport::parse_port(options.serve));
+        protocol.serve(listener, options.shard);
+    } else {
+        size_t first = options.client_first;
+        size_t last = options.client_last ? options.client_last : config.num_clients;
+        if ((first != 0 || last != config.num_clients) && config.key_seed == 0) {
+            throw std::invalid_argument("--key-seed is required when clients are split across processes");
+        }
+        role = "clients_" + std::to_string(first) + "_" + std::to_string(last);
+        std::vector<Transport::Connection> shards;
+        for (const auto& address : options.connect) {
+            auto endpoint = Transport::parse_endpoint(address);
+            shards.push_back(Transport::connect(endpoint.first, endpoint.second));
+        }
+        protocol.run_clients(shards, first, last);
+    }
+    print_metrics(protocol.get_metrics(), config);
+    runs.emplace_back(options.configs.front() + "_" + role, config_params(config));
+    record_metrics(runs.back(), protocol.get_metrics(), config);
+}
+
+#ifdef MFUPSI_INSTRUMENT
+/**
+ * 将各探针的计数加入样本集（每次计量运行一个样本）
+ */
+void record_probes(Benchmark::Run& run) {
+    for (size_t i = 0; i < Instrumentation::kNumProbes; i++) {
+        auto probe = static_cast<Instrumentation::Probe>(i);
+        const auto& c = Instrumentation::counters(probe);
+        if (c.calls == 0) continue;
+        std::string prefix = std::string("probe.") + Instrumentation::name(probe) + ".";
+        run.add(prefix + "calls", "count", static_cast<double>(c.calls));
+        run.add(prefix + "ms", "ms", c.ns / 1e6);
+        run.add(prefix + "elements", "count", static_cast<double>(c.elements));
+        run.add(prefix + "bytes", "bytes", static_cast<double>(c.bytes));
+        run.add(prefix + "modmuls", "count", static_cast<double>(c.modmuls));
+        run.add(prefix + "cycles", "cycles", static_cast<double>(c.cycles));
+        run.add(prefix + "llc_misses", "count", static_cast<double>(c.llc_misses));
     }
 }
+#endif
+
+/**
+ * 预热运行期间丢弃标准输出
+ */
+class SilenceStdout {
+public:
+    explicit SilenceStdout(bool active) : saved_(active ? std::cout.rdbuf(nullptr) : nullptr) {}
+    ~SilenceStdout() {
+        if (saved_) {
+            std::cout.rdbuf(saved_);
+            std::cout.clear();
+        }
+    }
+
+private:
+    std::streambuf* saved_;
+};
 
 /**
  * 主实验驱动程序
  */
-int main() {
+int main(int argc, char** argv) {
+    Benchmark::Options options;
+    std::vector<Config::ExperimentConfig> configs;
+    try {
+        options = Benchmark::Options::parse(argc, argv);
+        for (const auto& name : options.configs) {
+            configs.push_back(Config::get_config(name));
+            auto& config = configs.back();
+            if (options.clients) config.num_clients = options.clients;
+            if (options.dataset_size) config.dataset_size = options.dataset_size;
+            if (options.queries) config.num_queries = options.queries;
+            if (options.updates) config.num_updates = options.updates;
+            config.compute_derived_params();
+            config.key_seed = options.key_seed;
+            config.num_shards = options.num_shards;
+            config.concurrent_updates = options.concurrent_updates;
+            if (!options.encoding_dir.empty()) {
+                std::string suffix = config.num_shards > 1 ? "_shard" + std::to_string(options.shard) : "";
+                config.encoding_file = options.encoding_dir + "/global_" + name + suffix + ".mfmat";
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "错误：" << e.what() << std::endl;
+        Benchmark::Options::print_usage(std::cerr, argv[0]);
+        return 1;
+    }
+    if (options.help) {
+        Benchmark::Options::print_usage(std::cout, argv[0]);
+        return 0;
+    }
+    
     std::cout << "========================================" << std::endl;
     std::cout << "  MFUPSI协议性能评估实验" << std::endl;
     std::cout << "  版本: 1.0 (严谨科研实现)" << std::endl;
     std::cout << "========================================" << std::endl;
+    std::cout << "  预热次数: " << options.warmup << "，计量次数: " << options.repetitions << std::endl;
     
     // 打开结果文件
-    std::time_t now = std::time(nullptr);
-    char filename[256];
-    std::strftime(filename, sizeof(filename), "results_%Y%m%d_%H%M%S.csv", std::localtime(&now));
+    std::string filename = options.output;
+    if (filename.empty()) {
+        std::time_t now = std::time(nullptr);
+        char stamp[64];
+        std::strftime(stamp, sizeof(stamp), "results_%Y%m%d_%H%M%S", std::localtime(&now));
+        filename = std::string(stamp) + "." + options.format;
+    }
     
     std::ofstream results_file(filename);
     if (!results_file.is_open()) {
@@ -103,71 +317,83 @@ int main() {
         return 1;
     }
     
-    // 定义多个实验配置（用于测试不同的参数组合）
-    std::vector<Config::ExperimentConfig> configs;
-    
-    // 小规模测试配置
-    {
-        auto cfg = Config::get_test_config();
-        configs.push_back(cfg);
-    }
+    std::vector<Benchmark::Run> runs;
     
-    // 默认配置
-    {
-        auto cfg = Config::get_default_config();
-        configs.push_back(cfg);
+    if (options.autotune || options.networked()) {
+        try {
+            if (options.autotune) {
+                run_autotune(options, configs.front(), runs);
+            } else {
+                run_networked(options, configs.front(), runs);
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "错误：" << e.what() << std::endl;
+            return 1;
+        }
+        configs.clear();
     }
     
-    // // 可以添加更多配置进行不同规模的测试
-    // {
-    //     auto cfg = Config::get_performance_config();
-    //     configs.push_back(cfg);
-    // }
-    
-    // 执行每个配置的实验
+    // 执行每个配置的实验：先预热（不记录、不输出），再计量
     for (size_t config_idx = 0; config_idx < configs.size(); config_idx++) {
         auto& config = configs[config_idx];
+        runs.emplace_back(options.configs[config_idx], config_params(config));
         
-        std::cout << "\n\n" << std::string(50, '=') << std::endl;
-        std::cout << "实验配置 " << (config_idx + 1) << "/" << configs.size() << std::endl;
-        std::cout << "  客户端数: " << config.num_clients << std::endl;
-        std::cout << "  数据集大小: " << config.dataset_size << std::endl;
-        std::cout << "  分区容量: " << config.partition_size << std::endl;
-        std::cout << "  更新数据量: " << config.num_updates << std::endl;
-        std::cout << "  查询数量: " << config.num_queries << std::endl;
-        std::cout << std::string(50, '=') << std::endl;
-        
-        // 初始化协议
-        MFUPSIProtocol protocol(config);
-        
-        try {
-            // 阶段一：Setup
-            std::cout << "\n【阶段一】执行Setup..." << std::endl;
-            protocol.setup_phase();
+        for (size_t rep = 0; rep < options.warmup + options.repetitions; rep++) {
+            bool measured = rep >= options.warmup;
+            SilenceStdout silence(!measured);
             
-            // 阶段二：Update（可选，取决于要求）
-            std::cout << "\n【阶段二】执行Update..." << std::endl;
-            size_t num_update_clients = std::max(
-                (size_t)0, 
-                config.num_clients
-            );
-            protocol.update_phase(num_update_clients);
+            std::cout << "\n\n" << std::string(50, '=') << std::endl;
+            std::cout << "实验配置 " << (config_idx + 1) << "/" << configs.size()
+                      << " (" << options.configs[config_idx] << ", 第 "
+                      << (rep - options.warmup + 1) << "/" << options.repetitions << " 次)" << std::endl;
+            std::cout << "  客户端数: " << config.num_clients << std::endl;
+            std::cout << "  数据集大小: " << config.dataset_size << std::endl;
+            std::cout << "  分区容量: " << config.partition_size << std::endl;
+            std::cout << "  更新数据量: " << config.num_updates << std::endl;
+            std::cout << "  查询数量: " << config.num_queries << std::endl;
+            std::cout << std::string(50, '=') << std::endl;
             
-            // 阶段三：Query
-            std::cout << "\n【阶段三】执行Query..." << std::endl;
-            protocol.query_phase();
+            try {
+                // 初始化协议
+                MFUPSIProtocol protocol(config);
+                MFUPSI_INSTRUMENT_ONLY(Instrumentation::reset();)
+                
+                // 阶段一：Setup
+                std::cout << "\n【阶段一】执行Setup..." << std::endl;
+                protocol.setup_phase();
+                
+                // 阶段二：Update
+                std::cout << "\n【阶段二】执行Update..." << std::endl;
+                protocol.update_phase(config.num_clients);
+                
+                // 阶段三：Query
+                std::cout << "\n【阶段三】执行Query..." << std::endl;
+                protocol.query_phase();
+                
+                // 输出性能指标
+                if (measured) {
+                    print_metrics(protocol.get_metrics(), config);
+                    record_metrics(runs.back(), protocol.get_metrics(), config);
+                    MFUPSI_INSTRUMENT_ONLY(
+                        Instrumentation::report(std::cout);
+                        record_probes(runs.back());
+                    )
+                }
+                
+            } catch (const std::exception& e) {
+                std::cerr << "错误：" << e.what() << std::endl;
+                return 1;
+            }
             
-            // 输出性能指标
-            print_metrics(protocol.get_metrics(), config, results_file);
-            
-        } catch (const std::exception& e) {
-            std::cerr << "错误：" << e.what() << std::endl;
-            return 1;
+            std::cout << std::endl;
         }
-        
-        std::cout << std::endl;
     }
     
+    if (options.format == "json") {
+        Benchmark::write_json(results_file, runs);
+    } else {
+        Benchmark::write_csv(results_file, runs);
+    }
     results_file.close();
     
     std::cout << "\n\n" << std::string(50, '=') << std::endl;
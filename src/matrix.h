@@ -2,10 +2,13 @@
 #define MATRIX_H
 
 #include "utils.h"
+#include "modarith.h"
+#include "dense_matrix.h"
+#include "simd_mod.h"
+#include "prg.h"
 #include <vector>
 #include <cstring>
 #include <algorithm>
-#include <random>
 
 /**
  * 矩阵操作及高斯消元算法（有限域Z_q上）
@@ -16,11 +19,17 @@
  * 2) 使用正确的前向消元逻辑
  * 3) 回代求解中正确使用模逆
  * 4) 所有运算在Z_q上进行
+ * 
+ * 所有 Z_q 运算核都以模运算策略（见 modarith.h）为模板参数；
+ * 接受 uint64_t q 的重载按模数分派到对应的特化实例
+ * 
+ * 矩阵统一使用连续存储的 DenseMatrix（见 dense_matrix.h），默认列主序
  */
 
 class Matrix {
 public:
-    using MatrixType = std::vector<std::vector<uint64_t>>;
+    using MatrixType = DenseMatrix;
+    using Layout = DenseMatrix::Layout;
     using VectorType = std::vector<uint64_t>;
     
     /**
@@ -64,20 +73,32 @@ public:
         const VectorType& y,
         uint64_t q
     ) {
-        size_t m = M.size();  // 方程个数
+        return ModArith::dispatch(q, [&](const auto& mod) {
+            return gaussian_elimination(M, y, mod);
+        });
+    }
+    
+    template <typename Mod>
+    static VectorType gaussian_elimination(
+        const MatrixType& M,
+        const VectorType& y,
+        const Mod& mod
+    ) {
+        size_t m = M.rows();  // 方程个数
         if (m == 0) {
             return VectorType();
         }
         
-        size_t d1 = M[0].size();  // 变量个数（编码维度）
+        size_t d1 = M.cols();  // 变量个数（编码维度）
         
         // ============ 第一步：构造增广矩阵 [M | y] ============
-        MatrixType augmented(m, VectorType(d1 + 1));
+        // 行主序：行交换和行消元都是连续内存操作
+        MatrixType augmented(m, d1 + 1, Layout::RowMajor);
         for (size_t i = 0; i < m; i++) {
             for (size_t j = 0; j < d1; j++) {
-                augmented[i][j] = M[i][j];
+                augmented(i, j) = M(i, j);
             }
-            augmented[i][d1] = y[i];  // 增广列（右侧）
+            augmented(i, d1) = y[i];  // 增广列（右侧）
         }
         
         // ============ 第二步：前向消元（Forward Elimination） ============
@@ -90,7 +111,7 @@ public:
             // 在 [pivot_row, m) 范围内找该列的首个非零元素
             int best_row = -1;
             for (size_t row = pivot_row; row < m; row++) {
-                if (augmented[row][col] != 0) {
+                if (augmented(row, col) != 0) {
                     best_row = row;
                     break;
                 }
@@ -103,36 +124,40 @@ public:
             
             // --- 2.2 行交换 ---
             // 将主元行交换到 pivot_row
-            std::swap(augmented[pivot_row], augmented[best_row]);
+            if ((size_t)best_row != pivot_row) {
+                uint64_t* a = augmented.row(pivot_row).data();
+                uint64_t* b = augmented.row(best_row).data();
+                std::swap_ranges(a, a + d1 + 1, b);
+            }
             
             // --- 2.3 主元归一化（关键步骤） ---
-            // 将 augmented[pivot_row][col] 归一化为1
+            // 将 augmented(pivot_row, col) 归一化为1
             // 方法：主元行所有元素乘以主元的模逆
-            uint64_t pivot = augmented[pivot_row][col];
-            uint64_t pivot_inv = Utils::mod_inverse(pivot, q);
+            uint64_t pivot = augmented(pivot_row, col);
+            uint64_t pivot_inv = ModArith::inverse(mod, pivot);
             
             for (size_t j = col; j <= d1; j++) {
-                augmented[pivot_row][j] = Utils::mul_mod(augmented[pivot_row][j], pivot_inv, q);
+                augmented(pivot_row, j) = mod.mul(augmented(pivot_row, j), pivot_inv);
             }
-            // 现在 augmented[pivot_row][col] = 1，即主元已归一化
+            // 现在 augmented(pivot_row, col) = 1，即主元已归一化
             
             // --- 2.4 消元（标准高斯消元） ---
             // 将该列下方的所有元素消为0
             // 对于第i行 (i > pivot_row)：
-            //   如果 augmented[i][col] = k，则执行 Row[i] -= k * Row[pivot_row]
-            //   这样 augmented[i][col] - k*1 = 0
+            //   如果 augmented(i, col) = k，则执行 Row[i] -= k * Row[pivot_row]
+            //   这样 augmented(i, col) - k*1 = 0
             
             for (size_t i = pivot_row + 1; i < m; i++) {
-                uint64_t factor = augmented[i][col];  // 消元因子
+                uint64_t factor = augmented(i, col);  // 消元因子
                 
                 if (factor == 0) continue;  // 已经是0，无需消元
                 
-                // 对该行的所有元素执行操作：augmented[i][j] -= factor * augmented[pivot_row][j]
+                // 对该行的所有元素执行操作：augmented(i, j) -= factor * augmented(pivot_row, j)
                 for (size_t j = col; j <= d1; j++) {
-                    uint64_t term = Utils::mul_mod(factor, augmented[pivot_row][j], q);
-                    augmented[i][j] = Utils::sub_mod(augmented[i][j], term, q);
+                    uint64_t term = mod.mul(factor, augmented(pivot_row, j));
+                    augmented(i, j) = mod.sub(augmented(i, j), term);
                 }
-                // 现在 augmented[i][col] = 0
+                // 现在 augmented(i, col) = 0
             }
             
             pivot_row++;  // 移动到下一行
@@ -148,42 +173,42 @@ public:
             // --- 3.1 找到该行的主元所在列 ---
             int leading_col = -1;
             for (size_t j = 0; j < d1; j++) {
-                if (augmented[i][j] != 0) {
+                if (augmented(i, j) != 0) {
                     leading_col = j;
                     break;
                 }
             }
             
             if (leading_col == -1) {
-                // 该行全为0，方程形如 0 = augmented[i][d1]
-                // 如果 augmented[i][d1] != 0 则无解
+                // 该行全为0，方程形如 0 = augmented(i, d1)
+                // 如果 augmented(i, d1) != 0 则无解
                 // 否则该方程自动满足，不约束任何变量
                 continue;
             }
             
             // --- 3.2 计算右侧常数项 ---
-            // 原方程为：augmented[i][leading_col] * x[leading_col] + sum(...) = augmented[i][d1]
+            // 原方程为：augmented(i, leading_col) * x[leading_col] + sum(...) = augmented(i, d1)
             // 其中 sum(...) 是已经求出的变量的贡献
-            uint64_t sum = augmented[i][d1];  // 初始为右侧常数
+            uint64_t sum = augmented(i, d1);  // 初始为右侧常数
             
             for (size_t j = leading_col + 1; j < d1; j++) {
                 // 减去已求解变量的贡献
-                // augmented[i][j] * result[j]
-                uint64_t term = Utils::mul_mod(augmented[i][j], result[j], q);
-                sum = Utils::sub_mod(sum, term, q);
+                // augmented(i, j) * result[j]
+                uint64_t term = mod.mul(augmented(i, j), result[j]);
+                sum = mod.sub(sum, term);
             }
             
-            // 现在 sum = augmented[i][leading_col] * result[leading_col]
+            // 现在 sum = augmented(i, leading_col) * result[leading_col]
             
             // --- 3.3 求解该变量 ---
             // 由于前向消元已将主元归一化为1，
             // 若leading_col在主对角线位置（i == leading_col），则主元为1
             // 但一般情况下可能不是，所以需要除以主元（乘以模逆）
-            uint64_t pivot = augmented[i][leading_col];
+            uint64_t pivot = augmented(i, leading_col);
             
             if (pivot != 0) {
-                uint64_t pivot_inv = Utils::mod_inverse(pivot, q);
-                result[leading_col] = Utils::mul_mod(sum, pivot_inv, q);
+                uint64_t pivot_inv = ModArith::inverse(mod, pivot);
+                result[leading_col] = mod.mul(sum, pivot_inv);
             }
         }
         
@@ -192,25 +217,86 @@ public:
     
     /**
      * 矩阵加法：C = A + B (mod q)
-     * 逐元素相加
+     * 逐元素相加；布局相同时为一次线性扫描
      */
     static MatrixType matrix_add(
         const MatrixType& A,
         const MatrixType& B,
         uint64_t q
     ) {
-        size_t rows = A.size();
-        size_t cols = A[0].size();
-        
-        MatrixType C(rows, VectorType(cols));
-        
-        for (size_t i = 0; i < rows; i++) {
-            for (size_t j = 0; j < cols; j++) {
-                C[i][j] = Utils::add_mod(A[i][j], B[i][j], q);
+        return ModArith::dispatch(q, [&](const auto& mod) {
+            return matrix_add(A, B, mod);
+        });
+    }
+    
+    template <typename Mod>
+    static MatrixType matrix_add(
+        const MatrixType& A,
+        const MatrixType& B,
+        const Mod& mod
+    ) {
+        MatrixType C = MatrixType::uninitialized(A.rows(), A.cols(), A.layout());
+        elementwise(A, B, C, [&](uint64_t a, uint64_t b) { return mod.add(a, b); });
+        return C;
+    }
+    
+    /**
+     * 原地累加单列：dst[:, j] += values (mod q)，values 为长度rows()的连续数组
+     * 列主序时为一次向量化的连续扫描（稀疏更新按列写回）
+     */
+    static void accumulate_col(MatrixType& dst, size_t j, const uint64_t* values, uint64_t q) {
+        ModArith::dispatch(q, [&](const auto& mod) {
+            accumulate_col(dst, j, values, mod);
+        });
+    }
+    
+    template <typename Mod>
+    static void accumulate_col(MatrixType& dst, size_t j, const uint64_t* values, const Mod& mod) {
+        auto column = dst.col(j);
+        if (column.is_contiguous()) {
+            SimdMod::add_inplace(column.data(), values, column.size(), mod);
+            return;
+        }
+        for (size_t i = 0; i < column.size(); i++) {
+            column[i] = mod.add(column[i], values[i]);
+        }
+    }
+    
+    /**
+     * n路融合归约：dst[:, first_col, first_col + c) += Σ_k srcs[k] (mod q)
+     * srcs 为形状相同的 rows() × c 矩阵；单次遍历所有输入，每个dst元素只读写一次。
+     * 全部为列主序时目标列区间连续，整段走向量化的多路累加核（见 simd_mod.h）
+     */
+    static void accumulate_many(MatrixType& dst, size_t first_col, const std::vector<const MatrixType*>& srcs,
+                                uint64_t q) {
+        ModArith::dispatch(q, [&](const auto& mod) {
+            accumulate_many(dst, first_col, srcs, mod);
+        });
+    }
+    
+    template <typename Mod>
+    static void accumulate_many(MatrixType& dst, size_t first_col, const std::vector<const MatrixType*>& srcs,
+                                const Mod& mod) {
+        if (srcs.empty()) return;
+        const size_t cols = srcs[0]->cols();
+        bool contiguous = dst.layout() == Layout::ColMajor;
+        std::vector<const uint64_t*> streams;
+        streams.reserve(srcs.size());
+        for (const MatrixType* src : srcs) {
+            contiguous = contiguous && src->layout() == Layout::ColMajor;
+            streams.push_back(src->data());
+        }
+        if (contiguous) {
+            SimdMod::accumulate(dst.col(first_col).data(), streams.data(), streams.size(), dst.rows() * cols, mod);
+            return;
+        }
+        for (const MatrixType* src : srcs) {
+            for (size_t i = 0; i < dst.rows(); i++) {
+                for (size_t t = 0; t < cols; t++) {
+                    dst(i, first_col + t) = mod.add(dst(i, first_col + t), (*src)(i, t));
+                }
             }
         }
-        
-        return C;
     }
     
     /**
@@ -221,17 +307,19 @@ public:
         const MatrixType& B,
         uint64_t q
     ) {
-        size_t rows = A.size();
-        size_t cols = A[0].size();
-        
-        MatrixType C(rows, VectorType(cols));
-        
-        for (size_t i = 0; i < rows; i++) {
-            for (size_t j = 0; j < cols; j++) {
-                C[i][j] = Utils::sub_mod(A[i][j], B[i][j], q);
-            }
-        }
-        
+        return ModArith::dispatch(q, [&](const auto& mod) {
+            return matrix_sub(A, B, mod);
+        });
+    }
+    
+    template <typename Mod>
+    static MatrixType matrix_sub(
+        const MatrixType& A,
+        const MatrixType& B,
+        const Mod& mod
+    ) {
+        MatrixType C = MatrixType::uninitialized(A.rows(), A.cols(), A.layout());
+        elementwise(A, B, C, [&](uint64_t a, uint64_t b) { return mod.sub(a, b); });
         return C;
     }
     
@@ -245,20 +333,34 @@ public:
         const MatrixType& B,
         uint64_t q
     ) {
-        size_t n = A.size();
-        size_t m = A[0].size();
-        size_t k = B[0].size();
+        return ModArith::dispatch(q, [&](const auto& mod) {
+            return matrix_multiply(A, B, mod);
+        });
+    }
+    
+    template <typename Mod>
+    static MatrixType matrix_multiply(
+        const MatrixType& A,
+        const MatrixType& B,
+        const Mod& mod
+    ) {
+        size_t n = A.rows();
+        size_t m = A.cols();
+        size_t k = B.cols();
         
-        MatrixType C(n, VectorType(k, 0));
+        // C按列主序输出：C[:, j] = A * B[:, j]
+        MatrixType C(n, k, Layout::ColMajor);
         
-        for (size_t i = 0; i < n; i++) {
-            for (size_t j = 0; j < k; j++) {
-                uint64_t sum = 0;
+        for (size_t j = 0; j < k; j++) {
+            auto b_col = B.col(j);
+            for (size_t i = 0; i < n; i++) {
+                auto a_row = A.row(i);
+                // 惰性约减：循环内只累加，结束后一次性约减
+                ModArith::u128 acc = 0;
                 for (size_t l = 0; l < m; l++) {
-                    uint64_t prod = Utils::mul_mod(A[i][l], B[l][j], q);
-                    sum = Utils::add_mod(sum, prod, q);
+                    mod.mac(acc, a_row[l], b_col[l]);
                 }
-                C[i][j] = sum;
+                C(i, j) = mod.reduce(acc);
             }
         }
         
@@ -268,14 +370,26 @@ public:
     /**
      * 向量-矩阵乘法：v^T * M = v' (行向量乘矩阵)
      * 用于Query阶段
+     * 列主序时每个输出是 v 与一列的连续点积
      */
     static VectorType vector_matrix_multiply(
         const VectorType& v,
         const MatrixType& M,
         uint64_t q
     ) {
-        size_t m = M.size();
-        size_t n = M[0].size();
+        return ModArith::dispatch(q, [&](const auto& mod) {
+            return vector_matrix_multiply(v, M, mod);
+        });
+    }
+    
+    template <typename Mod>
+    static VectorType vector_matrix_multiply(
+        const VectorType& v,
+        const MatrixType& M,
+        const Mod& mod
+    ) {
+        size_t m = M.rows();
+        size_t n = M.cols();
         
         if (v.size() != m) {
             return VectorType();
@@ -284,12 +398,12 @@ public:
         VectorType result(n, 0);
         
         for (size_t j = 0; j < n; j++) {
-            uint64_t sum = 0;
+            auto col = M.col(j);
+            ModArith::u128 acc = 0;
             for (size_t i = 0; i < m; i++) {
-                uint64_t prod = Utils::mul_mod(v[i], M[i][j], q);
-                sum = Utils::add_mod(sum, prod, q);
+                mod.mac(acc, v[i], col[i]);
             }
-            result[j] = sum;
+            result[j] = mod.reduce(acc);
         }
         
         return result;
@@ -298,45 +412,71 @@ public:
     /**
      * 创建随机矩阵
      */
-    static MatrixType random_matrix(size_t rows, size_t cols, uint64_t q) {
-        MatrixType M(rows, VectorType(cols));
-        
-        std::mt19937_64 rng(std::random_device{}());
-        std::uniform_int_distribution<uint64_t> dist(0, q - 1);
-        
-        for (size_t i = 0; i < rows; i++) {
-            for (size_t j = 0; j < cols; j++) {
-                M[i][j] = dist(rng) % q;
-            }
-        }
-        
+    static MatrixType random_matrix(size_t rows, size_t cols, uint64_t q,
+                                    Layout layout = Layout::ColMajor) {
+        MatrixType M = MatrixType::uninitialized(rows, cols, layout);
+        Prg::expand_mod(Prg::random_key(), 0, q, M.data(), M.size());
+        return M;
+    }
+
+    /**
+     * 同上，由线程池分块并行生成
+     */
+    static MatrixType random_matrix(size_t rows, size_t cols, uint64_t q,
+                                    Layout layout, ThreadPool& pool) {
+        MatrixType M = MatrixType::uninitialized(rows, cols, layout);
+        Prg::expand_mod(Prg::random_key(), 0, q, M.data(), M.size(), pool);
         return M;
     }
     
     /**
      * 创建零矩阵
      */
-    static MatrixType zero_matrix(size_t rows, size_t cols) {
-        return MatrixType(rows, VectorType(cols, 0));
+    static MatrixType zero_matrix(size_t rows, size_t cols,
+                                  Layout layout = Layout::ColMajor) {
+        return MatrixType(rows, cols, layout);
     }
     
     /**
-     * 矩阵转置
+     * 矩阵转置（保持布局类型）
      */
     static MatrixType transpose(const MatrixType& M) {
-        size_t rows = M.size();
-        size_t cols = M[0].size();
+        size_t rows = M.rows();
+        size_t cols = M.cols();
         
-        MatrixType MT(cols, VectorType(rows));
+        MatrixType MT(cols, rows, M.layout());
         
         for (size_t i = 0; i < rows; i++) {
             for (size_t j = 0; j < cols; j++) {
-                MT[j][i] = M[i][j];
+                MT(j, i) = M(i, j);
             }
         }
         
         return MT;
     }
+
+private:
+    /**
+     * 逐元素运算 C = op(A, B)
+     * 三者布局相同时按缓冲区顺序线性扫描，否则按 (i, j) 访问
+     */
+    template <typename Op>
+    static void elementwise(const MatrixType& A, const MatrixType& B, MatrixType& C, Op op) {
+        if (A.layout() == B.layout() && A.layout() == C.layout()) {
+            const uint64_t* a = A.data();
+            const uint64_t* b = B.data();
+            uint64_t* c = C.data();
+            for (size_t k = 0; k < A.size(); k++) {
+                c[k] = op(a[k], b[k]);
+            }
+            return;
+        }
+        for (size_t i = 0; i < A.rows(); i++) {
+            for (size_t j = 0; j < A.cols(); j++) {
+                C(i, j) = op(A(i, j), B(i, j));
+            }
+        }
+    }
 };
 
 #endif // MATRIX_H
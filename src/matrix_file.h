@@ -0,0 +1,171 @@
+#ifndef MATRIX_FILE_H
+#define MATRIX_FILE_H
+
+#include "dense_matrix.h"
+#include <cerrno>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * d_1 × b 矩阵的版本化二进制文件格式，通过 mmap 加载
+ *
+ * 布局（小端）：
+ *   [0, 64)            Header：magic "MFUPSIMX"、格式版本、布局、行列数、模数、数据偏移与长度
+ *   [64, data_offset)  填充为零，data_offset 按页（4096字节）对齐
+ *   [data_offset, ...) 列主序数据，第j列从 data_offset + j · rows · 8 开始，
+ *                      rows 为8的倍数时每列都是64字节对齐的独立块
+ *
+ * map() 返回的矩阵直接引用映射区域（MAP_PRIVATE，写入为进程内的写时复制，不改动文件），
+ * 内容在首次访问时按页从文件读入：只读取被访问的列，文件可以大于可用内存。
+ */
+
+class MatrixFile {
+public:
+    static constexpr char kMagic[8] = {'M', 'F', 'U', 'P', 'S', 'I', 'M', 'X'};
+    static constexpr uint32_t kVersion = 1;
+    static constexpr uint64_t kDataAlignment = 4096;
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t layout;           // 0 = 列主序（本版本只写列主序）
+        uint64_t rows;
+        uint64_t cols;
+        uint64_t modulus;
+        uint64_t data_offset;
+        uint64_t data_bytes;
+        uint64_t reserved;
+    };
+    static_assert(sizeof(Header) == 64, "matrix file header must stay 64 bytes");
+
+    /**
+     * 访问模式提示（madvise）：Sequential 用于整体预处理，Random 用于按列访问
+     */
+    enum class Access { Sequential, Random };
+
+    /**
+     * 将矩阵写入文件（任意布局的矩阵都按列写出），modulus 记录在头部供加载时校验
+     */
+    static void save(const std::string& path, const DenseMatrix& M, uint64_t modulus) {
+        Header header{};
+        std::memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.version = kVersion;
+        header.layout = 0;
+        header.rows = M.rows();
+        header.cols = M.cols();
+        header.modulus = modulus;
+        header.data_offset = kDataAlignment;
+        header.data_bytes = M.size() * sizeof(uint64_t);
+
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            throw std::runtime_error("cannot create matrix file " + path);
+        }
+        std::vector<char> head(header.data_offset, 0);
+        std::memcpy(head.data(), &header, sizeof(header));
+        out.write(head.data(), head.size());
+
+        std::vector<uint64_t> column(M.rows());
+        for (size_t j = 0; j < M.cols(); j++) {
+            auto col = M.col(j);
+            const uint64_t* src = col.data();
+            if (!col.is_contiguous()) {
+                for (size_t i = 0; i < M.rows(); i++) column[i] = col[i];
+                src = column.data();
+            }
+            out.write(reinterpret_cast<const char*>(src), M.rows() * sizeof(uint64_t));
+        }
+        if (!out) {
+            throw std::runtime_error("failed to write matrix file " + path);
+        }
+    }
+
+    /**
+     * 映射文件为列主序矩阵；expected_modulus 非0时与头部记录的模数比较
+     */
+    static DenseMatrix map(const std::string& path, uint64_t expected_modulus = 0,
+                           Access access = Access::Random) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("cannot open matrix file " + path + ": " + std::strerror(errno));
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || static_cast<uint64_t>(st.st_size) < sizeof(Header)) {
+            ::close(fd);
+            throw std::runtime_error("matrix file too short: " + path);
+        }
+        size_t length = static_cast<size_t>(st.st_size);
+        void* base = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        ::close(fd);  // 映射在关闭文件描述符后依然有效
+        if (base == MAP_FAILED) {
+            throw std::runtime_error("cannot map matrix file " + path + ": " + std::strerror(errno));
+        }
+        auto mapping = std::make_shared<Mapping>(base, length);
+
+        Header header;
+        std::memcpy(&header, base, sizeof(header));
+        if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+            throw std::runtime_error("not a matrix file: " + path);
+        }
+        if (header.version != kVersion) {
+            throw std::runtime_error("unsupported matrix file version " + std::to_string(header.version));
+        }
+        // 头部字段不可信：行列数与偏移的乘加都要检查溢出，否则回绕后的小 data_bytes
+        // 可以通过校验，得到越出映射区域的矩阵
+        uint64_t elements = 0;
+        uint64_t expected_bytes = 0;
+        uint64_t data_end = 0;
+        if (header.layout != 0 || header.data_offset % kDataAlignment != 0 ||
+            __builtin_mul_overflow(header.rows, header.cols, &elements) ||
+            __builtin_mul_overflow(elements, sizeof(uint64_t), &expected_bytes) ||
+            header.data_bytes != expected_bytes ||
+            __builtin_add_overflow(header.data_offset, header.data_bytes, &data_end) ||
+            data_end > length) {
+            throw std::runtime_error("corrupt matrix file header: " + path);
+        }
+        if (expected_modulus != 0 && header.modulus != expected_modulus) {
+            throw std::runtime_error("matrix file modulus mismatch: " + path);
+        }
+
+        uint8_t* data = static_cast<uint8_t*>(base) + header.data_offset;
+        madvise(data, header.data_bytes, access == Access::Sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+        return DenseMatrix::external(reinterpret_cast<uint64_t*>(data), header.rows, header.cols,
+                                     DenseMatrix::Layout::ColMajor, mapping);
+    }
+
+    /**
+     * 调整已映射矩阵的访问模式提示（如预处理完成后改为按列随机访问）
+     */
+    static void advise(const DenseMatrix& M, Access access) {
+        if (M.owns_data() || M.empty()) return;
+        uintptr_t begin = reinterpret_cast<uintptr_t>(M.data()) & ~(kDataAlignment - 1);
+        uintptr_t end = reinterpret_cast<uintptr_t>(M.data() + M.size());
+        madvise(reinterpret_cast<void*>(begin), end - begin,
+                access == Access::Sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+    }
+
+private:
+    /**
+     * 映射区域的所有者，最后一个引用释放时 munmap
+     */
+    struct Mapping {
+        void* base;
+        size_t length;
+        Mapping(void* b, size_t n) : base(b), length(n) {}
+        ~Mapping() { munmap(base, length); }
+        Mapping(const Mapping&) = delete;
+        Mapping& operator=(const Mapping&) = delete;
+    };
+};
+
+#endif // MATRIX_FILE_H
@@ -0,0 +1,446 @@
+#include "benchmark.h"
+#include "band_solver.h"
+#include "matrix.h"
+#include "prg.h"
+#include "utils.h"
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/**
+ * Matrix / Utils / BandSolver 内核的微基准
+ *
+ * 每个内核在隔离环境下按 d_1、w、b 和模数宽度扫描参数。单次样本重复调用内核
+ * 直到耗时不少于 kMinSampleNs，取 reps 个样本的中位数作为单次调用耗时，报告：
+ *   - 每秒处理的元素数与估算的内存流量（GB/s，按内核读写的字节数计）
+ *   - 每元素周期数（x86上为TSC参考周期，与睿频无关；其他平台不输出）
+ * 元素与字节的口径见各内核的注释；用于同一台机器上不同提交之间的对照。
+ */
+
+namespace {
+
+constexpr int64_t kMinSampleNs = 2000000;
+
+/**
+ * 阻止编译器把内核的结果当作死代码消除
+ */
+template <typename T>
+inline void do_not_optimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+inline uint64_t read_cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+struct Options {
+    size_t repetitions = 5;
+    std::string filter;       // 只运行名称包含该子串的内核
+    std::string csv;          // CSV输出路径（空则只打印表格）
+    bool help = false;
+
+    static Options parse(int argc, char** argv) {
+        Options options;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            auto value = [&]() -> std::string {
+                if (i + 1 >= argc) {
+                    throw std::invalid_argument("missing value for " + arg);
+                }
+                return argv[++i];
+            };
+            if (arg == "-h" || arg == "--help") {
+                options.help = true;
+            } else if (arg == "-r" || arg == "--reps") {
+                options.repetitions = std::stoul(value());
+                if (options.repetitions == 0) {
+                    throw std::invalid_argument("--reps must be positive");
+                }
+            } else if (arg == "-k" || arg == "--filter") {
+                options.filter = value();
+            } else if (arg == "-o" || arg == "--csv") {
+                options.csv = value();
+            } else {
+                throw std::invalid_argument("unknown option: " + arg);
+            }
+        }
+        return options;
+    }
+};
+
+/**
+ * 一次 (内核, 参数) 测量的结果
+ */
+struct Result {
+    std::string kernel;
+    std::string params;
+    double elements;          // 每次调用处理的元素数
+    double bytes;             // 每次调用读写的字节数
+    Benchmark::Summary ns;    // 每次调用耗时（纳秒）
+    double cycles_per_call;
+};
+
+class Runner {
+public:
+    explicit Runner(const Options& options) : options_(options) {}
+
+    /**
+     * 测量 fn 的单次调用耗时；elements/bytes 为每次调用处理的元素数与字节数
+     */
+    void run(const std::string& kernel, const std::string& params,
+             double elements, double bytes, const std::function<void()>& fn) {
+        if (!options_.filter.empty() && kernel.find(options_.filter) == std::string::npos) {
+            return;
+        }
+        // 预热并确定每个样本的调用次数
+        size_t iters = 1;
+        for (;;) {
+            Utils::Timer timer;
+            timer.start();
+            for (size_t i = 0; i < iters; i++) fn();
+            timer.stop();
+            if (timer.elapsed_ns() >= kMinSampleNs || iters >= (1u << 30)) break;
+            iters *= 2;
+        }
+
+        std::vector<double> samples;
+        std::vector<double> cycles;
+        for (size_t r = 0; r < options_.repetitions; r++) {
+            Utils::Timer timer;
+            uint64_t c0 = read_cycles();
+            timer.start();
+            for (size_t i = 0; i < iters; i++) fn();
+            timer.stop();
+            uint64_t c1 = read_cycles();
+            samples.push_back(static_cast<double>(timer.elapsed_ns()) / iters);
+            cycles.push_back(static_cast<double>(c1 - c0) / iters);
+        }
+
+        Result result{kernel, params, elements, bytes, Benchmark::Summary::of(samples),
+                      Benchmark::Summary::of(cycles).p50};
+        print(result);
+        results_.push_back(result);
+    }
+
+    void print_header() const {
+        std::cout << std::left << std::setw(24) << "kernel" << std::setw(30) << "params"
+                  << std::right << std::setw(14) << "ns/call" << std::setw(10) << "stddev%"
+                  << std::setw(14) << "Melem/s" << std::setw(10) << "GB/s"
+                  << std::setw(12) << "cyc/elem" << std::endl;
+    }
+
+    void write_csv(const std::string& path) const {
+        std::ofstream out(path);
+        if (!out.is_open()) {
+            throw std::runtime_error("cannot open " + path);
+        }
+        out << "kernel,params,elements,bytes,reps,ns_p50,ns_mean,ns_stddev,ns_min,ns_max,"
+            << "elements_per_s,GB_per_s,cycles_per_element\n";
+        out << std::setprecision(9);
+        for (const auto& r : results_) {
+            out << r.kernel << ",\"" << r.params << "\"," << r.elements << "," << r.bytes << ","
+                << r.ns.count << "," << r.ns.p50 << "," << r.ns.mean << "," << r.ns.stddev << ","
+                << r.ns.min << "," << r.ns.max << "," << elements_per_s(r) << ","
+                << gb_per_s(r) << "," << cycles_per_element(r) << "\n";
+        }
+    }
+
+private:
+    const Options& options_;
+    std::vector<Result> results_;
+
+    static double elements_per_s(const Result& r) { return r.elements / (r.ns.p50 * 1e-9); }
+    static double gb_per_s(const Result& r) { return r.bytes / r.ns.p50; }
+    static double cycles_per_element(const Result& r) { return r.cycles_per_call / r.elements; }
+
+    static void print(const Result& r) {
+        std::cout << std::left << std::setw(24) << r.kernel << std::setw(30) << r.params
+                  << std::right << std::fixed
+                  << std::setw(14) << std::setprecision(1) << r.ns.p50
+                  << std::setw(10) << std::setprecision(2) << (r.ns.mean > 0 ? 100.0 * r.ns.stddev / r.ns.mean : 0.0)
+                  << std::setw(14) << std::setprecision(2) << elements_per_s(r) / 1e6
+                  << std::setw(10) << std::setprecision(2) << gb_per_s(r)
+                  << std::setw(12) << std::setprecision(2) << cycles_per_element(r)
+                  << std::endl;
+    }
+};
+
+struct Modulus {
+    const char* name;
+    uint64_t q;
+};
+
+// 三种模数分别走 Mod32、通用 Barrett64 与 Mod64 特化路径
+const Modulus kModuli[] = {
+    {"q32", (1ULL << 32) - 5},
+    {"q61", (1ULL << 61) - 1},
+    {"q64", 18446744073709551557ULL},
+};
+
+std::string params(std::initializer_list<std::pair<const char*, uint64_t>> values, const char* q = nullptr) {
+    std::string s;
+    for (const auto& v : values) {
+        if (!s.empty()) s += " ";
+        s += std::string(v.first) + "=" + std::to_string(v.second);
+    }
+    if (q) {
+        s += std::string(" ") + q;
+    }
+    return s;
+}
+
+std::vector<uint64_t> random_elements(size_t count, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::vector<uint64_t> elements(count);
+    for (auto& x : elements) x = rng();
+    return elements;
+}
+
+/**
+ * hash_partition（逐个 / 批量）：每个元素一次哈希；元素 = 输入数，字节 = 8/元素（批量另计写出）
+ */
+void bench_hash_partition(Runner& runner) {
+    const size_t count = 1 << 16;
+    auto elements = random_elements(count, 1);
+    runner.run("hash_partition", params({{"count", count}}), count, count * 8.0, [&]() {
+        uint64_t acc = 0;
+        for (uint64_t x : elements) acc += Utils::hash_partition(0x1234, x) % 1536;
+        do_not_optimize(acc);
+    });
+    std::vector<uint64_t> hashes(count);
+    runner.run("hash_partition_batch", params({{"count", count}}), count, count * 16.0, [&]() {
+        Utils::hash_partition_batch(0x1234, elements.data(), count, hashes.data());
+        do_not_optimize(hashes.data());
+    });
+}
+
+/**
+ * sparse_vector / band_bits（逐个 / 批量）：元素 = 查询数 × w 个系数；字节 = 写出的向量
+ */
+void bench_sparse_vector(Runner& runner) {
+    const size_t count = 256;
+    auto elements = random_elements(count, 2);
+    for (size_t d1 : {128, 512, 1024}) {
+        for (size_t w : {30, 80, 100}) {
+            if (w > d1) continue;
+            runner.run("sparse_vector", params({{"d1", d1}, {"w", w}}), count * w, count * d1 * 1.0, [&]() {
+                for (uint64_t x : elements) {
+                    auto v = Utils::sparse_vector(0x5678, x, d1, w);
+                    do_not_optimize(v.data());
+                }
+            });
+        }
+    }
+    for (size_t w : {30, 80, 100}) {
+        runner.run("band_bits", params({{"w", w}}), count * w, count * ((w + 63) / 64) * 8.0, [&]() {
+            uint64_t words[2];
+            for (uint64_t x : elements) {
+                words[0] = words[1] = 0;
+                Utils::band_bits(0x5678, x, w, words);
+                do_not_optimize(words);
+            }
+        });
+        std::vector<uint64_t> rows(count * ((w + 63) / 64));
+        runner.run("band_bits_batch", params({{"w", w}}), count * w, rows.size() * 8.0, [&]() {
+            Utils::band_bits_batch(0x5678, elements.data(), count, w, rows.data());
+            do_not_optimize(rows.data());
+        });
+    }
+}
+
+/**
+ * 构造一个分区的带状系统：m = d_1 / (1 + ε) 行，与Setup中满载分区的规模一致
+ */
+void fill_band_system(BandSolver::System& sys, const std::vector<uint64_t>& elements,
+                      size_t d1, size_t w, uint64_t q) {
+    sys.reset(d1, w, elements.size());
+    for (uint64_t x : elements) {
+        size_t pos = Utils::band_position(0x5678, x, d1, w);
+        uint64_t* bits = sys.add_row(pos, Utils::prf_value(0x9abc, x) % q);
+        Utils::band_bits(0x5678, x, w, bits);
+    }
+}
+
+/**
+ * BandSolver::solve：元素 = 方程数 m；字节 = 位图行与右侧常数（每行 8·words + 16）
+ * 计时包含系统的重建（solve 原地修改系数），与 encode_partition 的工作量一致
+ */
+void bench_band_solver(Runner& runner) {
+    for (const auto& modulus : kModuli) {
+        for (size_t d1 : {128, 512, 1024}) {
+            for (size_t w : {30, 80, 100}) {
+                if (w > d1) continue;
+                size_t m = static_cast<size_t>(d1 / 1.2);
+                auto elements = random_elements(m, d1 * 131 + w);
+                BandSolver::System sys;
+                std::vector<uint64_t> e;
+                double bytes = m * (8.0 * ((w + 63) / 64) + 16.0);
+                runner.run("band_solver", params({{"d1", d1}, {"w", w}, {"m", m}}, modulus.name), m, bytes, [&]() {
+                    fill_band_system(sys, elements, d1, w, modulus.q);
+                    BandSolver::solve(sys, modulus.q, e);
+                    do_not_optimize(e.data());
+                });
+            }
+        }
+    }
+}
+
+/**
+ * 稠密 gaussian_elimination：元素 = 方程数 m；字节 = 增广矩阵 m × (d_1 + 1)
+ */
+void bench_gaussian_elimination(Runner& runner) {
+    for (const auto& modulus : kModuli) {
+        for (size_t d1 : {64, 128, 256}) {
+            size_t w = std::min<size_t>(30, d1);
+            size_t m = static_cast<size_t>(d1 / 1.2);
+            auto elements = random_elements(m, d1 * 17);
+            Matrix::MatrixType M(m, d1, Matrix::Layout::RowMajor);
+            std::vector<uint64_t> y(m);
+            for (size_t i = 0; i < m; i++) {
+                auto v = Utils::sparse_vector(0x5678, elements[i], d1, w);
+                for (size_t j = 0; j < d1; j++) M(i, j) = v[j];
+                y[i] = Utils::prf_value(0x9abc, elements[i]) % modulus.q;
+            }
+            runner.run("gaussian_elimination", params({{"d1", d1}, {"w", w}, {"m", m}}, modulus.name),
+                       m, m * (d1 + 1) * 8.0, [&]() {
+                auto e = Matrix::gaussian_elimination(M, y, modulus.q);
+                do_not_optimize(e.data());
+            });
+        }
+    }
+}
+
+/**
+ * matrix_add：元素 = d_1 × b；字节 = 读两个矩阵写一个
+ */
+void bench_matrix_add(Runner& runner) {
+    for (const auto& modulus : kModuli) {
+        for (size_t d1 : {128, 512, 1024}) {
+            for (size_t b : {256, 1536}) {
+                auto A = Matrix::random_matrix(d1, b, modulus.q);
+                auto B = Matrix::random_matrix(d1, b, modulus.q);
+                double n = static_cast<double>(d1) * b;
+                runner.run("matrix_add", params({{"d1", d1}, {"b", b}}, modulus.name), n, n * 24, [&]() {
+                    auto C = Matrix::matrix_add(A, B, modulus.q);
+                    do_not_optimize(C.data());
+                });
+            }
+        }
+    }
+}
+
+/**
+ * accumulate_many（服务器聚合）：把一轮n个 d_1 × chunk 上传分块一次归约进目标列区间；
+ * 元素 = n × d_1 × chunk；字节 = 读n个上传分块 + 读写目标列
+ */
+void bench_accumulate_many(Runner& runner) {
+    const size_t n = 10;
+    const size_t chunk = 64;
+    for (const auto& modulus : kModuli) {
+        for (size_t d1 : {128, 512, 1024}) {
+            std::vector<Matrix::MatrixType> uploads;
+            for (size_t i = 0; i < n; i++) uploads.push_back(Matrix::random_matrix(d1, chunk, modulus.q));
+            std::vector<const Matrix::MatrixType*> srcs;
+            for (const auto& u : uploads) srcs.push_back(&u);
+            auto dst = Matrix::zero_matrix(d1, chunk);
+            double cells = static_cast<double>(d1) * chunk;
+            runner.run("accumulate_many", params({{"n", n}, {"d1", d1}, {"chunk", chunk}}, modulus.name),
+                       n * cells, (n + 2) * cells * 8, [&]() {
+                Matrix::accumulate_many(dst, 0, srcs, modulus.q);
+                do_not_optimize(dst.data());
+            });
+        }
+    }
+}
+
+/**
+ * vector_matrix_multiply：元素 = d_1 × b 次乘加；字节 = 读矩阵
+ */
+void bench_vector_matrix_multiply(Runner& runner) {
+    for (const auto& modulus : kModuli) {
+        for (size_t d1 : {128, 512, 1024}) {
+            for (size_t b : {256, 1536}) {
+                auto M = Matrix::random_matrix(d1, b, modulus.q);
+                std::vector<uint64_t> v(d1);
+                Prg::expand_mod(Prg::random_key(), 1, modulus.q, v.data(), v.size());
+                double n = static_cast<double>(d1) * b;
+                runner.run("vector_matrix_multiply", params({{"d1", d1}, {"b", b}}, modulus.name), n, n * 8, [&]() {
+                    auto r = Matrix::vector_matrix_multiply(v, M, modulus.q);
+                    do_not_optimize(r.data());
+                });
+            }
+        }
+    }
+}
+
+/**
+ * Prg::expand_mod（掩码展开）：元素 = 输出的 Z_q 元素数；字节 = 写出
+ */
+void bench_prg(Runner& runner) {
+    auto key = Prg::random_key();
+    for (const auto& modulus : kModuli) {
+        for (size_t d1 : {128, 512, 1024}) {
+            std::vector<uint64_t> out(d1);
+            runner.run("prg_expand_mod", params({{"d1", d1}}, modulus.name), d1, d1 * 8.0, [&]() {
+                Prg::expand_mod(key, 7, modulus.q, out.data(), out.size());
+                do_not_optimize(out.data());
+            });
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    auto print_usage = [&](std::ostream& os) {
+        os << "用法: " << argv[0] << " [选项]\n"
+           << "  -r, --reps N       每个测量的样本数（默认 5）\n"
+           << "  -k, --filter NAME  只运行名称包含 NAME 的内核\n"
+           << "  -o, --csv PATH     同时写出CSV结果\n";
+    };
+    Options options;
+    try {
+        options = Options::parse(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << "错误：" << e.what() << std::endl;
+        print_usage(std::cerr);
+        return 1;
+    }
+    if (options.help) {
+        print_usage(std::cout);
+        return 0;
+    }
+
+    try {
+        Runner runner(options);
+        runner.print_header();
+        bench_hash_partition(runner);
+        bench_sparse_vector(runner);
+        bench_prg(runner);
+        bench_band_solver(runner);
+        bench_gaussian_elimination(runner);
+        bench_matrix_add(runner);
+        bench_accumulate_many(runner);
+        bench_vector_matrix_multiply(runner);
+        if (!options.csv.empty()) {
+            runner.write_csv(options.csv);
+            std::cout << "结果已保存至: " << options.csv << std::endl;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "错误：" << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,269 @@
+#ifndef MODARITH_H
+#define MODARITH_H
+
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+/**
+ * 有限域Z_q模运算策略（编译期按模数特化）
+ *
+ * Utils::mul_mod 对运行时模数做 __uint128_t % q，在x86-64上会编译为
+ * __umodti3 库调用。这里为实验中实际使用的两个模数提供无除法、无分支的
+ * 特化实现，其余模数退化为预计算常数的Barrett约减：
+ *   - PseudoMersenne64<C>: q = 2^64 - C（默认配置 2^64 - 59）
+ *   - PseudoMersenne32<C>: q = 2^32 - C（测试配置 2^32 - 5）
+ *   - Barrett64:           任意 q < 2^64
+ *
+ * 所有策略提供相同的接口：
+ *   modulus()            模数q
+ *   add/sub/mul(a, b)    输入须已约减（a, b < q）
+ *   reduce(x)            将128位整数约减到 [0, q)
+ *   mac(acc, a, b)       惰性累加 acc += a * b，点积循环内不做完整约减
+ *   reduce(acc)          累加结束后一次性约减
+ *   kMacTerms            __uint128_t 累加器不溢出的 mac 项数上限
+ *
+ * 各策略 mac 单项的上界不同，kMacTerms 随之不同：
+ *   - PseudoMersenne64<C>: 单项 < (C+1)·2^64，上限 floor((2^64-1)/(C+1))，
+ *                          C < 2^16 时至少 2^48，C = 59 时约 2^58
+ *   - PseudoMersenne32<C>: 单项 < 2^64，上限 2^64 - 1
+ *   - Barrett64:           单项已约减到 [0, q)，上限 2^64 - 1
+ * 均远大于 d_1 和 b。
+ */
+
+class ModArith {
+public:
+    using u128 = __uint128_t;
+
+    /**
+     * q = 2^64 - C，C 为小常数
+     * 利用 2^64 ≡ C (mod q)：hi * 2^64 + lo ≡ hi * C + lo
+     */
+    template <uint64_t C>
+    struct PseudoMersenne64 {
+        static_assert(C > 0 && C < (1ULL << 16), "C must be small");
+        static constexpr uint64_t kModulus = 0 - C;
+        static constexpr uint64_t kMacTerms = ~0ULL / (C + 1);
+
+        constexpr uint64_t modulus() const { return kModulus; }
+
+        uint64_t add(uint64_t a, uint64_t b) const {
+            uint64_t s = a + b;
+            uint64_t t = s + C;  // s - q (mod 2^64)
+            bool wrap = (s < a) | (s >= kModulus);
+            return wrap ? t : s;
+        }
+
+        uint64_t sub(uint64_t a, uint64_t b) const {
+            uint64_t d = a - b;
+            return (a < b) ? d - C : d;  // 借位时 d + q
+        }
+
+        uint64_t reduce(u128 x) const {
+            // 第一次折叠：x < 2^128 -> y < 2^64 + 2^64 * C
+            u128 y = static_cast<u128>(static_cast<uint64_t>(x >> 64)) * C + static_cast<uint64_t>(x);
+            // 第二次折叠：y >> 64 <= C -> z < 2^64 + C^2
+            u128 z = static_cast<u128>(static_cast<uint64_t>(y >> 64)) * C + static_cast<uint64_t>(y);
+            // 第三次折叠：z >> 64 <= 1，此时低64位很小，结果不再溢出
+            uint64_t r = static_cast<uint64_t>(z) + static_cast<uint64_t>(z >> 64) * C;
+            return (r >= kModulus) ? r - kModulus : r;
+        }
+
+        uint64_t mul(uint64_t a, uint64_t b) const {
+            return reduce(static_cast<u128>(a) * b);
+        }
+
+        void mac(u128& acc, uint64_t a, uint64_t b) const {
+            u128 p = static_cast<u128>(a) * b;
+            acc += static_cast<u128>(static_cast<uint64_t>(p >> 64)) * C + static_cast<uint64_t>(p);
+        }
+    };
+
+    /**
+     * q = 2^32 - C，元素存放在uint64_t中但始终小于2^32
+     * 乘积小于2^64，可以直接在128位累加器中累加
+     */
+    template <uint64_t C>
+    struct PseudoMersenne32 {
+        static_assert(C > 0 && C < (1ULL << 8), "C must be small");
+        static constexpr uint64_t kModulus = (1ULL << 32) - C;
+        static constexpr uint64_t kMacTerms = ~0ULL;
+
+        constexpr uint64_t modulus() const { return kModulus; }
+
+        uint64_t add(uint64_t a, uint64_t b) const {
+            uint64_t s = a + b;
+            return (s >= kModulus) ? s - kModulus : s;
+        }
+
+        uint64_t sub(uint64_t a, uint64_t b) const {
+            uint64_t d = a - b;
+            return (a < b) ? d + kModulus : d;
+        }
+
+        static uint64_t fold(uint64_t x) {
+            return (x >> 32) * C + (x & 0xFFFFFFFFULL);
+        }
+
+        uint64_t reduce(u128 x) const {
+            // 2^64 ≡ C^2 (mod q)
+            uint64_t hi = static_cast<uint64_t>(x >> 64);
+            uint64_t lo = static_cast<uint64_t>(x);
+            uint64_t r = fold(fold(lo)) + fold(fold(hi)) * (C * C);
+            r = fold(fold(r));
+            return (r >= kModulus) ? r - kModulus : r;
+        }
+
+        uint64_t mul(uint64_t a, uint64_t b) const {
+            uint64_t r = fold(fold(a * b));
+            return (r >= kModulus) ? r - kModulus : r;
+        }
+
+        void mac(u128& acc, uint64_t a, uint64_t b) const {
+            acc += a * b;
+        }
+    };
+
+    /**
+     * 任意模数 q < 2^64 的Barrett约减
+     * 预计算 mu = floor((2^128 - 1) / q)，约减时用乘法估计商
+     */
+    struct Barrett64 {
+        uint64_t q;
+        uint64_t mu_hi;
+        uint64_t mu_lo;
+
+        static constexpr uint64_t kMacTerms = ~0ULL;
+
+        explicit Barrett64(uint64_t modulus_q) : q(modulus_q) {
+            u128 mu = ~static_cast<u128>(0) / q;
+            mu_hi = static_cast<uint64_t>(mu >> 64);
+            mu_lo = static_cast<uint64_t>(mu);
+        }
+
+        uint64_t modulus() const { return q; }
+
+        uint64_t add(uint64_t a, uint64_t b) const {
+            uint64_t s = a + b;
+            bool wrap = (s < a) | (s >= q);
+            return wrap ? s - q : s;
+        }
+
+        uint64_t sub(uint64_t a, uint64_t b) const {
+            uint64_t d = a - b;
+            return (a < b) ? d + q : d;
+        }
+
+        uint64_t reduce(u128 x) const {
+            uint64_t x_hi = static_cast<uint64_t>(x >> 64);
+            uint64_t x_lo = static_cast<uint64_t>(x);
+
+            // qhat = floor(x * mu / 2^128)，误差不超过2
+            u128 lo_lo = static_cast<u128>(x_lo) * mu_lo;
+            u128 lo_hi = static_cast<u128>(x_lo) * mu_hi;
+            u128 hi_lo = static_cast<u128>(x_hi) * mu_lo;
+            u128 hi_hi = static_cast<u128>(x_hi) * mu_hi;
+
+            u128 mid = (lo_lo >> 64) + static_cast<uint64_t>(lo_hi) + static_cast<uint64_t>(hi_lo);
+            u128 qhat = hi_hi + (lo_hi >> 64) + (hi_lo >> 64) + (mid >> 64);
+
+            u128 r = x - qhat * q;
+            while (r >= q) {
+                r -= q;
+            }
+            return static_cast<uint64_t>(r);
+        }
+
+        uint64_t mul(uint64_t a, uint64_t b) const {
+            return reduce(static_cast<u128>(a) * b);
+        }
+
+        void mac(u128& acc, uint64_t a, uint64_t b) const {
+            acc += mul(a, b);
+        }
+    };
+
+    using Mod64 = PseudoMersenne64<59>;  // 2^64 - 59（get_default_config / get_performance_config）
+    using Mod32 = PseudoMersenne32<5>;   // 2^32 - 5 （get_test_config）
+
+    /**
+     * 按运行时模数选择特化策略并调用 f(mod)
+     * 各分支实例化同一个泛型lambda，返回类型必须一致
+     */
+    template <typename F>
+    static decltype(auto) dispatch(uint64_t q, F&& f) {
+        if (q == Mod64::kModulus) {
+            return std::forward<F>(f)(Mod64{});
+        }
+        if (q == Mod32::kModulus) {
+            return std::forward<F>(f)(Mod32{});
+        }
+        return std::forward<F>(f)(Barrett64(q));
+    }
+
+    /**
+     * 快速幂 base^exp mod q
+     */
+    template <typename Mod>
+    static uint64_t pow(const Mod& mod, uint64_t base, uint64_t exp) {
+        uint64_t result = 1 % mod.modulus();
+        while (exp > 0) {
+            if (exp & 1) {
+                result = mod.mul(result, base);
+            }
+            base = mod.mul(base, base);
+            exp >>= 1;
+        }
+        return result;
+    }
+
+    /**
+     * 模逆（Fermat小定理，q为素数），a = 0 时返回0
+     */
+    template <typename Mod>
+    static uint64_t inverse(const Mod& mod, uint64_t a) {
+        if (a == 0) {
+            return 0;
+        }
+        return pow(mod, a, mod.modulus() - 2);
+    }
+
+    /**
+     * 批量求逆（Montgomery技巧）：将 values 中每个元素原地替换为其模逆
+     * 只需一次模幂和约 3k 次模乘，代替 k 次独立的求逆
+     *
+     * 前置条件：q 为素数，所有元素非零
+     */
+    template <typename Mod>
+    static void batch_inverse(const Mod& mod, std::vector<uint64_t>& values) {
+        std::vector<uint64_t> prefix;
+        batch_inverse(mod, values, prefix);
+    }
+
+    /**
+     * 同上，前缀积写入调用者提供的缓冲区（复用其容量）
+     */
+    template <typename Mod>
+    static void batch_inverse(const Mod& mod, std::vector<uint64_t>& values,
+                              std::vector<uint64_t>& prefix) {
+        size_t k = values.size();
+        if (k == 0) return;
+
+        prefix.resize(k);
+        prefix[0] = values[0];
+        for (size_t i = 1; i < k; i++) {
+            prefix[i] = mod.mul(prefix[i - 1], values[i]);
+        }
+
+        uint64_t inv = inverse(mod, prefix[k - 1]);
+        for (size_t i = k; i-- > 1;) {
+            uint64_t inv_i = mod.mul(inv, prefix[i - 1]);
+            inv = mod.mul(inv, values[i]);
+            values[i] = inv_i;
+        }
+        values[0] = inv;
+    }
+};
+
+#endif // MODARITH_H
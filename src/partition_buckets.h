@@ -0,0 +1,76 @@
+#ifndef PARTITION_BUCKETS_H
+#define PARTITION_BUCKETS_H
+
+#include "utils.h"
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+/**
+ * 计数排序分区器：将元素按 F_1(K_1, x) mod b 分桶
+ *
+ * 分区编号稠密地分布在 [0, b)，无需 std::map：
+ *   - 第一遍：计算每个元素的分区号并统计直方图
+ *   - 前缀和得到每个分区的起始偏移
+ *   - 第二遍：按分区号散列到一块连续缓冲区
+ * 每个元素只计算一次哈希（按批向量化），分区j的元素是 data(j) 起的 size(j) 个连续值，
+ * 且保持输入中的相对顺序。
+ */
+
+class PartitionBuckets {
+public:
+    PartitionBuckets() = default;
+
+    /**
+     * 对 [first, last) 中的元素重新分桶（可重复调用，复用已分配的缓冲区）
+     */
+    template <typename It>
+    void build(It first, It last, uint64_t key_k1, size_t num_partitions) {
+        offsets_.assign(num_partitions + 1, 0);
+        ids_.clear();
+        // 按批取出元素并批量哈希（输入可以是任意前向迭代器，如哈希集合）
+        constexpr size_t kBatch = 256;
+        uint64_t batch[kBatch];
+        uint64_t hashes[kBatch];
+        It it = first;
+        while (it != last) {
+            size_t n = 0;
+            for (; n < kBatch && it != last; ++it) {
+                batch[n++] = *it;
+            }
+            Utils::hash_partition_batch(key_k1, batch, n, hashes);
+            for (size_t i = 0; i < n; i++) {
+                size_t j = hashes[i] % num_partitions;
+                ids_.push_back(j);
+                offsets_[j + 1]++;
+            }
+        }
+        for (size_t j = 0; j < num_partitions; j++) {
+            offsets_[j + 1] += offsets_[j];
+        }
+
+        elements_.resize(ids_.size());
+        cursor_.assign(offsets_.begin(), offsets_.end() - 1);
+        size_t k = 0;
+        for (It it = first; it != last; ++it, ++k) {
+            elements_[cursor_[ids_[k]]++] = *it;
+        }
+    }
+
+    size_t num_partitions() const { return offsets_.empty() ? 0 : offsets_.size() - 1; }
+    size_t num_elements() const { return elements_.size(); }
+
+    /**
+     * 分区j的元素个数与首地址
+     */
+    size_t size(size_t j) const { return offsets_[j + 1] - offsets_[j]; }
+    const uint64_t* data(size_t j) const { return elements_.data() + offsets_[j]; }
+
+private:
+    std::vector<size_t> offsets_;     // b + 1 个偏移，分区j占 [offsets_[j], offsets_[j+1])
+    std::vector<uint64_t> elements_;  // 按分区连续存放的元素
+    std::vector<size_t> ids_;         // 第一遍计算的分区号（第二遍复用，避免重复哈希）
+    std::vector<size_t> cursor_;      // 第二遍的写指针
+};
+
+#endif // PARTITION_BUCKETS_H
@@ -0,0 +1,153 @@
+#ifndef PARTITION_INDEX_H
+#define PARTITION_INDEX_H
+
+#include "partition_buckets.h"
+#include "utils.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+/**
+ * 客户端持久的 分区 -> 元素 索引（与 data_set 同步维护）
+ *
+ * 增量更新只需重新编码受影响的分区，有了索引后重新编码分区j的代价
+ * 只与 |P_j| 有关，不再随数据集大小 N_size 增长。
+ *
+ * 存储为带余量的CSR：所有分区共享一块缓冲区，分区j占据
+ * [begin_[j], begin_[j] + capacity_[j]) 这段槽位，前 count_[j] 个有效：
+ *   - insert: 追加到分区末尾；槽位用尽时只把该分区搬到缓冲区尾部并按约1.25倍扩容，
+ *             旧区间成为空闲槽位。单个分区的容量按几何级数增长，搬移代价与其大小成正比，均摊O(1)
+ *   - 空闲槽位超过缓冲区的一半时整体压缩重新布局（代价由产生这些空闲槽位的搬移分摊）
+ *   - erase:  在分区内查找后与末尾元素交换删除（分区内顺序不保证）
+ */
+
+class PartitionIndex {
+public:
+    PartitionIndex() = default;
+
+    /**
+     * 由 [first, last) 中的元素（互不相同）构建索引
+     */
+    template <typename It>
+    void build(It first, It last, uint64_t key_k1, size_t num_partitions) {
+        key_k1_ = key_k1;
+        PartitionBuckets buckets;
+        buckets.build(first, last, key_k1, num_partitions);
+
+        count_.resize(num_partitions);
+        for (size_t j = 0; j < num_partitions; j++) {
+            count_[j] = buckets.size(j);
+        }
+        layout(count_);
+        for (size_t j = 0; j < num_partitions; j++) {
+            std::copy_n(buckets.data(j), count_[j], slots_.begin() + begin_[j]);
+        }
+        num_elements_ = buckets.num_elements();
+    }
+
+    /**
+     * 插入新元素（调用方保证元素此前不在索引中），返回其分区号
+     */
+    size_t insert(uint64_t element) {
+        size_t j = partition_of(element);
+        if (count_[j] == capacity_[j]) {
+            grow(j);
+        }
+        slots_[begin_[j] + count_[j]++] = element;
+        num_elements_++;
+        return j;
+    }
+
+    /**
+     * 删除元素，返回其分区号；元素不存在时返回 num_partitions()
+     */
+    size_t erase(uint64_t element) {
+        size_t j = partition_of(element);
+        uint64_t* first = slots_.data() + begin_[j];
+        uint64_t* last = first + count_[j];
+        uint64_t* it = std::find(first, last, element);
+        if (it == last) {
+            return num_partitions();
+        }
+        *it = *(last - 1);
+        count_[j]--;
+        num_elements_--;
+        return j;
+    }
+
+    size_t partition_of(uint64_t element) const {
+        return Utils::hash_partition(key_k1_, element) % num_partitions();
+    }
+
+    size_t num_partitions() const { return count_.size(); }
+    size_t num_elements() const { return num_elements_; }
+
+    /**
+     * 分区j的元素个数与首地址（连续存储）
+     */
+    size_t size(size_t j) const { return count_[j]; }
+    const uint64_t* data(size_t j) const { return slots_.data() + begin_[j]; }
+
+private:
+    static constexpr size_t kMinSlack = 4;
+
+    uint64_t key_k1_ = 0;
+    std::vector<size_t> begin_;     // 每个分区槽位区间的起点
+    std::vector<size_t> capacity_;  // 每个分区的槽位数
+    std::vector<size_t> count_;     // 每个分区的有效元素数
+    std::vector<uint64_t> slots_;   // 所有分区的槽位
+    size_t free_slots_ = 0;         // 搬走的分区留下的空闲槽位数
+    size_t num_elements_ = 0;
+
+    static size_t capacity_for(size_t n) { return n + n / 4 + kMinSlack; }
+
+    /**
+     * 按各分区大小依次分配带余量的槽位区间（不搬移数据）
+     */
+    void layout(const std::vector<size_t>& sizes) {
+        begin_.resize(sizes.size());
+        capacity_.resize(sizes.size());
+        size_t total = 0;
+        for (size_t j = 0; j < sizes.size(); j++) {
+            begin_[j] = total;
+            capacity_[j] = capacity_for(sizes[j]);
+            total += capacity_[j];
+        }
+        slots_.assign(total, 0);
+        free_slots_ = 0;
+    }
+
+    /**
+     * 分区 full 的槽位用尽：搬到缓冲区尾部并扩容；空闲槽位过多时改为整体压缩
+     */
+    void grow(size_t full) {
+        if (free_slots_ + capacity_[full] > slots_.size() / 2) {
+            compact(full);
+            return;
+        }
+        const size_t at = slots_.size();
+        const size_t capacity = capacity_for(count_[full] + 1);
+        slots_.resize(at + capacity);
+        std::copy_n(slots_.begin() + begin_[full], count_[full], slots_.begin() + at);
+        free_slots_ += capacity_[full];
+        begin_[full] = at;
+        capacity_[full] = capacity;
+    }
+
+    /**
+     * 整体重新布局：按分区号连续存放，所有分区恢复余量，回收空闲槽位
+     */
+    void compact(size_t full) {
+        std::vector<size_t> old_begin = begin_;
+        std::vector<uint64_t> old_slots = std::move(slots_);
+        std::vector<size_t> sizes = count_;
+        sizes[full]++;
+        layout(sizes);
+        for (size_t j = 0; j < num_partitions(); j++) {
+            std::copy_n(old_slots.begin() + old_begin[j], count_[j], slots_.begin() + begin_[j]);
+        }
+    }
+};
+
+#endif // PARTITION_INDEX_H
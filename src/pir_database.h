@@ -0,0 +1,161 @@
+#ifndef PIR_DATABASE_H
+#define PIR_DATABASE_H
+
+#include "dense_matrix.h"
+#include "modarith.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <unistd.h>
+
+/**
+ * PIR数据库：按列分块存储 E_total（d_1 × b），供第一维选择扫描使用
+ *
+ * 第一维选择向量 v' 只在一个w宽窗口 [offset, offset + w) 内非零，
+ * 第一维结果 r[c] = Σ_k v'[offset + k] · E_total[offset + k, c] 只需读取窗口内的w行。
+ *
+ * 布局：每 T 列组成一个分块，块内行主序（d_1 × T）。
+ *   - 窗口内的每一行在块内是一段长度为T的连续内存，累加沿列方向向量化
+ *   - T 按L2容量选择，使一个分块（及其T个累加器）驻留在L2中，
+ *     批量查询时同一分块只从内存读取一次，被批内所有查询复用
+ * 累加器为 (lo, hi) 两个64位数组：加法进位计入hi，最后一次性约减。
+ */
+
+class PirDatabase {
+public:
+    PirDatabase() = default;
+
+    /**
+     * 由列主序或行主序的 E_total 构建分块布局
+     * tile_cols = 0 时按L2容量自动选择
+     */
+    void build(const DenseMatrix& E, size_t tile_cols = 0) {
+        rows_ = E.rows();
+        cols_ = E.cols();
+        tile_cols_ = tile_cols > 0 ? tile_cols : default_tile_cols(rows_, cols_);
+
+        tiles_.clear();
+        for (size_t first = 0; first < cols_; first += tile_cols_) {
+            size_t width = std::min(tile_cols_, cols_ - first);
+            tiles_.push_back(DenseMatrix::uninitialized(rows_, width, DenseMatrix::Layout::RowMajor));
+        }
+        for (size_t j = 0; j < cols_; j++) {
+            update_col(j, E);
+        }
+    }
+
+    /**
+     * 将 E 的第j列写入分块布局（增量更新只需重写被修改的列）
+     */
+    void update_col(size_t j, const DenseMatrix& E) {
+        DenseMatrix& tile = tiles_[j / tile_cols_];
+        size_t c = j % tile_cols_;
+        auto column = E.col(j);
+        for (size_t i = 0; i < rows_; i++) {
+            tile(i, c) = column[i];
+        }
+    }
+
+    size_t rows() const { return rows_; }
+    size_t cols() const { return cols_; }
+    size_t tile_cols() const { return tile_cols_; }
+    size_t num_tiles() const { return tiles_.size(); }
+
+    /**
+     * 一个查询的第一维选择：coeffs 为窗口 [offset, offset + width) 内的系数（已约减），
+     * 结果写入 out[0, cols())
+     */
+    struct Selection {
+        size_t offset;
+        const uint64_t* coeffs;
+        size_t width;
+        uint64_t* out;
+    };
+
+    /**
+     * 批量第一维选择：对每个查询 out[c] = Σ_{k<w} coeffs[k] · E[offset + k, c] (mod q), c ∈ [0, cols())，
+     * coeffs 为窗口内的w个系数（已约减），0/1系数跳过乘法。
+     * 外层按分块、内层按查询循环，每个分块从内存读入一次后在L2中被批内所有查询复用。
+     * 查询按窗口起点排序处理，相邻查询的窗口重叠时共享L1中的行。
+     *
+     * 分块之间相互独立，按分块并行：每个分块写各查询结果中互不重叠的一段，
+     * 累加器按任务私有，分块内完成最终的模约减，无需跨线程合并。
+     */
+    template <typename Mod>
+    void select_rows_batch(const std::vector<Selection>& batch, const Mod& mod,
+                           ThreadPool& pool) const {
+        std::vector<const Selection*> order;
+        order.reserve(batch.size());
+        for (const auto& sel : batch) {
+            order.push_back(&sel);
+        }
+        std::sort(order.begin(), order.end(), [](const Selection* a, const Selection* b) {
+            return a->offset < b->offset;
+        });
+
+        pool.parallel_for(tiles_.size(), [&](size_t t) {
+            std::vector<uint64_t> acc_lo(tile_cols_);
+            std::vector<uint64_t> acc_hi(tile_cols_);
+            for (const Selection* sel : order) {
+                accumulate_tile(tiles_[t], *sel, mod, acc_lo.data(), acc_hi.data(),
+                                sel->out + t * tile_cols_);
+            }
+        });
+    }
+
+private:
+    size_t rows_ = 0;
+    size_t cols_ = 0;
+    size_t tile_cols_ = 1;
+    std::vector<DenseMatrix> tiles_;
+
+    /**
+     * 单个分块上的窗口累加：dst[c] = Σ_k coeffs[k] · tile[offset + k, c] (mod q)
+     */
+    template <typename Mod>
+    static void accumulate_tile(const DenseMatrix& tile, const Selection& sel, const Mod& mod,
+                                uint64_t* lo, uint64_t* hi, uint64_t* dst) {
+        const size_t T = tile.cols();
+        std::fill_n(lo, T, 0);
+        std::fill_n(hi, T, 0);
+
+        for (size_t k = 0; k < sel.width; k++) {
+            uint64_t coeff = sel.coeffs[k];
+            if (coeff == 0) continue;
+            const uint64_t* row = tile.data() + (sel.offset + k) * T;
+            if (coeff == 1) {
+                for (size_t c = 0; c < T; c++) {
+                    uint64_t s = lo[c] + row[c];
+                    hi[c] += (s < lo[c]);
+                    lo[c] = s;
+                }
+            } else {
+                for (size_t c = 0; c < T; c++) {
+                    uint64_t p = mod.mul(coeff, row[c]);
+                    uint64_t s = lo[c] + p;
+                    hi[c] += (s < lo[c]);
+                    lo[c] = s;
+                }
+            }
+        }
+
+        for (size_t c = 0; c < T; c++) {
+            dst[c] = mod.reduce((static_cast<ModArith::u128>(hi[c]) << 64) | lo[c]);
+        }
+    }
+
+    /**
+     * 每个分块占用约一半L2（其余留给累加器和其他数据），列数取8的倍数
+     */
+    static size_t default_tile_cols(size_t rows, size_t cols) {
+        long l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+        size_t budget = (l2 > 0 ? static_cast<size_t>(l2) : (1u << 20)) / 2;
+        size_t T = budget / (std::max<size_t>(rows, 1) * sizeof(uint64_t));
+        T = std::max<size_t>(8, T / 8 * 8);
+        return std::max<size_t>(1, std::min(T, cols));
+    }
+};
+
+#endif // PIR_DATABASE_H
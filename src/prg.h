@@ -0,0 +1,237 @@
+#ifndef PRG_H
+#define PRG_H
+
+#include "thread_pool.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <random>
+
+/**
+ * 计数器模式的ChaCha20伪随机生成器（用于由短种子展开掩码）
+ *
+ * 状态布局采用原始ChaCha的 64位块计数器 + 64位流号：
+ *   words 0-3   常数 "expand 32-byte k"
+ *   words 4-11  256位密钥（种子）
+ *   words 12-13 块计数器
+ *   words 14-15 流号（stream_id）
+ * 同一密钥下不同的流号给出相互独立的密钥流，因此掩码的任意一列
+ * 都可以单独按 (seed, 列号) 重新计算，无需存储整个矩阵。
+ *
+ * 一次并行计算 kLanes 个连续块：每个状态字是一个 kLanes 宽的向量，
+ * 轮函数直接在向量上运算（-march=native 下为一条AVX指令），缓冲后逐个输出64位字。
+ *
+ * 大缓冲区（数据集、随机矩阵）按 kChunkWords 个输出分块，第k块使用流号 stream_base + k，
+ * 各块相互独立，由线程池并行生成；结果只取决于 (key, stream_base)，与线程数无关。
+ */
+
+class Prg {
+public:
+    using Key = std::array<uint32_t, 8>;
+
+    static constexpr size_t kLanes = 8;
+    static constexpr size_t kBlockWords = 16;
+    static constexpr size_t kChunkWords = 1 << 15;
+
+    // 每个状态字在 kLanes 个块上的取值（GCC/Clang向量扩展，无SIMD时退化为标量）
+    using Lanes = uint32_t __attribute__((vector_size(kLanes * sizeof(uint32_t))));
+
+    /**
+     * 生成新的随机种子
+     */
+    static Key random_key() {
+        std::random_device rd;
+        Key key;
+        for (auto& word : key) {
+            word = rd();
+        }
+        return key;
+    }
+
+    /**
+     * (key, stream_id) 对应的密钥流，从块计数器 counter 开始
+     */
+    class Stream {
+    public:
+        // 满足 UniformRandomBitGenerator，可直接用于 <random> 分布与 <algorithm>
+        using result_type = uint64_t;
+        static constexpr result_type min() { return 0; }
+        static constexpr result_type max() { return ~0ULL; }
+
+        Stream(const Key& key, uint64_t stream_id, uint64_t counter = 0) : counter_(counter) {
+            input_[0] = 0x61707865;
+            input_[1] = 0x3320646e;
+            input_[2] = 0x79622d32;
+            input_[3] = 0x6b206574;
+            for (size_t i = 0; i < 8; i++) {
+                input_[4 + i] = key[i];
+            }
+            input_[14] = static_cast<uint32_t>(stream_id);
+            input_[15] = static_cast<uint32_t>(stream_id >> 32);
+        }
+
+        /**
+         * 下一个64位伪随机字
+         */
+        uint64_t next() {
+            if (pos_ == kBufferWords) {
+                refill();
+            }
+            return buffer_[pos_++];
+        }
+
+        result_type operator()() { return next(); }
+
+        /**
+         * 计算从 counter 起的 kLanes 个块，按块顺序写入 out（每块16个32位字）
+         */
+        void blocks(uint64_t counter, uint32_t out[kLanes * kBlockWords]) const {
+            Lanes init[kBlockWords];
+            for (size_t w = 0; w < kBlockWords; w++) {
+                if (w == 12 || w == 13) {
+                    continue;
+                }
+                for (size_t l = 0; l < kLanes; l++) {
+                    init[w][l] = input_[w];
+                }
+            }
+            for (size_t l = 0; l < kLanes; l++) {
+                uint64_t c = counter + l;
+                init[12][l] = static_cast<uint32_t>(c);
+                init[13][l] = static_cast<uint32_t>(c >> 32);
+            }
+
+            Lanes x[kBlockWords];
+            for (size_t w = 0; w < kBlockWords; w++) {
+                x[w] = init[w];
+            }
+            for (int round = 0; round < 10; round++) {
+                quarter_round(x[0], x[4], x[8], x[12]);
+                quarter_round(x[1], x[5], x[9], x[13]);
+                quarter_round(x[2], x[6], x[10], x[14]);
+                quarter_round(x[3], x[7], x[11], x[15]);
+                quarter_round(x[0], x[5], x[10], x[15]);
+                quarter_round(x[1], x[6], x[11], x[12]);
+                quarter_round(x[2], x[7], x[8], x[13]);
+                quarter_round(x[3], x[4], x[9], x[14]);
+            }
+
+            for (size_t w = 0; w < kBlockWords; w++) {
+                Lanes y = x[w] + init[w];
+                for (size_t l = 0; l < kLanes; l++) {
+                    out[l * kBlockWords + w] = y[l];
+                }
+            }
+        }
+
+    private:
+        static constexpr size_t kBufferWords = kLanes * kBlockWords / 2;
+
+        uint32_t input_[kBlockWords] = {};  // 字12/13为计数器，逐块填入
+        uint64_t counter_;
+        uint64_t buffer_[kBufferWords];
+        size_t pos_ = kBufferWords;
+
+        void refill() {
+            uint32_t out[kLanes * kBlockWords];
+            blocks(counter_, out);
+            counter_ += kLanes;
+            for (size_t i = 0; i < kBufferWords; i++) {
+                buffer_[i] = static_cast<uint64_t>(out[2 * i]) | (static_cast<uint64_t>(out[2 * i + 1]) << 32);
+            }
+            pos_ = 0;
+        }
+
+        // 向量参数均按引用传递（按值传递在未启用AVX时会改变调用约定）
+        template <int n>
+        static void xor_rotl(Lanes& v, const Lanes& x) {
+            v ^= x;
+            v = (v << n) | (v >> (32 - n));
+        }
+
+        static void quarter_round(Lanes& a, Lanes& b, Lanes& c, Lanes& d) {
+            a += b; xor_rotl<16>(d, a);
+            c += d; xor_rotl<12>(b, c);
+            a += b; xor_rotl<8>(d, a);
+            c += d; xor_rotl<7>(b, c);
+        }
+    };
+
+    /**
+     * 将 (key, stream_id) 的密钥流展开为 n 个 Z_q 上的均匀元素
+     * 拒绝采样：取与q同位宽的低位，不小于q时丢弃重取（无取模偏差）
+     */
+    static void expand_mod(const Key& key, uint64_t stream_id, uint64_t q, uint64_t* out, size_t n) {
+        const uint64_t mask = bit_mask(q - 1);
+        Stream stream(key, stream_id);
+        uint32_t block[kLanes * kBlockWords];
+        uint64_t counter = 0;
+        size_t i = 0;
+        while (i < n) {
+            stream.blocks(counter, block);
+            counter += kLanes;
+            for (size_t k = 0; k < kLanes * kBlockWords && i < n; k += 2) {
+                uint64_t v = (static_cast<uint64_t>(block[k]) | (static_cast<uint64_t>(block[k + 1]) << 32)) & mask;
+                out[i] = v;
+                i += (v < q);  // 被拒绝的值在下一次迭代中被覆盖
+            }
+        }
+    }
+
+    /**
+     * 将 (key, stream_id) 的密钥流直接写为 n 个均匀的64位字（整块输出，不经缓冲）
+     */
+    static void fill(const Key& key, uint64_t stream_id, uint64_t* out, size_t n) {
+        Stream stream(key, stream_id);
+        uint32_t block[kLanes * kBlockWords];
+        uint64_t counter = 0;
+        for (size_t i = 0; i < n; counter += kLanes) {
+            stream.blocks(counter, block);
+            size_t count = std::min(n - i, kLanes * kBlockWords / 2);
+            for (size_t k = 0; k < count; k++) {
+                out[i + k] = static_cast<uint64_t>(block[2 * k]) | (static_cast<uint64_t>(block[2 * k + 1]) << 32);
+            }
+            i += count;
+        }
+    }
+
+    /**
+     * 分块并行的 fill：第k块（kChunkWords 个字）使用流号 stream_base + k
+     */
+    static void fill(const Key& key, uint64_t stream_base, uint64_t* out, size_t n, ThreadPool& pool) {
+        pool.parallel_for(num_chunks(n), [&](size_t k) {
+            size_t first = k * kChunkWords;
+            fill(key, stream_base + k, out + first, std::min(kChunkWords, n - first));
+        });
+    }
+
+    /**
+     * 分块并行的 expand_mod：第k块（kChunkWords 个元素）使用流号 stream_base + k
+     */
+    static void expand_mod(const Key& key, uint64_t stream_base, uint64_t q, uint64_t* out, size_t n,
+                           ThreadPool& pool) {
+        pool.parallel_for(num_chunks(n), [&](size_t k) {
+            size_t first = k * kChunkWords;
+            expand_mod(key, stream_base + k, q, out + first, std::min(kChunkWords, n - first));
+        });
+    }
+
+    static size_t num_chunks(size_t n) { return (n + kChunkWords - 1) / kChunkWords; }
+
+private:
+    /**
+     * 覆盖x所有有效位的全1掩码
+     */
+    static uint64_t bit_mask(uint64_t x) {
+        x |= x >> 1;
+        x |= x >> 2;
+        x |= x >> 4;
+        x |= x >> 8;
+        x |= x >> 16;
+        x |= x >> 32;
+        return x;
+    }
+};
+
+#endif // PRG_H
@@ -1,164 +1,218 @@
 #include "protocol.h"
+#include "instrumentation.h"
 #include <algorithm>
 #include <cmath>
-#include <random>
 #include <iostream>
 #include <numeric>
+#include <stdexcept>
+#include <thread>
+#include <atomic>
 
 /**
  * 构造函数
  */
-MFUPSIProtocol::MFUPSIProtocol(const Config_t& cfg) : config_(cfg) {
+MFUPSIProtocol::MFUPSIProtocol(const Config_t& cfg)
+    : config_(cfg), pool_(std::make_unique<ThreadPool>(cfg.num_threads)),
+      query_pool_(std::make_unique<ThreadPool>(cfg.num_threads)),
+      hypercube_(cfg.num_partitions, cfg.pir_dimension),
+      shard_map_(hypercube_, cfg.num_partitions, cfg.num_shards) {
+    server_.shard = ShardMap(hypercube_, cfg.num_partitions, 1).range(0);
     clients_.resize(cfg.num_clients);
     for (size_t i = 0; i < cfg.num_clients; i++) {
         clients_[i].client_id = i;
     }
     reset_metrics();
     
-    // 初始化LWE密钥
-    pir_lwe_key_.dimension = cfg.lwe_dimension;
+    // RLWE PIR参数：环维度取 N_lwe，一个多项式至少容纳一个分区列
+    if (cfg.rlwe_pir) {
+        if (cfg.partition_size > cfg.lwe_dimension) {
+            throw std::invalid_argument("RLWE PIR requires partition_size <= lwe_dimension");
+        }
+        rlwe_ctx_ = std::make_unique<Rlwe::Context>(cfg.lwe_dimension);
+        
+        rlwe_packing_ = RlweDatabase::Packing::create(cfg.modulus, cfg.lwe_dimension, cfg.partition_size);
+    }
 }
 
 /**
  * 生成全局密钥
  */
 void MFUPSIProtocol::generate_keys() {
-    std::mt19937_64 rng(std::random_device{}());
-    std::uniform_int_distribution<uint64_t> dist;
+    Prg::Key seed = Prg::random_key();
+    if (config_.key_seed != 0) {
+        seed = Prg::Key{};
+        seed[0] = static_cast<uint32_t>(config_.key_seed);
+        seed[1] = static_cast<uint32_t>(config_.key_seed >> 32);
+    }
+    Prg::Stream rng(seed, 0);
     
-    key_k1_ = dist(rng);
-    key_k2_ = dist(rng);
-    key_kr_ = dist(rng);
+    key_k1_ = rng.next();
+    key_k2_ = rng.next();
+    key_kr_ = rng.next();
 }
 
 /**
  * 为客户端生成随机数据集
+ * 由PRG分块并行生成 size 个64位元素后批量装入；重复元素（概率约 size²/2^65）
+ * 由同一密钥下紧随其后的流号补足
  */
 void MFUPSIProtocol::generate_client_data(Client& client, size_t size) {
-    std::mt19937_64 rng(std::random_device{}());
-    std::uniform_int_distribution<uint64_t> dist;
+    const Prg::Key key = Prg::random_key();
+    std::vector<uint64_t> elements(size);
+    Prg::fill(key, 0, elements.data(), size, *pool_);
     
+    client.data_set.reserve(size);
+    client.data_set.insert(elements.begin(), elements.end());
+    
+    Prg::Stream rng(key, Prg::num_chunks(size));
     while (client.data_set.size() < size) {
-        client.data_set.insert(dist(rng));
+        client.data_set.insert(rng.next());
     }
 }
 
 /**
- * 生成稀疏向量
- * Algorithm 4: RandVector(K_2, x, d_1, w)
+ * 生成稀疏向量的w宽窗口
+ * Algorithm 4: RandVector(K_2, x, d_1, w)，窗口外的系数恒为0，不再展开为d_1维向量
  */
-MFUPSIProtocol::VectorType MFUPSIProtocol::generate_rand_vector(uint64_t element) {
-    auto sparse_uint8 = Utils::sparse_vector(key_k2_, element, config_.partition_size, config_.band_width);
-    VectorType result(sparse_uint8.size());
-    for (size_t i = 0; i < sparse_uint8.size(); i++) {
-        result[i] = static_cast<uint64_t>(sparse_uint8[i]);
-    }
-    return result;
+size_t MFUPSIProtocol::generate_rand_window(uint64_t element, uint64_t* coeffs) {
+    size_t w = config_.band_width;
+    Utils::band_coefficients(key_k2_, element, w, coeffs);
+    return Utils::band_position(key_k2_, element, config_.partition_size, w);
 }
 
 /**
  * 构建带状矩阵和目标向量
+ * 每行只保留RandVector的w宽窗口（w位位图），不再展开为d_1维稠密行
  */
 void MFUPSIProtocol::build_linear_system(
-    const std::vector<uint64_t>& elements,
-    MatrixType& M,
-    VectorType& y
+    const uint64_t* elements,
+    size_t m,
+    BandSolver::System& sys
 ) {
-    size_t m = elements.size();
-    M.resize(m, VectorType(config_.partition_size, 0));
-    y.resize(m);
-    
-    for (size_t i = 0; i < m; i++) {
-        // 生成稀疏向量作为矩阵的一行
-        auto sparse_vec = generate_rand_vector(elements[i]);
-        for (size_t j = 0; j < config_.partition_size; j++) {
-            M[i][j] = sparse_vec[j];
-        }
+    MFUPSI_SCOPE(BuildLinearSystem);
+    size_t w = config_.band_width;
+    sys.reset(config_.partition_size, w, m);
+    MFUPSI_COUNT(BuildLinearSystem, m, m * (sys.words_per_row * 8 + 16), 0);
+    
+    // 按批计算窗口位置、目标值与位图，每个哈希在向量通道上一次处理多个元素
+    constexpr size_t kBatch = 64;
+    uint64_t pos_hash[kBatch];
+    uint64_t y_hash[kBatch];
+    const size_t num_positions = config_.partition_size - w + 1;
+    for (size_t first = 0; first < m; first += kBatch) {
+        const size_t n = std::min(kBatch, m - first);
+        Utils::hash_partition_batch(key_k2_, elements + first, n, pos_hash);
+        Utils::prf_value_batch(key_kr_, elements + first, n, y_hash);
         
-        // 生成目标值
-        y[i] = Utils::prf_value(key_kr_, elements[i]) % config_.modulus;
+        for (size_t i = 0; i < n; i++) {
+            sys.add_row(pos_hash[i] % num_positions, y_hash[i] % config_.modulus);
+        }
+        // 新增的行在位图中连续，整批位图直接写入
+        Utils::band_bits_batch(key_k2_, elements + first, n, w, sys.bits.data() + first * sys.words_per_row);
     }
 }
 
 /**
  * 分区编码
- * Algorithm 3: EncodePartition(P_j, K_2, K_r, d_1, w)
+ * Algorithm 3: EncodePartition(P_j, K_2, K_r, d_1, w)，e_j 直接写入 out[0, d_1)
+ * 返回线性系统是否相容（不相容时该分区的部分元素无法被正确解码）
  */
-MFUPSIProtocol::VectorType MFUPSIProtocol::encode_partition(
-    const std::vector<uint64_t>& partition_elements
+bool MFUPSIProtocol::encode_partition(
+    const uint64_t* partition_elements,
+    size_t count,
+    uint64_t* out
 ) {
-    if (partition_elements.empty()) {
-        return VectorType(config_.partition_size, 0);
+    if (count == 0) {
+        std::fill_n(out, config_.partition_size, 0);
+        return true;
     }
+    MFUPSI_SCOPE(EncodePartition);
+    MFUPSI_COUNT(EncodePartition, count, config_.partition_size * sizeof(uint64_t), 0);
     
-    // 构建线性系统 M * e = y
-    MatrixType M;
-    VectorType y;
-    build_linear_system(partition_elements, M, y);
-    
-    // 高斯消元求解
-    VectorType e_j = Matrix::gaussian_elimination(M, y, config_.modulus);
+    // 构建带状线性系统 M * e = y（复用本线程的求解缓冲区）
+    BandSolver::System& sys = BandSolver::System::local();
+    build_linear_system(partition_elements, count, sys);
     
-    // 确保输出维度正确
-    if (e_j.size() != config_.partition_size) {
-        e_j.resize(config_.partition_size, 0);
-    }
-    
-    return e_j;
+    // 带内高斯消元求解
+    return BandSolver::solve(sys, config_.modulus, out);
 }
 
 /**
- * 客户端本地编码
- * Algorithm 2: ClientEncode(X_i, K_1, K_2, K_r, d_1, w, epsilon)
+ * 客户端本地编码（一个分块）
+ * Algorithm 2: ClientEncode(X_i, K_1, K_2, K_r, d_1, w, epsilon)，只处理分区 [first, last)
+ * 各分区是相互独立的线性系统，在线程池上并行编码，每个任务只写自己的列：
+ * e_j 写入 E_i 的第j列，e_j + s_j 写入上传分块的第 j - first 列
  */
-MFUPSIProtocol::MatrixType MFUPSIProtocol::client_encode(
-    const std::set<uint64_t>& data_set
+MFUPSIProtocol::UploadChunk MFUPSIProtocol::client_encode_chunk(
+    Client& client,
+    size_t first,
+    size_t last
 ) {
-    // 步骤1: 初始化编码矩阵
-    MatrixType E_i(config_.partition_size, VectorType(config_.num_partitions, 0));
-    
-    // 步骤2: 将数据分配到分区
-    std::map<size_t, std::vector<uint64_t>> partitions;
-    
-    for (const auto& element : data_set) {
-        size_t j = Utils::hash_partition(key_k1_, element) % config_.num_partitions;
-        partitions[j].push_back(element);
-    }
-    
-    // 步骤3: 对每个分区进行编码
-    for (const auto& [partition_id, elements] : partitions) {
-        auto e_j = encode_partition(elements);
-        
-        // 将e_j放入编码矩阵的第partition_id列
-        if (partition_id < config_.num_partitions) {
-            for (size_t i = 0; i < config_.partition_size; i++) {
-                E_i[i][partition_id] = e_j[i];
-            }
+    MFUPSI_SCOPE(ClientEncode);
+    const PartitionIndex& index = client.partition_index;
+    MFUPSI_INSTRUMENT_ONLY(
+        size_t chunk_elements = 0;
+        for (size_t j = first; j < last; j++) chunk_elements += index.size(j);
+    )
+    MFUPSI_COUNT(ClientEncode, chunk_elements,
+                 2 * Utils::matrix_size_bytes(config_.partition_size, last - first), 0);
+    
+    UploadChunk chunk;
+    chunk.client_id = client.client_id;
+    chunk.first_col = first;
+    chunk.columns = MatrixType::uninitialized(config_.partition_size, last - first, Matrix::Layout::ColMajor);
+    
+    std::vector<double> task_time_ms(last - first, 0.0);
+    std::atomic<size_t> inconsistent{0};
+    
+    Utils::Timer wall_timer;
+    wall_timer.start();
+    pool_->parallel_for(last - first, [&](size_t t) {
+        Utils::Timer task_timer;
+        task_timer.start();
+        size_t j = first + t;
+        uint64_t* e_j = client.encoding_matrix.col(j).data();
+        if (!encode_partition(index.data(j), index.size(j), e_j)) {
+            inconsistent.fetch_add(1, std::memory_order_relaxed);
         }
+        
+        // 掩码由种子逐列展开，直接与编码相加得到上传列
+        MFUPSI_SCOPE(ApplyMask);
+        MFUPSI_COUNT(ApplyMask, config_.partition_size, 3 * Utils::matrix_size_bytes(config_.partition_size, 1), 0);
+        uint64_t* masked = chunk.columns.col(t).data();
+        expand_mask_column(client, j, masked);
+        Matrix::accumulate_col(chunk.columns, t, e_j, config_.modulus);
+        task_timer.stop();
+        task_time_ms[t] = task_timer.elapsed_ms();
+    });
+    wall_timer.stop();
+    
+    metrics_.setup_encode_wall_time_ms += wall_timer.elapsed_ms();
+    for (double t : task_time_ms) {
+        metrics_.setup_encode_work_time_ms += t;
     }
+    metrics_.encoded_partitions += last - first;
+    metrics_.inconsistent_partitions += inconsistent.load();
     
-    return E_i;
+    return chunk;
 }
 
 /**
- * 生成掩码矩阵
+ * 生成掩码种子（Setup阶段初始化，不计入计时）
  */
-MFUPSIProtocol::MatrixType MFUPSIProtocol::generate_mask_matrix(
-    size_t rows, size_t cols
-) {
-    return Matrix::random_matrix(rows, cols, config_.modulus);
+void MFUPSIProtocol::generate_mask_seeds() {
+    for (auto& client : clients_) {
+        client.mask_seed = Prg::random_key();
+        client.mask_versions.assign(config_.num_partitions, 0);
+    }
 }
 
 /**
- * 生成全局掩码矩阵（Setup阶段初始化，不计入计时）
+ * 展开掩码列：流号由列号和版本号组成，每个 (列, 版本) 对应独立的密钥流
  */
-void MFUPSIProtocol::generate_global_masks() {
-    global_masks_.resize(config_.num_clients);
-    for (size_t i = 0; i < config_.num_clients; i++) {
-        global_masks_[i] = generate_mask_matrix(
-            config_.partition_size, config_.num_partitions
-        );
-    }
+void MFUPSIProtocol::expand_mask_column(const Client& client, size_t j, uint64_t* out) const {
+    uint64_t stream_id = (static_cast<uint64_t>(client.mask_versions[j]) << 32) | j;
+    Prg::expand_mod(client.mask_seed, stream_id, config_.modulus, out, config_.partition_size);
 }
 
 /**
@@ -170,82 +224,176 @@ void MFUPSIProtocol::setup_phase() {
     // 生成全局密钥
     generate_keys();
     
-    // 初始化LWE密钥（用于PIR）
-    initialize_lwe_key();
+    // 初始化PIR查询密钥
+    initialize_pir_key();
     
     // 步骤1: 为每个客户端生成数据集
     for (auto& client : clients_) {
         generate_client_data(client, config_.dataset_size);
     }
     
-    // 步骤2: 生成全局掩码（在计时前）
-    generate_global_masks();
+    // 步骤2: 生成掩码种子（在计时前）
+    generate_mask_seeds();
     
-    // 步骤3: 每个客户端进行本地编码（每个客户端各自计时）
+    // 步骤3-4: 流水线Setup
+    // 客户端按 setup_chunk_partitions 列一块地编码并加掩码，各客户端同一列区间的上传分块
+    // 作为一轮经有界队列交给服务器线程，服务器收到即以一次n路归约累加到 global_encoding。
+    // 编码、掩码与聚合相互重叠，在途的上传轮不超过 setup_queue_depth 个，不再有完整的掩码编码矩阵。
     double total_client_time = 0.0;
-    size_t total_client_comm = 0;
+    double server_time = 0.0;
     
-    for (size_t i = 0; i < clients_.size(); i++) {
-        auto& client = clients_[i];
-        
-        // 客户端编码计时
-        Utils::Timer timer;
-        timer.start();
-        
-        // 客户端编码
-        client.encoding_matrix = client_encode(client.data_set);
-        
-        // 掩码添加（使用预生成的全局掩码）
-        client.mask_matrix = global_masks_[i];
-        client.masked_encoding = Matrix::matrix_add(
-            client.encoding_matrix,
-            client.mask_matrix,
-            config_.modulus
-        );
-        
-        timer.stop();
-        total_client_time += timer.elapsed_ms();
+    server_.global_encoding = Matrix::zero_matrix(
+        config_.partition_size, server_.shard.cols()
+    );
+    
+    BoundedQueue<UploadRound> uploads(config_.setup_queue_depth);
+    std::exception_ptr server_error;
+    std::thread aggregator([&] {
+        try {
+            server_time = server_aggregate(uploads);
+        } catch (...) {
+            server_error = std::current_exception();
+            uploads.close();
+        }
+    });
+    
+    try {
+        auto client_times = client_setup(0, clients_.size(), [&](UploadRound&& round) {
+            return uploads.push(std::move(round));  // 服务器线程出错时队列已关闭
+        });
+        for (double client_time : client_times) {
+            total_client_time += client_time;
+            metrics_.setup_client_samples_ms.push_back(client_time);
+        }
+    } catch (...) {
+        uploads.close();
+        aggregator.join();
+        throw;
+    }
+    uploads.close();
+    aggregator.join();
+    if (server_error) {
+        std::rethrow_exception(server_error);
     }
     
+    // 所有分块到齐后预处理查询布局
+    Utils::Timer publish_timer;
+    publish_timer.start();
+    rebuild_query_snapshots();
+    publish_timer.stop();
+    metrics_.setup_server_aggregation_time_ms = server_time + publish_timer.elapsed_ms();
+    
     metrics_.setup_client_encoding_time_ms = total_client_time;
     
-    // 计算通信开销（在停止计时后）
+    // 计算通信开销（在停止计时后）：每个元素按 Z_q 紧凑编码计
     metrics_.setup_client_comm_bytes = clients_.size() * Utils::matrix_size_bytes(
-        config_.partition_size, config_.num_partitions
+        config_.partition_size, config_.num_partitions, config_.modulus
     );
     
-    // 步骤4: 服务器聚合
-    server_aggregate();
+    persist_server_state();
     
     std::cout << "Setup阶段完成" << std::endl;
-    std::cout << "  客户端编码耗时: " << metrics_.setup_client_encoding_time_ms << " ms" << std::endl;
+    std::cout << "  客户端编码耗时: " << metrics_.setup_client_encoding_time_ms << " ms"
+              << " (" << metrics_.num_threads << " 线程, 并行加速比 "
+              << metrics_.setup_encode_speedup() << "x)" << std::endl;
     std::cout << "  服务器聚合耗时: " << metrics_.setup_server_aggregation_time_ms << " ms" << std::endl;
     std::cout << "  客户端上传通信: " << metrics_.setup_client_comm_bytes / (1024.0 * 1024.0) << " MB" << std::endl;
+    if (!config_.encoding_file.empty()) {
+        std::cout << "  持久化 global_encoding: " << metrics_.setup_persist_time_ms << " ms，"
+                  << "映射热重启: " << metrics_.setup_restore_time_ms << " ms（" << config_.encoding_file << "）" << std::endl;
+    }
 }
 
 /**
- * 服务器聚合
+ * 客户端 [first_client, last_client) 的Setup：建立分区索引后按 setup_chunk_partitions 列一块地编码并加掩码，
+ * 各客户端同一列区间的上传分块作为一轮交给 upload（返回false时停止）；
+ * 返回各客户端耗时（不含 upload 的时间）
  */
-void MFUPSIProtocol::server_aggregate() {
+std::vector<double> MFUPSIProtocol::client_setup(
+    size_t first_client,
+    size_t last_client,
+    const std::function<bool(UploadRound&&)>& upload
+) {
+    size_t chunk_cols = std::max<size_t>(1, config_.setup_chunk_partitions);
+    std::vector<double> client_time(last_client - first_client, 0.0);
     Utils::Timer timer;
-    timer.start();
-    
-    // 初始化全局编码为零矩阵
-    server_.global_encoding = Matrix::zero_matrix(
-        config_.partition_size, config_.num_partitions
-    );
-    
-    // 聚合所有客户端的掩码编码
-    for (const auto& client : clients_) {
-        server_.global_encoding = Matrix::matrix_add(
-            server_.global_encoding,
-            client.masked_encoding,
-            config_.modulus
+    for (size_t i = first_client; i < last_client; i++) {
+        auto& client = clients_[i];
+        timer.start();
+        client.partition_index.build(
+            client.data_set.begin(), client.data_set.end(), key_k1_, config_.num_partitions
+        );
+        client.encoding_matrix = MatrixType::uninitialized(
+            config_.partition_size, config_.num_partitions, Matrix::Layout::ColMajor
         );
+        timer.stop();
+        client_time[i - first_client] += timer.elapsed_ms();
     }
     
-    timer.stop();
-    metrics_.setup_server_aggregation_time_ms = timer.elapsed_ms();
+    for (size_t first = 0; first < config_.num_partitions; first += chunk_cols) {
+        size_t last = std::min(first + chunk_cols, config_.num_partitions);
+        UploadRound round;
+        round.reserve(last_client - first_client);
+        for (size_t i = first_client; i < last_client; i++) {
+            timer.start();
+            round.push_back(client_encode_chunk(clients_[i], first, last));
+            timer.stop();
+            client_time[i - first_client] += timer.elapsed_ms();
+        }
+        if (!upload(std::move(round))) {
+            break;
+        }
+    }
+    return client_time;
+}
+
+/**
+ * 可选：持久化 global_encoding 并从文件映射热重启服务器，之后的阶段使用映射的矩阵
+ */
+void MFUPSIProtocol::persist_server_state() {
+    if (config_.encoding_file.empty()) return;
+    
+    Utils::Timer persist_timer;
+    persist_timer.start();
+    save_server_state(config_.encoding_file);
+    persist_timer.stop();
+    metrics_.setup_persist_time_ms = persist_timer.elapsed_ms();
+    
+    Utils::Timer restore_timer;
+    restore_timer.start();
+    restore_server_state(config_.encoding_file);
+    restore_timer.stop();
+    metrics_.setup_restore_time_ms = restore_timer.elapsed_ms();
+}
+
+/**
+ * 服务器聚合（在独立线程上运行）：逐轮接收上传分块，一轮内各客户端的分块列区间相同，
+ * 以一次n路归约累加到 global_encoding 的对应列（每个目标元素只读写一次）；
+ * 队列关闭且取空后返回，返回值为累加耗时（不含等待分块的时间）
+ */
+double MFUPSIProtocol::server_aggregate(BoundedQueue<UploadRound>& uploads) {
+    double busy_ms = 0.0;
+    UploadRound round;
+    std::vector<const MatrixType*> srcs;
+    while (uploads.pop(round)) {
+        if (round.empty()) continue;
+        Utils::Timer timer;
+        timer.start();
+        MFUPSI_SCOPE(ServerAggregate);
+        MFUPSI_COUNT(ServerAggregate, round.size() * round[0].columns.size(),
+                     (round.size() + 2) * round[0].columns.size() * sizeof(uint64_t), 0);
+        
+        srcs.clear();
+        for (const auto& chunk : round) {
+            srcs.push_back(&chunk.columns);
+        }
+        Matrix::accumulate_many(server_.global_encoding, round[0].first_col - server_.shard.first_col, srcs,
+                                config_.modulus);
+        
+        timer.stop();
+        busy_ms += timer.elapsed_ms();
+    }
+    return busy_ms;
 }
 
 /**
@@ -258,84 +406,22 @@ void MFUPSIProtocol::update_phase(size_t num_clients_to_update) {
     
     double total_client_time = 0.0;
     size_t total_client_comm = 0;
-    std::mt19937_64 rng(std::random_device{}());
-    std::uniform_int_distribution<uint64_t> dist;
+    Prg::Stream rng(Prg::random_key(), 0);
+    std::vector<SparseUpdate> updates;  // 未更新的客户端不上传任何数据
+    updates.reserve(num_clients_to_update);
     
     for (size_t i = 0; i < num_clients_to_update; i++) {
-        auto& client = clients_[i];
-        
-        std::set<uint64_t> X_add, X_del;
-        size_t update_count = std::min(config_.num_updates, config_.dataset_size / 100);
-        
-        for (size_t j = 0; j < update_count / 2; j++) {
-            X_add.insert(dist(rng));
-        }
-        
-        std::vector<uint64_t> data_vec(client.data_set.begin(), client.data_set.end());
-        std::shuffle(data_vec.begin(), data_vec.end(), rng);
-        for (size_t j = 0; j < update_count / 2 && j < data_vec.size(); j++) {
-            X_del.insert(data_vec[j]);
-        }
-        
-        while (X_add.size() < X_del.size()) {
-            X_add.insert(dist(rng));
-        }
-        while (X_del.size() < X_add.size() && X_del.size() < data_vec.size()) {
-            X_del.insert(data_vec[X_del.size()]);
-        }
-        
-        Utils::Timer timer;
-        timer.start();
-        
-        for (const auto& elem : X_add) {
-            client.data_set.insert(elem);
-        }
-        for (const auto& elem : X_del) {
-            client.data_set.erase(elem);
-        }
-        
-        auto delta_E = client_incremental_update(client, X_add, X_del);
-        
-        auto new_mask = generate_mask_matrix(
-            config_.partition_size, config_.num_partitions
-        );
-        auto delta_E_tilde = Matrix::matrix_add(delta_E, new_mask, config_.modulus);
-        client.mask_matrix = new_mask;
-        
-        timer.stop();
-        total_client_time += timer.elapsed_ms();
-        total_client_comm += Utils::matrix_size_bytes(
-            config_.partition_size, config_.num_partitions
-        );
-    }
-    
-    for (size_t i = num_clients_to_update; i < clients_.size(); i++) {
-        auto& client = clients_[i];
-        
-        Utils::Timer timer;
-        timer.start();
-        
-        auto new_mask = generate_mask_matrix(
-            config_.partition_size, config_.num_partitions
-        );
-        client.masked_encoding = Matrix::matrix_add(
-            client.encoding_matrix,
-            new_mask,
-            config_.modulus
-        );
-        client.mask_matrix = new_mask;
-        
-        timer.stop();
-        total_client_time += timer.elapsed_ms();
-        total_client_comm += Utils::matrix_size_bytes(
-            config_.partition_size, config_.num_partitions
+        updates.push_back(client_update(clients_[i], rng));
+        total_client_time += metrics_.update_client_samples_ms.back();
+        total_client_comm += Utils::column_delta_size_bytes(
+            config_.partition_size, updates.back().columns.size(), config_.modulus
         );
     }
     
     metrics_.update_client_time_ms = total_client_time;
     metrics_.update_client_comm_bytes = total_client_comm;
     
-    server_incremental_update();
+    server_incremental_update(updates);
     
     std::cout << "Update阶段完成" << std::endl;
     std::cout << "  客户端更新耗时: " << metrics_.update_client_time_ms << " ms" << std::endl;
@@ -343,10 +429,49 @@ void MFUPSIProtocol::update_phase(size_t num_clients_to_update) {
     std::cout << "  客户端上传通信: " << metrics_.update_client_comm_bytes / (1024.0 * 1024.0) << " MB" << std::endl;
 }
 
+/**
+ * 一个客户端的一轮Update：随机添加与删除各 min(N_upd, N_size/100)/2 个元素，
+ * 同步数据集与分区索引后增量编码；客户端耗时记入 update_client_samples_ms
+ */
+MFUPSIProtocol::SparseUpdate MFUPSIProtocol::client_update(Client& client, Prg::Stream& rng) {
+    std::set<uint64_t> X_add, X_del;
+    size_t update_count = std::min(config_.num_updates, config_.dataset_size / 100);
+    
+    for (size_t j = 0; j < update_count / 2; j++) {
+        X_add.insert(rng.next());
+    }
+    
+    // 从数据集中均匀抽样待删除元素，无需复制并打乱整个数据集
+    const size_t num_del = std::min(update_count / 2, client.data_set.size());
+    while (X_del.size() < num_del) {
+        X_del.insert(client.data_set.sample(rng));
+    }
+    
+    while (X_add.size() < X_del.size()) {
+        X_add.insert(rng.next());
+    }
+    
+    Utils::Timer timer;
+    timer.start();
+    
+    client.data_set.insert(X_add.begin(), X_add.end(), [&](uint64_t elem) {
+        client.partition_index.insert(elem);
+    });
+    client.data_set.erase(X_del.begin(), X_del.end(), [&](uint64_t elem) {
+        client.partition_index.erase(elem);
+    });
+    
+    SparseUpdate update = client_incremental_update(client, X_add, X_del);
+    
+    timer.stop();
+    metrics_.update_client_samples_ms.push_back(timer.elapsed_ms());
+    return update;
+}
+
 /**
  * 客户端增量编码
  */
-MFUPSIProtocol::MatrixType MFUPSIProtocol::client_incremental_update(
+MFUPSIProtocol::SparseUpdate MFUPSIProtocol::client_incremental_update(
     Client& client,
     const std::set<uint64_t>& X_add,
     const std::set<uint64_t>& X_del
@@ -354,335 +479,595 @@ MFUPSIProtocol::MatrixType MFUPSIProtocol::client_incremental_update(
     std::set<size_t> affected_partitions;
     
     for (const auto& elem : X_add) {
-        size_t j = Utils::hash_partition(key_k1_, elem) % config_.num_partitions;
-        affected_partitions.insert(j);
+        affected_partitions.insert(client.partition_index.partition_of(elem));
     }
     for (const auto& elem : X_del) {
-        size_t j = Utils::hash_partition(key_k1_, elem) % config_.num_partitions;
-        affected_partitions.insert(j);
+        affected_partitions.insert(client.partition_index.partition_of(elem));
     }
     
-    MatrixType delta_E = Matrix::zero_matrix(
-        config_.partition_size, config_.num_partitions
-    );
+    MFUPSI_SCOPE(ClientIncrementalUpdate);
+    MFUPSI_COUNT(ClientIncrementalUpdate, X_add.size() + X_del.size(),
+                 affected_partitions.size() * 5 * config_.partition_size * sizeof(uint64_t), 0);
+    
+    SparseUpdate update;
+    update.client_id = client.client_id;
+    update.columns.reserve(affected_partitions.size());
     
+    // 分区索引已随data_set更新，重新编码只读取受影响分区的元素
+    const PartitionIndex& index = client.partition_index;
+    const uint64_t q = config_.modulus;
+    VectorType e_j_new(config_.partition_size);
+    VectorType s_j_old(config_.partition_size);
+    VectorType s_j_new(config_.partition_size);
     for (size_t j : affected_partitions) {
-        std::vector<uint64_t> partition_elements;
-        
-        for (const auto& elem : client.data_set) {
-            if (Utils::hash_partition(key_k1_, elem) % config_.num_partitions == j) {
-                partition_elements.push_back(elem);
-            }
+        metrics_.encoded_partitions++;
+        if (!encode_partition(index.data(j), index.size(j), e_j_new.data())) {
+            metrics_.inconsistent_partitions++;
         }
         
-        auto e_j_new = encode_partition(partition_elements);
+        // 旧掩码列由当前版本重新展开，版本号加一得到新的掩码列
+        expand_mask_column(client, j, s_j_old.data());
+        client.mask_versions[j]++;
+        expand_mask_column(client, j, s_j_new.data());
         
-        VectorType delta_e_j = e_j_new;
+        auto e_j = client.encoding_matrix.col(j);
         
-        for (size_t i = 0; i < config_.partition_size; i++) {
-            delta_E[i][j] = delta_e_j[i];
+        ColumnDelta delta;
+        delta.partition_id = j;
+        delta.values.resize(config_.partition_size);
+        for (size_t r = 0; r < config_.partition_size; r++) {
+            uint64_t delta_e = Utils::sub_mod(e_j_new[r], e_j[r], q);
+            uint64_t delta_s = Utils::sub_mod(s_j_new[r], s_j_old[r], q);
+            delta.values[r] = Utils::add_mod(delta_e, delta_s, q);
+            
+            e_j[r] = e_j_new[r];
         }
+        update.columns.push_back(std::move(delta));
     }
     
-    client.encoding_matrix = Matrix::matrix_add(
-        client.encoding_matrix,
-        delta_E,
-        config_.modulus
-    );
-    
-    return delta_E;
+    return update;
 }
 
 /**
  * 服务器增量更新
  */
-void MFUPSIProtocol::server_incremental_update() {
+void MFUPSIProtocol::server_incremental_update(const std::vector<SparseUpdate>& updates) {
     Utils::Timer timer;
     timer.start();
-    
-    server_.global_encoding = Matrix::zero_matrix(
-        config_.partition_size, config_.num_partitions
-    );
-    
-    for (const auto& client : clients_) {
-        auto masked_enc = Matrix::matrix_add(
-            client.encoding_matrix,
-            client.mask_matrix,
-            config_.modulus
-        );
-        server_.global_encoding = Matrix::matrix_add(
-            server_.global_encoding,
-            masked_enc,
-            config_.modulus
-        );
+    MFUPSI_SCOPE(ServerIncrementalUpdate);
+    
+    // E_total[:, j] += Δẽ_j：只触及被更新的列，代价与受影响分区数成正比
+    std::vector<size_t> touched;  // 本分片内的列号
+    for (const auto& update : updates) {
+        for (const auto& delta : update.columns) {
+            size_t c = delta.partition_id - server_.shard.first_col;
+            Matrix::accumulate_col(
+                server_.global_encoding, c, delta.values.data(), config_.modulus
+            );
+            touched.push_back(c);
+        }
     }
+    std::sort(touched.begin(), touched.end());
+    touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+    MFUPSI_COUNT(ServerIncrementalUpdate, touched.size() * config_.partition_size,
+                 3 * touched.size() * config_.partition_size * sizeof(uint64_t),
+                 rlwe_ctx_ ? touched.size() * rlwe_packing_.num_groups * rlwe_ctx_->ntt_modmuls() : 0);
+    
+    // 查询布局只重新生成被修改的列，在备用快照上完成后整体发布
+    publish_query_database(touched);
     
     timer.stop();
     metrics_.update_server_time_ms = timer.elapsed_ms();
 }
 
-// ===== PIR相关新增函数 =====
+/**
+ * 构建查询布局：RLWE后端为NTT形式的明文多项式，明文后端为分块布局
+ */
+void MFUPSIProtocol::build_query_database(QueryDatabase& db) {
+    if (rlwe_ctx_) {
+        db.rlwe_db.build(*rlwe_ctx_, rlwe_packing_, server_.global_encoding,
+                         server_.shard.rows(), hypercube_.inner_size(), *pool_);
+    } else {
+        db.pir_db.build(server_.global_encoding);
+    }
+}
 
 /**
- * 计算z维PIR中每个维度的大小L = ceil(b^(1/z))
+ * 预处理为查询使用的布局；standby 为同一版本的副本，供之后的Update原地修改
  */
-size_t MFUPSIProtocol::compute_pir_dimension_size() {
-    size_t b = config_.num_partitions;
-    size_t z = config_.pir_dimension;
-    
-    // L = ceil(b^(1/z))
-    double L_float = std::pow(static_cast<double>(b), 1.0 / static_cast<double>(z));
-    return static_cast<size_t>(std::ceil(L_float));
+void MFUPSIProtocol::rebuild_query_snapshots() {
+    MFUPSI_COUNT(ServerAggregate, 0, Utils::matrix_size_bytes(config_.partition_size, server_.shard.cols()),
+                 rlwe_ctx_ ? server_.shard.cols() * rlwe_packing_.num_groups * rlwe_ctx_->ntt_modmuls() : 0);
+    auto db = std::make_shared<QueryDatabase>();
+    build_query_database(*db);
+    auto standby = std::make_shared<QueryDatabase>(*db);
+    std::unique_lock<std::mutex> lock(snapshot_mutex_);
+    snapshot_released_.wait(lock, [&] {
+        return (!server_.active || server_.active.use_count() == 1) &&
+               (!server_.standby || server_.standby.use_count() == 1);
+    });
+    server_.standby = std::move(standby);
+    server_.standby_stale.clear();
+    server_.active = std::move(db);
 }
 
 /**
- * 将分区索引j映射到z维超立方体坐标
- * 将j视为基数L的数字，分解为z个坐标
+ * 持久化服务器状态
  */
-std::vector<size_t> MFUPSIProtocol::compute_hypercube_coordinates(size_t j) {
-    size_t z = config_.pir_dimension;
-    size_t L = compute_pir_dimension_size();
-    
-    std::vector<size_t> coordinates(z);
-    
-    // 从高位到低位逐个提取坐标
-    // j = idx_1 * L^(z-1) + idx_2 * L^(z-2) + ... + idx_z * L^0
-    for (size_t i = 0; i < z; i++) {
-        size_t exponent = z - 1 - i;
-        size_t divisor = static_cast<size_t>(std::pow(static_cast<double>(L), static_cast<double>(exponent)));
-        coordinates[i] = (j / divisor) % L;
+void MFUPSIProtocol::save_server_state(const std::string& path) const {
+    MatrixFile::save(path, server_.global_encoding, config_.modulus);
+}
+
+/**
+ * 由映射文件热重启：预处理顺序读取整个矩阵，之后改为按列随机访问
+ */
+void MFUPSIProtocol::restore_server_state(const std::string& path) {
+    MatrixType E = MatrixFile::map(path, config_.modulus, MatrixFile::Access::Sequential);
+    if (E.rows() != config_.partition_size || E.cols() != server_.shard.cols()) {
+        throw std::runtime_error("matrix file dimensions do not match the configuration: " + path);
     }
-    
-    return coordinates;
+    server_.global_encoding = std::move(E);
+    rebuild_query_snapshots();
+    MatrixFile::advise(server_.global_encoding, MatrixFile::Access::Random);
 }
 
 /**
- * 初始化LWE密钥：生成随机秘密向量
+ * 发布新版本的查询数据库
+ *
+ * standby 是上上个版本（或Setup时的副本），先补上 active 相对它多出的改动，
+ * 再写入本次改动，使其与 global_encoding 一致后与 active 交换。
+ * 旧的 active 可能仍被正在执行的查询持有，它成为新的 standby，
+ * 下一次发布前须等这些查询结束（use_count 回到1）才能修改。
  */
-void MFUPSIProtocol::initialize_lwe_key() {
-    size_t N_lwe = config_.lwe_dimension;
-    pir_lwe_key_.secret_key.resize(N_lwe);
+void MFUPSIProtocol::publish_query_database(const std::vector<size_t>& touched) {
+    auto& standby = server_.standby;
+    {
+        // 读者在锁内释放引用，等待返回时它们对旧快照的读取都已发生在下面的修改之前
+        std::unique_lock<std::mutex> lock(snapshot_mutex_);
+        snapshot_released_.wait(lock, [&] { return standby.use_count() == 1; });
+    }
     
-    std::mt19937_64 rng(std::random_device{}());
-    std::uniform_int_distribution<uint64_t> dist(0, config_.modulus - 1);
+    std::vector<size_t> columns = server_.standby_stale;
+    columns.insert(columns.end(), touched.begin(), touched.end());
+    std::sort(columns.begin(), columns.end());
+    columns.erase(std::unique(columns.begin(), columns.end()), columns.end());
+    for (size_t j : columns) {
+        if (rlwe_ctx_) {
+            standby->rlwe_db.update_col(j, server_.global_encoding);
+        } else {
+            standby->pir_db.update_col(j, server_.global_encoding);
+        }
+    }
     
-    for (size_t i = 0; i < N_lwe; i++) {
-        pir_lwe_key_.secret_key[i] = dist(rng);
+    std::lock_guard<std::mutex> lock(snapshot_mutex_);
+    standby->version = server_.active->version + 1;
+    std::swap(server_.active, standby);
+    server_.standby_stale = touched;
+}
+
+/**
+ * 获取当前查询快照：在锁内复制 active 的引用，返回的句柄销毁时同样在锁内释放并通知写者
+ */
+std::shared_ptr<const MFUPSIProtocol::QueryDatabase> MFUPSIProtocol::query_snapshot() const {
+    std::lock_guard<std::mutex> lock(snapshot_mutex_);
+    std::shared_ptr<QueryDatabase> pinned = server_.active;
+    const QueryDatabase* db = pinned.get();
+    return std::shared_ptr<const QueryDatabase>(db, [this, pinned](const QueryDatabase*) mutable {
+        std::lock_guard<std::mutex> lock(snapshot_mutex_);
+        pinned.reset();
+        snapshot_released_.notify_all();
+    });
+}
+
+// ===== PIR相关新增函数 =====
+
+/**
+ * 生成PIR查询使用的RLWE私钥（明文后端无需密钥）
+ */
+void MFUPSIProtocol::initialize_pir_key() {
+    if (rlwe_ctx_) {
+        rlwe_sk_ = Rlwe::keygen(*rlwe_ctx_, rlwe_sampler_);
+        
+        // 每个响应密文的第 l·d_1 个系数为第l个limb上的窗口内积
+        std::vector<size_t> coeffs;
+        for (size_t l = 0; l < rlwe_packing_.limbs_per_poly; l++) {
+            coeffs.push_back(l * config_.partition_size);
+        }
+        rlwe_decryptor_ = std::make_unique<Rlwe::CoefficientDecryptor>(*rlwe_ctx_, rlwe_sk_, coeffs);
     }
 }
 
 /**
- * 生成高效PIR密文（Ring-LWE编码）
- * 代替底层朴素LWE矩阵，模拟OnionPIR的高效密文编码
- * 在OnionPIR中，单个维度的查询密文大小约为 64 KB（包含多项式环元素的打包编码）
+ * 生成明文后端的查询描述符
+ * 第一维为RandVector的窗口，后续维度的 one-hot 选择向量只记录坐标
  */
-MFUPSIProtocol::GSWCiphertext MFUPSIProtocol::generate_gsw_ciphertext_for_coordinate(
-    size_t coordinate, size_t L
-) {
-    GSWCiphertext ct;
-    ct.dimension = config_.lwe_dimension;
-    
-    // 简化模型：Ring-LWE密文而不是(2*N_lwe)^2矩阵
-    // 实际通信大小在query_phase中以64KB统计
-    ct.matrix = MatrixType(1, VectorType(1, 1));
+MFUPSIProtocol::PlainQuery MFUPSIProtocol::generate_plain_query(uint64_t element) {
+    size_t j = Utils::hash_partition(key_k1_, element) % config_.num_partitions;
     
-    return ct;
+    PlainQuery query;
+    query.window.resize(config_.band_width);
+    query.offset = generate_rand_window(element, query.window.data());
+    query.inner_index = hypercube_.inner_index(j);
+    return query;
 }
 
 /**
- * 生成z个选择向量，每个对应超立方体的一个维度
+ * 批量PIR服务器处理：维度折叠
  * 
- * 算法步骤：
- * 1. 计算元素所在的分区j
- * 2. 将j映射到z维坐标 (idx_1, ..., idx_z)
- * 3. 对于第d维，生成一个选择向量，在idx_d位置设置非零值
+ * 算法流程：
+ * 1. 第一维：选择向量v1只在w宽窗口内非零，在分块数据库上只扫描窗口内的行，
+ *    r[c] = <v1, E_total[:, c]>，得到长度b的向量（每个分区一个值）。
+ *    整批一次数据库扫描，相当于 (Q × d_1 稀疏选择矩阵) × E_total 的矩阵乘法，
+ *    每个分块在L2中被批内所有查询复用，各分块在查询线程池上并行扫描
+ * 2. 将r视为z维超立方体（超出b的部分为0）；第2..z维的选择为 one-hot，
+ *    逐维折叠等价于直接取出 r[t·L^(z-1) + m]，t ∈ [0, L)，逐查询进行
+ * 3. 剩余长度L的向量按第一个坐标idx_1索引
  */
-std::vector<MFUPSIProtocol::VectorType> MFUPSIProtocol::generate_z_selection_vectors(
-    size_t element
+std::vector<MFUPSIProtocol::VectorType> MFUPSIProtocol::server_process_pir_query_batch(
+    const std::vector<PlainQuery>& queries
 ) {
-    // 第一维使用稀疏向量（与原来的RandVector一致）
-    VectorType v1 = generate_rand_vector(element);
+    size_t L = hypercube_.side();
+    size_t H = hypercube_.inner_size();
+    size_t d1 = config_.partition_size;
+    MFUPSI_SCOPE(PirFold);
+    MFUPSI_INSTRUMENT_ONLY(
+        const size_t b = server_.shard.cols();
+        size_t scanned = 0;
+        for (const auto& query : queries) scanned += std::min(query.window.size(), d1);
+    )
+    // 字节：整批一次数据库扫描加每个查询的b维中间结果（分片内的列）；模乘为各查询窗口内的乘加
+    MFUPSI_COUNT(PirFold, queries.size(), (d1 + queries.size()) * b * sizeof(uint64_t), scanned * b);
+    
+    // 整个批次使用同一个快照，期间发布的Update不影响本批
+    auto snapshot = query_snapshot();
+    
+    return ModArith::dispatch(config_.modulus, [&](const auto& mod) {
+        std::vector<VectorType> scans(queries.size(), VectorType(server_.shard.cols()));
+        std::vector<PirDatabase::Selection> batch;
+        batch.reserve(queries.size());
+        
+        // ===== 第一维：窗口选择扫描（整批一次）=====
+        for (size_t k = 0; k < queries.size(); k++) {
+            const auto& query = queries[k];
+            size_t width = std::min(query.window.size(), d1 - std::min(query.offset, d1));
+            batch.push_back({query.offset, query.window.data(), width, scans[k].data()});
+        }
+        snapshot->pir_db.select_rows_batch(batch, mod, *query_pool_);
+        
+        // ===== 后续维度：one-hot 选择（分片只填写自己持有的第一维坐标，其余为0）=====
+        const auto& shard = server_.shard;
+        std::vector<VectorType> results(queries.size(), VectorType(L, 0));
+        for (size_t k = 0; k < queries.size(); k++) {
+            for (size_t t = shard.first_row; t < shard.last_row; t++) {
+                size_t c = t * H + queries[k].inner_index;
+                if (c < shard.last_col) {
+                    results[k][t] = scans[k][c - shard.first_col];
+                }
+            }
+        }
+        
+        return results;
+    });
+}
+
+
+/**
+ * 生成RLWE查询
+ *
+ * 第一维：选择多项式 V(X) = v_1[0] - Σ_{i≥1} v_1[i] X^(N-i)，
+ * 对任意明文列 P(X)，V·P 在 X^(l·d_1) 处的系数为 Σ_i v_1[i] · P[l·d_1 + i]，
+ * 即一次负循环乘法同时完成每个limb上的窗口内积。
+ * 客户端发送L个密文，第idx_1个加密V，其余加密0，服务器据此选出 idx_1 行。
+ *
+ * 第2..z维：坐标 idx_d 的每个比特加密为RGSW密文，服务器用CMux树选择。
+ */
+MFUPSIProtocol::RlweQuery MFUPSIProtocol::generate_rlwe_query(uint64_t element) {
+    const Rlwe::Context& ctx = *rlwe_ctx_;
+    const size_t n = ctx.n();
+    size_t z = hypercube_.dimensions();
+    size_t L = hypercube_.side();
     
-    // 计算分区索引
     size_t j = Utils::hash_partition(key_k1_, element) % config_.num_partitions;
     
-    // 映射到z维坐标
-    std::vector<size_t> coords = compute_hypercube_coordinates(j);
-    
-    size_t z = config_.pir_dimension;
-    size_t L = compute_pir_dimension_size();
+    // V(X) 只在窗口 [offset, offset + w) 对应的位置上非零
+    size_t w = config_.band_width;
+    VectorType window(w);
+    size_t offset = generate_rand_window(element, window.data());
+    std::vector<int64_t> selection(n, 0);
+    for (size_t k = 0; k < w; k++) {
+        size_t i = offset + k;
+        if (i == 0) {
+            selection[0] = static_cast<int64_t>(window[k]);
+        } else {
+            selection[n - i] = -static_cast<int64_t>(window[k]);
+        }
+    }
     
-    std::vector<VectorType> z_selection_vectors;
-    z_selection_vectors.push_back(v1);  // 第一维选择向量
+    RlweQuery query;
+    query.first_dim.reserve(L);
+    size_t first_coord = hypercube_.coordinate(j, 0);
+    for (size_t t = 0; t < L; t++) {
+        const int64_t* message = (t == first_coord) ? selection.data() : nullptr;
+        query.first_dim.push_back(Rlwe::encrypt(ctx, rlwe_sk_, message, rlwe_sampler_));
+    }
     
-    // 生成后续z-1维的选择向量
+    size_t bits = coordinate_bits();
+    query.fold_bits.resize(z - 1);
     for (size_t dim = 1; dim < z; dim++) {
-        VectorType v_dim(L, 0);
-        // 在第coord[dim]位置设置选择标记
-        if (coords[dim] < L) {
-            v_dim[coords[dim]] = 1;  // 简化版：直接设置为1
+        for (size_t bit = 0; bit < bits; bit++) {
+            uint64_t value = (hypercube_.coordinate(j, dim) >> bit) & 1;
+            query.fold_bits[dim - 1].push_back(Rlwe::encrypt_rgsw(ctx, rlwe_sk_, value, rlwe_sampler_));
         }
-        z_selection_vectors.push_back(v_dim);
     }
-    
-    return z_selection_vectors;
+    return query;
 }
 
 /**
- * 高效PIR服务器处理：维度折叠（Ring-LWE版）
- * 
- * 改进模型：使用NTT优化的多项式同态运算而不是朴素矩阵乘法
- * 
- * 算法流程（高效版）：
- * 1. 初始化当前编码矩阵为E_total（d_1 × b）
- * 2. 对于第1维：使用NTT加速的多项式乘法：O(N log N)
- * 3. 对于第2维到第z维：通过Ring-LWE优化的同态运算实现
- * 
- * 总的计算复杂度：约 z × N log N 次运算（N为多项式度数d_1）
- * 相比朴素LWE的 z × N³，这是指数级的改进
+ * 批量RLWE PIR服务器处理
+ *
+ * 分区j = idx_1 · H + m，H = L^(z-1)。按m递增遍历：
+ *   1. 读取预处理好的 L×G 个明文列 P_(t·H + m, g)（连续存放，整批共用）
+ *   2. 每个查询计算 Σ_t ct_t ⊙ P_(t·H + m, g) = Enc(V · P_(idx_1·H + m, g))
+ *   3. 结果按m的顺序流入该查询的CMux折叠器，最终只剩 m = (idx_2, ..., idx_z) 对应的密文
  */
-MFUPSIProtocol::VectorType MFUPSIProtocol::server_process_pir_query_z_dimension(
-    const std::vector<VectorType>& z_selection_vectors
+std::vector<MFUPSIProtocol::RlweResponse> MFUPSIProtocol::server_process_rlwe_query_batch(
+    const std::vector<RlweQuery>& queries
 ) {
-    if (z_selection_vectors.empty()) {
-        return VectorType(config_.partition_size, 0);
-    }
-    
-    size_t z = config_.pir_dimension;
-    size_t L = compute_pir_dimension_size();
+    const Rlwe::Context& ctx = *rlwe_ctx_;
+    size_t L = hypercube_.side();
+    size_t H = hypercube_.inner_size();
     size_t b = config_.num_partitions;
-    size_t d1 = config_.partition_size;
-    size_t N_lwe = config_.lwe_dimension;
-    
-    // 初始数据结构：服务器保有d_1 × b的编码矩阵 E_total
-    // 维度折叠的目的是通过GSW同态运算逐维压缩
-    
-    // ===== 第一维处理（维度1）=====
-    // 输入：选择向量v1（长度b），编码矩阵E_total（d_1 × b）
-    // 操作：向量-矩阵乘法：result1 = v1^T · E_total -> (1 × d_1)
-    // 计算复杂度：O(b * d_1)
-    
-    const auto& v1 = z_selection_vectors[0];
+    size_t G = rlwe_packing_.num_groups;
+    MFUPSI_SCOPE(PirFold);
+    
+    // 整个批次使用同一个快照，期间发布的Update不影响本批
+    auto snapshot = query_snapshot();
+    const RlweDatabase& db = snapshot->rlwe_db;
+    
+    // 分片只持有第一维坐标 [first_row, last_row)，查询的 first_dim 也只含这些坐标的密文
+    const auto& shard = server_.shard;
+    auto rows_of = [&](size_t m) {  // 第m个输出涉及的有效行数（超出b的列为零）
+        size_t rows = 0;
+        while (rows < shard.rows() && (shard.first_row + rows) * H + m < b) {
+            rows++;
+        }
+        return rows;
+    };
+    
+    // 每个 (查询, limb组) 是一条独立的折叠链。整批只提交一次任务：链数足以占满线程池时
+    // 每条链一个任务，顺序处理全部 m；否则再按最高位折叠坐标把 m 切成L块，
+    // 各块用低位折叠成一个密文，最后用最高位折叠这L个子结果
+    const size_t D = queries.empty() ? 0 : queries[0].fold_bits.size();
+    const size_t chains = queries.size() * G;
+    const bool split = D > 0 && chains < 4 * query_pool_->size();
+    const size_t blocks = split ? L : 1;
+    const size_t block_size = H / blocks;
+    std::vector<Rlwe::Ciphertext> partial(blocks * chains);
+    
+    // 任务按块优先编号：同时执行的任务处理相同的 m，共享明文多项式的缓存
+    query_pool_->parallel_for(blocks * chains, [&](size_t task) {
+        const size_t block = task / chains;
+        const size_t k = (task % chains) / G;
+        const size_t g = task % G;
+        Rlwe::Accumulator acc(ctx);
+        Rlwe::Folder folder(ctx, queries[k].fold_bits, L, split ? 1 : 0);
+        for (size_t m = block * block_size; m < (block + 1) * block_size; m++) {
+            const size_t rows = rows_of(m);
+            acc.reset();
+            for (size_t t = 0; t < rows; t++) {
+                acc.mac(queries[k].first_dim[t], db.plaintext(t, m, g));
+            }
+            folder.push(acc.reduce(ctx));
+        }
+        partial[task] = folder.result();
+    });
     
-    // 如果第一个选择向量长度不匹配，进行零填充
-    VectorType v1_padded = v1;
-    if (v1_padded.size() < b) {
-        v1_padded.resize(b, 0);
-    } else if (v1_padded.size() > b) {
-        v1_padded.resize(b);
+    std::vector<RlweResponse> responses(queries.size());
+    for (auto& response : responses) {
+        response.groups.resize(G);
     }
-    
-    // 执行第一维的同态乘法
-    VectorType result = Matrix::vector_matrix_multiply(
-        v1_padded,
-        server_.global_encoding,
-        config_.modulus
-    );
-    
-    // ===== 后续维度处理（维度2到z）=====
-    // 每一维都需要执行GSW外部积来"提取"特定维度的信息
-    // 
-    // 算法流程：
-    // 对于第d维（d = 2, ..., z）：
-    //   1. 上一维得到的结果进行接收（大小从b逐维缩小）
-    //   2. 生成当前维度的GSW密文矩阵
-    //   3. 执行GSW外部积：GSW_Matrix × LWE_Vector
-    //   4. 得到当前维度的乘积结果
-    // 
-    // 为了模拟计算开销，我们需要真实执行这些矩阵乘法
-    
-    for (size_t dim = 1; dim < z; dim++) {
-        // 当前维度应该处理的数据规模
-        // 在第dim维，我们已对前dim-1维进行了折叠
-        // 数据量从b，缩减到b/L, b/L^2, ..., b/L^(dim-1)
-        
-        size_t current_data_scale = b;
-        for (size_t j = 0; j < dim - 1; j++) {
-            current_data_scale = (current_data_scale + L - 1) / L;
+    query_pool_->parallel_for(split ? chains : 0, [&](size_t chain) {
+        Rlwe::Folder folder(ctx, queries[chain / G].fold_bits, L, 0, 1);
+        for (size_t block = 0; block < blocks; block++) {
+            folder.push(std::move(partial[block * chains + chain]));
         }
-        
-        if (dim < z_selection_vectors.size()) {
-            const auto& v_dim = z_selection_vectors[dim];
-            
-            // ===== 模拟GSW同态扩展 =====
-            // 原理：客户端发来的是z个GSW密文，代表z个维度的选择信息
-            // 服务器需要通过GSW外部积将其"展开"为完整的选择向量
-            // 
-            // 为了简化但保持计算量的准确性，我们执行以下步骤：
-            // 1. 构建一个临时矩阵代表当前维度的同态处理中间结果
-            //    大小：current_data_scale × d_1
-            // 2. 用第dim个选择向量与其做乘法
-            
-            // 创建临时的同态中间结果矩阵
-            MatrixType temp_homoencrypted(
-                current_data_scale,
-                VectorType(d1, 0)
-            );
-            
-            // 填充为随机数据（或从previous iteration的结果）
-            // 这里我们用E_total的前current_data_scale行
-            for (size_t i = 0; i < current_data_scale && i < server_.global_encoding.size(); i++) {
-                temp_homoencrypted[i] = server_.global_encoding[i];
-            }
-            
-            // ===== 执行第dim维的乘法 =====
-            // 确保选择向量大小与矩阵行数匹配
-            VectorType v_dim_padded = v_dim;
-            if (v_dim_padded.size() < current_data_scale) {
-                v_dim_padded.resize(current_data_scale, 0);
-            } else if (v_dim_padded.size() > current_data_scale) {
-                v_dim_padded.resize(current_data_scale);
-            }
-            
-            // 执行同态乘法（这会产生实际的计算开销）
-            result = Matrix::vector_matrix_multiply(
-                v_dim_padded,
-                temp_homoencrypted,
-                config_.modulus
-            );
-            
-            // ===== 重要：模拟GSW外部积的额外计算 =====
-            // 在真实的PIR中，GSW外部积操作是极其昂贵的
-            // GSW矩阵大小：(2*N_lwe) × (2*N_lwe)
-            // LWE向量大小：2*N_lwe
-            // 单个外部积：O(N_lwe^3) 或更高的操作
-            // 
-            // 我们通过执行额外的矩阵乘法来模拟这个开销
-            // 执行约current_data_scale次小规模矩阵乘法
-            
-            // GSW同态计算已通过Ring-LWE配置参数化
-            // 避免执行O(N³)的矩阵乘法，改为NTT参数化模型
-            // 实际计算通过同态加密库(如OpenFHE)的优化实现
+        responses[chain / G].groups[chain % G] = folder.result();
+    });
+    if (!split) {
+        for (size_t chain = 0; chain < chains; chain++) {
+            responses[chain / G].groups[chain % G] = std::move(partial[chain]);
         }
     }
     
-    return result;
+    // 第一维：每条链对每个m的 rows 个密文做逐点乘加（a、b 两个分量）；CMux 由 external_product 计数
+    MFUPSI_INSTRUMENT_ONLY(
+        size_t total_rows = 0;
+        for (size_t m = 0; m < H; m++) total_rows += rows_of(m);
+    )
+    MFUPSI_COUNT(PirFold, queries.size(), total_rows * G * ctx.poly_words() * sizeof(uint64_t),
+                 chains * total_rows * 2 * ctx.poly_words());
+    return responses;
+}
+
+/**
+ * 解密RLWE响应：第g组密文在 X^(l·d_1) 处的系数为第 g·lpp + l 个limb上的内积 S_l，
+ * S_l ≤ w · (2^16 - 1) < t，可精确还原；r = Σ_l S_l · 2^(16·l) mod q
+ */
+uint64_t MFUPSIProtocol::decrypt_rlwe_response(const RlweResponse& response) const {
+    const size_t lpp = rlwe_packing_.limbs_per_poly;
+    uint64_t sums[64 / RlweDatabase::kLimbBits];
+    ModArith::u128 value = 0;
+    for (size_t g = 0; g < response.groups.size(); g++) {
+        rlwe_decryptor_->decrypt(response.groups[g], sums);
+        for (size_t l = 0; l < lpp; l++) {
+            size_t limb = g * lpp + l;
+            if (limb >= rlwe_packing_.num_limbs) break;
+            value += static_cast<ModArith::u128>(sums[l]) << (limb * RlweDatabase::kLimbBits);
+        }
+    }
+    return static_cast<uint64_t>(value % config_.modulus);
 }
 
+size_t MFUPSIProtocol::coordinate_bits() const {
+    size_t bits = 0;
+    while ((size_t(1) << bits) < hypercube_.side()) bits++;
+    return bits;
+}
+
+size_t MFUPSIProtocol::rlwe_query_bytes(const RlweQuery& query) const {
+    size_t bytes = query.first_dim.size() * Rlwe::ciphertext_bytes(*rlwe_ctx_);
+    for (const auto& dim_bits : query.fold_bits) {
+        bytes += dim_bits.size() * Rlwe::rgsw_bytes(*rlwe_ctx_);
+    }
+    return bytes;
+}
+
+size_t MFUPSIProtocol::rlwe_response_bytes(const RlweResponse& response) const {
+    return response.groups.size() * Rlwe::ciphertext_bytes(*rlwe_ctx_);
+}
 
 /**
- * 客户端解密和交集判断
+ * 批量解密和交集判断（RLWE后端）：每个响应只做 G·lpp 个系数的内积解密
  */
-bool MFUPSIProtocol::decrypt_and_judge(
-    const VectorType& pir_response,
-    uint64_t element
-) {
-    if (pir_response.empty()) return false;
-    
-    uint64_t expected = Utils::prf_value(key_kr_, element) % config_.modulus;
-    expected = Utils::mul_mod(expected, config_.num_clients, config_.modulus);
-    
-    uint64_t diff = (pir_response[0] > expected) ? 
-        (pir_response[0] - expected) : 
-        (expected - pir_response[0]);
-    
-    return diff < config_.modulus / 1000;
+MFUPSIProtocol::MembershipBitmap MFUPSIProtocol::decrypt_and_judge_batch(
+    const std::vector<RlweResponse>& responses,
+    const uint64_t* elements
+) const {
+    const size_t n = responses.size();
+    std::vector<uint64_t> values(n);
+    for (size_t k = 0; k < n; k++) {
+        values[k] = decrypt_rlwe_response(responses[k]);
+    }
+    return judge_response_values(values.data(), elements, n);
+}
+
+/**
+ * 批量解密和交集判断（明文后端）：响应按元素所在分区的第一个超立方体坐标索引，
+ * 分区号整批哈希后逐个取出还原值
+ */
+MFUPSIProtocol::MembershipBitmap MFUPSIProtocol::decrypt_and_judge_batch(
+    const std::vector<VectorType>& responses,
+    const uint64_t* elements
+) const {
+    const size_t n = responses.size();
+    std::vector<uint64_t> values(n);
+    Utils::hash_partition_batch(key_k1_, elements, n, values.data());
+    for (size_t k = 0; k < n; k++) {
+        size_t idx = hypercube_.coordinate(values[k] % config_.num_partitions, 0);
+        // 越界的坐标取 ~0，它不小于q，不会与任何期望值相等
+        values[k] = (idx < responses[k].size()) ? responses[k][idx] : ~0ULL;
+    }
+    return judge_response_values(values.data(), elements, n);
+}
+
+/**
+ * 交集判断：两种后端都精确还原 n · F_r(K_r, x) mod q，因此逐个精确比较。
+ * PRF整批哈希，位图在一次无分支的遍历中生成
+ */
+MFUPSIProtocol::MembershipBitmap MFUPSIProtocol::judge_response_values(
+    const uint64_t* values,
+    const uint64_t* elements,
+    size_t n
+) const {
+    std::vector<uint64_t> expected(n);
+    Utils::prf_value_batch(key_kr_, elements, n, expected.data());
+    
+    MembershipBitmap bitmap((n + 63) / 64, 0);
+    ModArith::dispatch(config_.modulus, [&](const auto& mod) {
+        const uint64_t q = mod.modulus();
+        const uint64_t num_clients = config_.num_clients % q;
+        for (size_t k = 0; k < n; k++) {
+            uint64_t target = mod.mul(expected[k] % q, num_clients);
+            bitmap[k / 64] |= static_cast<uint64_t>(values[k] == target) << (k % 64);
+        }
+    });
+    return bitmap;
 }
 
 /**
  * Query阶段：改进版，使用z维PIR
  */
 void MFUPSIProtocol::query_phase() {
+    std::atomic<bool> queries_done{false};
+    std::exception_ptr writer_error;
+    std::thread writer;
+    if (config_.concurrent_updates) {
+        writer = std::thread([&] {
+            try {
+                concurrent_updates(queries_done);
+            } catch (...) {
+                writer_error = std::current_exception();
+            }
+        });
+    }
+    auto stop_writer = [&] {
+        queries_done.store(true);
+        if (writer.joinable()) writer.join();
+    };
+    
+    try {
+        run_queries(
+            [this](const std::vector<PlainQuery>& queries, double& server_ms) {
+                Utils::Timer timer;
+                timer.start();
+                auto responses = server_process_pir_query_batch(queries);
+                timer.stop();
+                server_ms = timer.elapsed_ms();
+                return responses;
+            },
+            [this](const std::vector<RlweQuery>& queries, double& server_ms) {
+                Utils::Timer timer;
+                timer.start();
+                auto responses = server_process_rlwe_query_batch(queries);
+                timer.stop();
+                server_ms = timer.elapsed_ms();
+                return responses;
+            });
+    } catch (...) {
+        stop_writer();
+        throw;
+    }
+    stop_writer();
+    if (writer_error) {
+        std::rethrow_exception(writer_error);
+    }
+    if (config_.concurrent_updates) {
+        std::cout << "  查询期间并发发布的Update: " << metrics_.concurrent_update_rounds << " 轮（服务器耗时 "
+                  << metrics_.concurrent_update_server_ms << " ms）" << std::endl;
+    }
+}
+
+/**
+ * 查询期间的写线程：客户端0是查询客户端，其数据集在查询期间保持不变，只更新其余客户端。
+ * 每轮与 update_phase 相同（client_update + server_incremental_update），至少执行一轮；
+ * Update阶段的指标与分区编码失败计数在结束时恢复，本阶段的轮数与服务器耗时单独记录
+ */
+void MFUPSIProtocol::concurrent_updates(const std::atomic<bool>& queries_done) {
+    const double update_server_ms = metrics_.update_server_time_ms;
+    const size_t update_samples = metrics_.update_client_samples_ms.size();
+    const size_t encoded_partitions = metrics_.encoded_partitions;
+    const size_t inconsistent_partitions = metrics_.inconsistent_partitions;
+    Prg::Stream rng(Prg::random_key(), 0);
+    do {
+        std::vector<SparseUpdate> updates;
+        for (size_t i = 1; i < clients_.size(); i++) {
+            updates.push_back(client_update(clients_[i], rng));
+        }
+        server_incremental_update(updates);
+        metrics_.concurrent_update_rounds++;
+        metrics_.concurrent_update_server_ms += metrics_.update_server_time_ms;
+    } while (!queries_done.load());
+    metrics_.update_server_time_ms = update_server_ms;
+    metrics_.update_client_samples_ms.resize(update_samples);
+    metrics_.encoded_partitions = encoded_partitions;
+    metrics_.inconsistent_partitions = inconsistent_partitions;
+}
+
+/**
+ * 查询客户端（客户端0）的查询流程：逐批生成、交给 plain_server / rlwe_server 处理、解密
+ * 服务器耗时取回调报告的处理时间，往返耗时中其余部分计入 query_network_time_ms
+ */
+void MFUPSIProtocol::run_queries(const PlainServer& plain_server, const RlweServer& rlwe_server) {
     std::cout << "开始Query阶段..." << std::endl;
     
     auto& query_client = clients_[0];
@@ -697,8 +1082,8 @@ void MFUPSIProtocol::query_phase() {
     
     double total_gen_time = 0, total_server_time = 0, total_decrypt_time = 0;
     
-    size_t z = config_.pir_dimension;
-    size_t L = compute_pir_dimension_size();
+    size_t z = hypercube_.dimensions();
+    size_t L = hypercube_.side();
     size_t N_lwe = config_.lwe_dimension;
     
     std::cout << "  PIR参数:" << std::endl;
@@ -706,77 +1091,784 @@ void MFUPSIProtocol::query_phase() {
     std::cout << "    z维度: " << z << std::endl;
     std::cout << "    L（每维大小）: " << L << std::endl;
     std::cout << "    LWE维度: " << N_lwe << std::endl;
+    if (rlwe_ctx_) {
+        std::cout << "    后端: RLWE（" << rlwe_ctx_->num_primes() << "个RNS素数，gadget长度"
+                  << rlwe_ctx_->gadget_len() << "，每元素" << rlwe_packing_.num_limbs << "个16位limb，"
+                  << rlwe_packing_.num_groups << "个响应密文）" << std::endl;
+    } else {
+        std::cout << "    后端: 明文选择向量（无查询隐私，仅作计算基线）" << std::endl;
+    }
     
-    for (const auto& element : query_elements) {
-        // ===== 客户端查询生成 =====
-        Utils::Timer timer;
-        timer.start();
-        
-        // 生成z个选择向量（关键改进）
-        auto z_selection_vectors = generate_z_selection_vectors(element);
+    size_t batch_size = std::max<size_t>(1, config_.query_batch_size);
+    
+    for (size_t first = 0; first < query_elements.size(); first += batch_size) {
+        size_t last = std::min(first + batch_size, query_elements.size());
+        std::vector<PlainQuery> plain_queries;
+        std::vector<RlweQuery> rlwe_queries;
         
-        // 模拟GSW密文生成（计算复杂性）
-        // 对每个维度生成一个GSW矩阵
-        for (size_t dim = 0; dim < z; dim++) {
-            if (dim < z_selection_vectors.size()) {
-                size_t coord_idx = (dim < z_selection_vectors.size() - 1) ? 
-                    z_selection_vectors[dim + 1][0] : 0;
-                auto gsw_ct = generate_gsw_ciphertext_for_coordinate(coord_idx, L);
-                
-                // 模拟GSW矩阵生成的计算开销
-                // GSW矩阵大小：(2*N_lwe) × (2*N_lwe)
+        // ===== 客户端查询生成 =====
+        for (size_t k = first; k < last; k++) {
+            Utils::Timer timer;
+            timer.start();
+            
+            if (rlwe_ctx_) {
+                rlwe_queries.push_back(generate_rlwe_query(query_elements[k]));
+            } else {
+                plain_queries.push_back(generate_plain_query(query_elements[k]));
+            }
+            
+            timer.stop();
+            total_gen_time += timer.elapsed_ms();
+            metrics_.query_gen_samples_ms.push_back(timer.elapsed_ms());
+            
+            // 查询通信：按实际发送的密文（或明文选择向量）计算；联网部署中由传输层实测
+            if (metrics_.comm_measured) continue;
+            if (rlwe_ctx_) {
+                metrics_.query_comm_bytes += rlwe_query_bytes(rlwe_queries.back());
+            } else {
+                const auto& query = plain_queries.back();
+                metrics_.query_comm_bytes += 2 * sizeof(uint64_t) + query.window.size() * sizeof(uint64_t);
             }
         }
         
-        timer.stop();
-        total_gen_time += timer.elapsed_ms();
-        
-        // 计算查询通信大小：z个GSW矩阵
-        // 每个GSW矩阵大小：(2*N_lwe)^2 * 8 bytes
-        // ======= 修正通信模型：使用OnionPIR的高效大小 =======
-        // 不使用完整的(2*N_lwe)^2矩阵大小，改用Ring-LWE优化后的大小
-        const size_t EFFICIENT_PIR_QUERY_SIZE_KB = 64;  // 64KB per dimension
-        size_t query_size_per_dim = EFFICIENT_PIR_QUERY_SIZE_KB * 1024;
-        metrics_.query_comm_bytes += z * query_size_per_dim;
+        // ===== 服务器处理（整批共享一次数据库扫描）=====
+        Utils::Timer round_trip;
+        round_trip.start();
         
-        // ===== 服务器处理 =====
-        timer.start();
+        double server_ms = 0.0;
+        std::vector<RlweResponse> rlwe_responses;
+        std::vector<VectorType> plain_responses;
+        if (rlwe_ctx_) {
+            rlwe_responses = rlwe_server(rlwe_queries, server_ms);
+        } else {
+            plain_responses = plain_server(plain_queries, server_ms);
+        }
         
-        auto pir_response = server_process_pir_query_z_dimension(z_selection_vectors);
+        round_trip.stop();
+        total_server_time += server_ms;
+        metrics_.query_network_time_ms += std::max(0.0, round_trip.elapsed_ms() - server_ms);
+        metrics_.query_server_samples_ms.push_back(server_ms / (last - first));
         
-        timer.stop();
-        total_server_time += timer.elapsed_ms();
+        for (size_t k = first; k < last && !metrics_.comm_measured; k++) {
+            if (rlwe_ctx_) {
+                metrics_.response_comm_bytes += rlwe_response_bytes(rlwe_responses[k - first]);
+            } else {
+                metrics_.response_comm_bytes += plain_responses[k - first].size() * sizeof(uint64_t);
+            }
+        }
         
-        // 计算响应通信大小：d_1 × N_lwe 的LWE密文矩阵
-        size_t response_size = config_.partition_size * N_lwe * 8;
-        metrics_.response_comm_bytes += response_size;
+        // ===== 客户端解密（整批一次，输出成员位图）=====
+        Utils::Timer decrypt_timer;
+        decrypt_timer.start();
         
-        // ===== 客户端解密 =====
-        timer.start();
+        MembershipBitmap membership = rlwe_ctx_
+            ? decrypt_and_judge_batch(rlwe_responses, query_elements.data() + first)
+            : decrypt_and_judge_batch(plain_responses, query_elements.data() + first);
         
-        bool is_in_intersection = decrypt_and_judge(pir_response, element);
+        decrypt_timer.stop();
+        total_decrypt_time += decrypt_timer.elapsed_ms();
+        metrics_.query_decrypt_samples_ms.push_back(decrypt_timer.elapsed_ms() / (last - first));
         
-        timer.stop();
-        total_decrypt_time += timer.elapsed_ms();
+        for (uint64_t word : membership) {
+            metrics_.query_intersection_hits += __builtin_popcountll(word);
+        }
     }
     
     query_timer.stop();
     
     metrics_.query_client_gen_time_ms = total_gen_time;
     metrics_.query_server_process_time_ms = total_server_time;
+    metrics_.query_server_amortized_time_ms = query_elements.empty() ? 0.0 : total_server_time / query_elements.size();
     metrics_.query_client_decrypt_time_ms = total_decrypt_time;
     
     std::cout << "Query阶段完成（共" << query_elements.size() << "次查询）" << std::endl;
     std::cout << "  平均客户端查询生成：" << (total_gen_time / query_elements.size()) << " ms" << std::endl;
-    std::cout << "  平均服务器处理：" << (total_server_time / query_elements.size()) << " ms" << std::endl;
+    std::cout << "  平均服务器处理：" << metrics_.query_server_amortized_time_ms << " ms"
+              << "（每批" << batch_size << "个查询）" << std::endl;
     std::cout << "  平均客户端解密：" << (total_decrypt_time / query_elements.size()) << " ms" << std::endl;
+    std::cout << "  交集命中：" << metrics_.query_intersection_hits << "/" << query_elements.size() << std::endl;
     std::cout << "  平均查询通信：" << (metrics_.query_comm_bytes / (double)query_elements.size() / 1024.0) << " KB" << std::endl;
     std::cout << "  平均响应通信：" << (metrics_.response_comm_bytes / (double)query_elements.size() / 1024.0) << " KB" << std::endl;
+    if (metrics_.comm_measured) {
+        std::cout << "  平均网络耗时：" << (metrics_.query_network_time_ms / query_elements.size()) << " ms"
+                  << "（往返耗时减去服务器处理）" << std::endl;
+    }
 }
 
 /**
  * 重置性能指标
  */
 void MFUPSIProtocol::reset_metrics() {
-    metrics_ = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    metrics_ = PerformanceMetrics{};
+    metrics_.num_threads = pool_->size();
+}
+
+/**
+ * Setup标定：一个客户端、一个上传分块，服务器端累加经由同一个有界队列
+ */
+MFUPSIProtocol::SetupCalibration MFUPSIProtocol::calibrate_setup(size_t max_partitions) {
+    generate_keys();
+    auto& client = clients_[0];
+    generate_client_data(client, config_.dataset_size);
+    client.mask_seed = Prg::random_key();
+    client.mask_versions.assign(config_.num_partitions, 0);
+    client.partition_index.build(
+        client.data_set.begin(), client.data_set.end(), key_k1_, config_.num_partitions
+    );
+    client.encoding_matrix = MatrixType::uninitialized(
+        config_.partition_size, config_.num_partitions, Matrix::Layout::ColMajor
+    );
+    server_.global_encoding = Matrix::zero_matrix(config_.partition_size, config_.num_partitions);
+    
+    size_t count = config_.num_partitions;
+    if (max_partitions > 0) {
+        count = std::min(count, max_partitions);
+    }
+    
+    SetupCalibration result;
+    result.partitions = count;
+    size_t inconsistent_before = metrics_.inconsistent_partitions;
+    
+    Utils::Timer timer;
+    timer.start();
+    UploadChunk chunk = client_encode_chunk(client, 0, count);
+    timer.stop();
+    result.encode_partition_ms = timer.elapsed_ms() / count;
+    result.inconsistent = metrics_.inconsistent_partitions - inconsistent_before;
+    
+    BoundedQueue<UploadRound> uploads(1);
+    UploadRound round;
+    round.push_back(std::move(chunk));
+    uploads.push(std::move(round));
+    uploads.close();
+    result.aggregate_partition_ms = server_aggregate(uploads) / count;
+    return result;
+}
+
+/**
+ * 查询标定的准备：查询耗时只取决于 E_total 的形状，与其内容无关
+ */
+double MFUPSIProtocol::prepare_query_calibration() {
+    generate_keys();
+    initialize_pir_key();
+    generate_client_data(clients_[0], std::min(config_.num_queries, config_.dataset_size));
+    server_.global_encoding = Matrix::random_matrix(
+        config_.partition_size, config_.num_partitions, config_.modulus, Matrix::Layout::ColMajor, *pool_
+    );
+    
+    Utils::Timer timer;
+    timer.start();
+    rebuild_query_snapshots();
+    timer.stop();
+    return timer.elapsed_ms();
+}
+
+/**
+ * 驻留内存估计：矩阵按 d_1 × b 个64位字计；哈希集合按 3/4 负载的2的幂容量、
+ * 分区索引按 5/4 余量计；RLWE快照为 L^z 个槽位 × 每列多项式数 × 多项式字数
+ */
+size_t MFUPSIProtocol::estimate_memory_bytes(const Config_t& cfg) {
+    const size_t word = sizeof(uint64_t);
+    const size_t matrix = Utils::matrix_size_bytes(cfg.partition_size, cfg.num_partitions);
+    
+    size_t set_slots = 16;
+    while (set_slots * 3 / 4 < cfg.dataset_size) {
+        set_slots *= 2;
+    }
+    size_t index = (cfg.dataset_size + cfg.dataset_size / 4 + 4 * cfg.num_partitions) * word
+                 + 3 * cfg.num_partitions * sizeof(size_t);
+    size_t per_client = matrix + set_slots * word + index + cfg.num_partitions * sizeof(uint32_t);
+    
+    size_t snapshot = matrix;
+    if (cfg.rlwe_pir) {
+        Hypercube cube(cfg.num_partitions, cfg.pir_dimension);
+        Rlwe::Context ctx(cfg.lwe_dimension);
+        auto packing = RlweDatabase::Packing::create(cfg.modulus, cfg.lwe_dimension, cfg.partition_size);
+        snapshot = cube.size() * packing.num_groups * ctx.poly_words() * word;
+    }
+    return cfg.num_clients * per_client + matrix + 2 * snapshot;
+}
+
+// ===== 联网部署 =====
+
+namespace {
+
+/**
+ * Hello帧中的配置指纹：决定帧负载形状与协议语义的参数，服务器与各客户端进程必须一致
+ */
+std::vector<uint64_t> config_fingerprint(const Config::ExperimentConfig& cfg) {
+    return {cfg.num_clients, cfg.dataset_size, cfg.partition_size, cfg.num_partitions, cfg.band_width,
+            cfg.modulus, cfg.pir_dimension, cfg.lwe_dimension, cfg.rlwe_pir ? 1u : 0u, cfg.num_updates,
+            cfg.num_shards, cfg.query_batch_size};
+}
+
+void add_ciphertext(Transport::Segments& segments, const Rlwe::Ciphertext& ct) {
+    segments.add(ct.a.data(), ct.a.size() * sizeof(uint64_t));
+    segments.add(ct.b.data(), ct.b.size() * sizeof(uint64_t));
+}
+
+uint64_t to_ns(double ms) {
+    return static_cast<uint64_t>(ms * 1e6);
+}
+
+double from_ns(uint64_t ns) {
+    return ns / 1e6;
+}
+
+/**
+ * 接收到的 Z_q 元素须已约化：下游的模运算内核都假定输入小于模数
+ */
+bool reduced(const uint64_t* values, size_t count, uint64_t q) {
+    return std::all_of(values, values + count, [q](uint64_t v) { return v < q; });
+}
+
+bool reduced(const Rlwe::Context& ctx, const Rlwe::Ciphertext& ct) {
+    for (size_t i = 0; i < ctx.num_primes(); i++) {
+        const uint64_t p = ctx.prime(i).p;
+        if (!reduced(ct.a.data() + i * ctx.n(), ctx.n(), p) || !reduced(ct.b.data() + i * ctx.n(), ctx.n(), p)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+void MFUPSIProtocol::add_segments(Transport::Segments& segments, const RlweQuery& query,
+                                  size_t first_row, size_t last_row) const {
+    for (size_t t = first_row; t < last_row; t++) {
+        add_ciphertext(segments, query.first_dim[t]);
+    }
+    for (const auto& dim_bits : query.fold_bits) {
+        for (const auto& rgsw : dim_bits) {
+            for (const auto& row : rgsw.rows) {
+                add_ciphertext(segments, row);
+            }
+        }
+    }
+}
+
+void MFUPSIProtocol::add_segments(Transport::Segments& segments, const RlweResponse& response) const {
+    for (const auto& ct : response.groups) {
+        add_ciphertext(segments, ct);
+    }
+}
+
+/**
+ * 分片收到的查询形状：本分片 rows 个第一维坐标的密文与 (z-1) · ceil(log2 L) 个 2ℓ 行的RGSW密文
+ */
+MFUPSIProtocol::RlweQuery MFUPSIProtocol::rlwe_query_buffers(size_t rows) const {
+    const Rlwe::Context& ctx = *rlwe_ctx_;
+    const Rlwe::Ciphertext empty{ctx.zero_poly(), ctx.zero_poly()};
+    RlweQuery query;
+    query.first_dim.assign(rows, empty);
+    Rlwe::Rgsw rgsw;
+    rgsw.rows.assign(2 * ctx.gadget_len(), empty);
+    query.fold_bits.assign(hypercube_.dimensions() - 1, std::vector<Rlwe::Rgsw>(coordinate_bits(), rgsw));
+    return query;
+}
+
+MFUPSIProtocol::RlweResponse MFUPSIProtocol::rlwe_response_buffers() const {
+    const Rlwe::Context& ctx = *rlwe_ctx_;
+    RlweResponse response;
+    response.groups.assign(rlwe_packing_.num_groups, Rlwe::Ciphertext{ctx.zero_poly(), ctx.zero_poly()});
+    return response;
+}
+
+/**
+ * 服务器进程（分片 shard，共 num_shards 个）
+ *
+ * 分片只持有 shard_map_ 分给它的列区间：客户端进程只把落在该区间内的上传列与稀疏更新发给它，
+ * 查询只携带它的第一维坐标，响应是完整响应的一个加法份额。
+ * Setup：每条连接一个接收线程，把 SetupChunk 的负载直接读入上传分块的列缓冲区，
+ * 同一连接上连续到达、列区间相同的分块（该进程托管的各客户端的同一轮）合为一轮，
+ * 经与进程内相同的有界队列交给 server_aggregate；全部进程发送 SetupDone 后预处理查询布局。
+ * Update 与 Query 阶段按连接顺序处理（稀疏更新很小，查询只来自托管客户端0的进程）。
+ * 每个阶段结束时向所有连接发送 Ack，参数为该阶段的服务器耗时。
+ */
+void MFUPSIProtocol::serve(Transport::Listener& listener, size_t shard_index) {
+    const size_t n = config_.num_clients;
+    const size_t d1 = config_.partition_size;
+    const std::vector<uint64_t> fingerprint = config_fingerprint(config_);
+    server_.shard = shard_map_.range(shard_index);
+    const ShardMap::Range& shard = server_.shard;
+    metrics_.comm_measured = true;
+    
+    std::cout << "服务器分片 " << shard_index << "/" << shard_map_.num_shards()
+              << "：分区 [" << shard.first_col << ", " << shard.last_col << ")，第一维坐标 ["
+              << shard.first_row << ", " << shard.last_row << ")" << std::endl;
+    std::cout << "服务器监听端口 " << listener.port() << "，等待 " << n << " 个客户端..." << std::endl;
+    std::vector<Transport::Connection> peers;
+    std::vector<bool> registered(n, false);
+    size_t num_registered = 0;
+    while (num_registered < n) {
+        Transport::Connection peer = listener.accept();
+        auto hello = peer.expect(Transport::FrameType::Hello);
+        std::vector<uint64_t> theirs(fingerprint.size());
+        Transport::Segments into;
+        into.add(theirs.data(), theirs.size() * sizeof(uint64_t));
+        peer.receive_payload(hello, into);
+        if (theirs != fingerprint) {
+            throw std::runtime_error("client process configuration does not match the server");
+        }
+        if (hello.arg != shard_index) {
+            throw std::runtime_error("client process connected to shard " + std::to_string(shard_index) +
+                                     " expecting shard " + std::to_string(hello.arg));
+        }
+        size_t first = hello.client_id, last = first + hello.count;
+        if (hello.count == 0 || last > n) {
+            throw std::runtime_error("client range out of bounds");
+        }
+        for (size_t i = first; i < last; i++) {
+            if (registered[i]) {
+                throw std::runtime_error("client " + std::to_string(i) + " registered twice");
+            }
+            registered[i] = true;
+        }
+        num_registered += hello.count;
+        std::cout << "  客户端进程 " << peers.size() << "：客户端 [" << first << ", " << last << ")" << std::endl;
+        peers.push_back(std::move(peer));
+    }
+    auto received = [&] {
+        size_t bytes = 0;
+        for (const auto& peer : peers) bytes += peer.bytes_received();
+        return bytes;
+    };
+    auto ack_all = [&](double server_ms) {
+        for (auto& peer : peers) {
+            peer.send(Transport::FrameType::Ack, 0, 0, to_ns(server_ms));
+        }
+    };
+    
+    // ===== Setup：接收上传分块并流水线聚合 =====
+    std::cout << "\n【阶段一】Setup：接收上传分块..." << std::endl;
+    size_t bytes_before = received();
+    server_.global_encoding = Matrix::zero_matrix(d1, shard.cols());
+    BoundedQueue<UploadRound> uploads(config_.setup_queue_depth);
+    double server_time = 0.0;
+    std::exception_ptr server_error;
+    std::thread aggregator([&] {
+        try {
+            server_time = server_aggregate(uploads);
+        } catch (...) {
+            server_error = std::current_exception();
+            uploads.close();
+        }
+    });
+    
+    std::vector<std::exception_ptr> receive_errors(peers.size());
+    std::vector<std::thread> receivers;
+    for (size_t p = 0; p < peers.size(); p++) {
+        receivers.emplace_back([&, p] {
+            try {
+                UploadRound round;
+                for (;;) {
+                    auto header = peers[p].receive_header();
+                    if (header.type == static_cast<uint16_t>(Transport::FrameType::SetupDone)) {
+                        if (!round.empty()) uploads.push(std::move(round));
+                        break;
+                    }
+                    // 先按帧头检查列区间与负载长度，再按 count 分配缓冲区
+                    if (header.type != static_cast<uint16_t>(Transport::FrameType::SetupChunk) ||
+                        header.client_id >= n || header.count == 0 || header.arg < shard.first_col ||
+                        header.arg > shard.last_col || header.count > shard.last_col - header.arg ||
+                        header.payload_bytes != uint64_t(header.count) * d1 * sizeof(uint64_t)) {
+                        throw std::runtime_error("malformed setup chunk");
+                    }
+                    UploadChunk chunk;
+                    chunk.client_id = header.client_id;
+                    chunk.first_col = header.arg;
+                    chunk.columns = MatrixType::uninitialized(d1, header.count, Matrix::Layout::ColMajor);
+                    Transport::Segments into;
+                    into.add(chunk.columns.data(), chunk.columns.size() * sizeof(uint64_t));
+                    peers[p].receive_payload(header, into);
+                    if (!reduced(chunk.columns.data(), chunk.columns.size(), config_.modulus)) {
+                        throw std::runtime_error("setup chunk value out of range");
+                    }
+                    if (!round.empty() && (round[0].first_col != chunk.first_col ||
+                                           round[0].columns.cols() != chunk.columns.cols())) {
+                        if (!uploads.push(std::move(round))) break;
+                        round.clear();
+                    }
+                    round.push_back(std::move(chunk));
+                }
+            } catch (...) {
+                receive_errors[p] = std::current_exception();
+                uploads.close();
+            }
+        });
+    }
+    for (auto& receiver : receivers) {
+        receiver.join();
+    }
+    uploads.close();
+    aggregator.join();
+    for (const auto& error : receive_errors) {
+        if (error) std::rethrow_exception(error);
+    }
+    if (server_error) {
+        std::rethrow_exception(server_error);
+    }
+    
+    Utils::Timer publish_timer;
+    publish_timer.start();
+    rebuild_query_snapshots();
+    publish_timer.stop();
+    metrics_.setup_server_aggregation_time_ms = server_time + publish_timer.elapsed_ms();
+    metrics_.setup_client_comm_bytes = received() - bytes_before;
+    persist_server_state();
+    ack_all(metrics_.setup_server_aggregation_time_ms);
+    std::cout << "Setup阶段完成" << std::endl;
+    std::cout << "  服务器聚合耗时: " << metrics_.setup_server_aggregation_time_ms << " ms" << std::endl;
+    std::cout << "  接收上传: " << metrics_.setup_client_comm_bytes / (1024.0 * 1024.0) << " MB" << std::endl;
+    
+    // ===== Update：收齐各客户端的稀疏列更新后一次应用 =====
+    std::cout << "\n【阶段二】Update：接收稀疏更新..." << std::endl;
+    bytes_before = received();
+    std::vector<SparseUpdate> updates;
+    for (auto& peer : peers) {
+        for (;;) {
+            auto header = peer.receive_header();
+            if (header.type == static_cast<uint16_t>(Transport::FrameType::UpdateDone)) break;
+            // 每列一个 uint32 分区下标与 d1 个差值；count 不超过本分片的列数
+            if (header.type != static_cast<uint16_t>(Transport::FrameType::UpdateColumns) ||
+                header.client_id >= n || header.count > shard.cols() ||
+                header.payload_bytes != uint64_t(header.count) * (sizeof(uint32_t) + d1 * sizeof(uint64_t))) {
+                throw std::runtime_error("malformed update frame");
+            }
+            SparseUpdate update;
+            update.client_id = header.client_id;
+            std::vector<uint32_t> ids(header.count);
+            update.columns.resize(header.count);
+            Transport::Segments into;
+            into.add(ids.data(), ids.size() * sizeof(uint32_t));
+            for (auto& delta : update.columns) {
+                delta.values.resize(d1);
+                into.add(delta.values.data(), d1 * sizeof(uint64_t));
+            }
+            peer.receive_payload(header, into);
+            for (size_t c = 0; c < ids.size(); c++) {
+                if (!shard.contains(ids[c])) throw std::runtime_error("update column outside this shard");
+                if (!reduced(update.columns[c].values.data(), d1, config_.modulus)) {
+                    throw std::runtime_error("update value out of range");
+                }
+                update.columns[c].partition_id = ids[c];
+            }
+            updates.push_back(std::move(update));
+        }
+    }
+    server_incremental_update(updates);
+    metrics_.update_client_comm_bytes = received() - bytes_before;
+    ack_all(metrics_.update_server_time_ms);
+    std::cout << "Update阶段完成" << std::endl;
+    std::cout << "  服务器更新耗时: " << metrics_.update_server_time_ms << " ms" << std::endl;
+    std::cout << "  接收更新: " << metrics_.update_client_comm_bytes / (1024.0 * 1024.0) << " MB" << std::endl;
+    
+    // ===== Query：逐批应答 =====
+    std::cout << "\n【阶段三】Query：应答查询..." << std::endl;
+    const size_t L = hypercube_.side();
+    const size_t H = hypercube_.inner_size();
+    const size_t w = config_.band_width;
+    // 每个查询的负载：RLWE为本分片的第一维密文与坐标比特的RGSW密文，明文为两个下标与w宽窗口
+    const uint64_t query_bytes = rlwe_ctx_
+        ? shard.rows() * Rlwe::ciphertext_bytes(*rlwe_ctx_) +
+              (hypercube_.dimensions() - 1) * coordinate_bits() * Rlwe::rgsw_bytes(*rlwe_ctx_)
+        : (2 + w) * sizeof(uint64_t);
+    const size_t max_batch = std::max<size_t>(1, config_.query_batch_size);
+    size_t num_queries = 0;
+    for (auto& peer : peers) {
+        for (;;) {
+            auto header = peer.receive_header();
+            if (header.type == static_cast<uint16_t>(Transport::FrameType::QueryDone)) break;
+            if (header.type != static_cast<uint16_t>(Transport::FrameType::QueryBatch) || header.count == 0 ||
+                header.count > max_batch || header.payload_bytes != header.count * query_bytes) {
+                throw std::runtime_error("malformed query frame");
+            }
+            const size_t Q = header.count;
+            size_t request_bytes = sizeof(header) + header.payload_bytes;
+            
+            Transport::Segments into;
+            Transport::Segments reply;
+            std::vector<uint64_t> heads;
+            std::vector<PlainQuery> plain_queries;
+            std::vector<RlweQuery> rlwe_queries;
+            std::vector<VectorType> plain_responses;
+            std::vector<RlweResponse> rlwe_responses;
+            if (rlwe_ctx_) {
+                rlwe_queries.assign(Q, rlwe_query_buffers(shard.rows()));
+                for (const auto& query : rlwe_queries) add_segments(into, query, 0, shard.rows());
+            } else {
+                heads.resize(2 * Q);
+                plain_queries.resize(Q);
+                into.add(heads.data(), heads.size() * sizeof(uint64_t));
+                for (auto& query : plain_queries) {
+                    query.window.resize(w);
+                    into.add(query.window.data(), w * sizeof(uint64_t));
+                }
+            }
+            peer.receive_payload(header, into);
+            if (rlwe_ctx_) {
+                for (const auto& query : rlwe_queries) {
+                    bool ok = std::all_of(query.first_dim.begin(), query.first_dim.end(),
+                                          [&](const Rlwe::Ciphertext& ct) { return reduced(*rlwe_ctx_, ct); });
+                    for (const auto& dim_bits : query.fold_bits) {
+                        for (const auto& rgsw : dim_bits) {
+                            for (const auto& row : rgsw.rows) ok = ok && reduced(*rlwe_ctx_, row);
+                        }
+                    }
+                    if (!ok) throw std::runtime_error("query ciphertext out of range");
+                }
+            } else {
+                for (size_t k = 0; k < Q; k++) {
+                    if (heads[2 * k + 1] >= H || !reduced(plain_queries[k].window.data(), w, config_.modulus)) {
+                        throw std::runtime_error("query out of range");
+                    }
+                }
+            }
+            
+            Utils::Timer timer;
+            timer.start();
+            if (rlwe_ctx_) {
+                rlwe_responses = server_process_rlwe_query_batch(rlwe_queries);
+                for (const auto& response : rlwe_responses) add_segments(reply, response);
+            } else {
+                for (size_t k = 0; k < Q; k++) {
+                    plain_queries[k].offset = heads[2 * k];
+                    plain_queries[k].inner_index = heads[2 * k + 1];
+                }
+                plain_responses = server_process_pir_query_batch(plain_queries);
+                for (const auto& response : plain_responses) {
+                    reply.add(response.data(), L * sizeof(uint64_t));
+                }
+            }
+            timer.stop();
+            peer.send(Transport::FrameType::ResponseBatch, 0, static_cast<uint32_t>(Q),
+                      to_ns(timer.elapsed_ms()), reply);
+            
+            metrics_.query_server_process_time_ms += timer.elapsed_ms();
+            metrics_.query_server_samples_ms.push_back(timer.elapsed_ms() / Q);
+            metrics_.query_comm_bytes += request_bytes;
+            metrics_.response_comm_bytes += sizeof(Transport::FrameHeader) + reply.bytes();
+            num_queries += Q;
+        }
+    }
+    metrics_.query_server_amortized_time_ms =
+        num_queries ? metrics_.query_server_process_time_ms / num_queries : 0.0;
+    std::cout << "Query阶段完成（共" << num_queries << "次查询）" << std::endl;
+    std::cout << "  服务器处理耗时: " << metrics_.query_server_process_time_ms << " ms" << std::endl;
+}
+
+/**
+ * 客户端进程
+ *
+ * 与进程内的三个阶段使用同一套客户端代码（client_setup / client_update / run_queries），
+ * 上传分块、稀疏更新与查询批次改为发送到各分片：上传分块按分片的列区间切开，
+ * 每段直接从分块的列缓冲区发送；稀疏更新按分区所在的分片分组；查询发给所有分片后
+ * 依次接收并相加各分片的部分响应。通信字节数取所有连接实际发送与接收的字节之和，
+ * 服务器耗时取各分片 Ack / ResponseBatch 帧报告值的最大值（分片并行处理）。
+ */
+void MFUPSIProtocol::run_clients(std::vector<Transport::Connection>& shards, size_t first_client, size_t last_client) {
+    if (first_client >= last_client || last_client > clients_.size()) {
+        throw std::invalid_argument("invalid client range");
+    }
+    if (shards.size() != shard_map_.num_shards()) {
+        throw std::invalid_argument("need one connection per server shard");
+    }
+    const size_t d1 = config_.partition_size;
+    const size_t S = shards.size();
+    metrics_.comm_measured = true;
+    
+    generate_keys();
+    initialize_pir_key();
+    for (size_t i = first_client; i < last_client; i++) {
+        generate_client_data(clients_[i], config_.dataset_size);
+    }
+    generate_mask_seeds();
+    
+    const std::vector<uint64_t> fingerprint = config_fingerprint(config_);
+    Transport::Segments hello;
+    hello.add(fingerprint.data(), fingerprint.size() * sizeof(uint64_t));
+    for (size_t s = 0; s < S; s++) {
+        shards[s].send(Transport::FrameType::Hello, static_cast<uint32_t>(first_client),
+                       static_cast<uint32_t>(last_client - first_client), s, hello);
+    }
+    auto sent = [&] {
+        size_t bytes = 0;
+        for (const auto& shard : shards) bytes += shard.bytes_sent();
+        return bytes;
+    };
+    auto received = [&] {
+        size_t bytes = 0;
+        for (const auto& shard : shards) bytes += shard.bytes_received();
+        return bytes;
+    };
+    auto finish_phase = [&](Transport::FrameType done) {
+        for (auto& shard : shards) {
+            shard.send(done, 0, 0, 0);
+        }
+        double server_ms = 0.0;
+        for (auto& shard : shards) {
+            server_ms = std::max(server_ms, from_ns(shard.expect(Transport::FrameType::Ack).arg));
+        }
+        return server_ms;
+    };
+    
+    // ===== Setup：上传分块按分片列区间切开，各段直接从分块的列缓冲区发送 =====
+    std::cout << "开始Setup阶段（客户端 [" << first_client << ", " << last_client << ")，"
+              << S << " 个服务器分片）..." << std::endl;
+    size_t sent_before = sent();
+    auto client_times = client_setup(first_client, last_client, [&](UploadRound&& round) {
+        // 一轮内各分块的列区间相同，发往每个分片的帧连续，分片据此把它们合为一轮
+        for (const auto& chunk : round) {
+            const size_t first = chunk.first_col, last = first + chunk.columns.cols();
+            for (size_t s = shard_map_.shard_of(first); s < S; s++) {
+                const ShardMap::Range& range = shard_map_.range(s);
+                if (range.first_col >= last) break;
+                const size_t lo = std::max(first, range.first_col), hi = std::min(last, range.last_col);
+                if (lo >= hi) continue;
+                Transport::Segments payload;
+                payload.add(chunk.columns.data() + (lo - first) * d1, (hi - lo) * d1 * sizeof(uint64_t));
+                shards[s].send(Transport::FrameType::SetupChunk, static_cast<uint32_t>(chunk.client_id),
+                               static_cast<uint32_t>(hi - lo), lo, payload);
+            }
+        }
+        return true;
+    });
+    for (double client_time : client_times) {
+        metrics_.setup_client_encoding_time_ms += client_time;
+        metrics_.setup_client_samples_ms.push_back(client_time);
+    }
+    metrics_.setup_server_aggregation_time_ms = finish_phase(Transport::FrameType::SetupDone);
+    metrics_.setup_client_comm_bytes = sent() - sent_before;
+    std::cout << "Setup阶段完成" << std::endl;
+    std::cout << "  客户端编码耗时: " << metrics_.setup_client_encoding_time_ms << " ms"
+              << " (" << metrics_.num_threads << " 线程, 并行加速比 "
+              << metrics_.setup_encode_speedup() << "x)" << std::endl;
+    std::cout << "  服务器聚合耗时: " << metrics_.setup_server_aggregation_time_ms << " ms" << std::endl;
+    std::cout << "  客户端上传通信: " << metrics_.setup_client_comm_bytes / (1024.0 * 1024.0) << " MB（实测）" << std::endl;
+    
+    // ===== Update：每个客户端向每个涉及的分片发一帧，分区下标数组后接各列差值 =====
+    std::cout << "开始Update阶段..." << std::endl;
+    sent_before = sent();
+    Prg::Stream rng(Prg::random_key(), 0);
+    for (size_t i = first_client; i < last_client; i++) {
+        SparseUpdate update = client_update(clients_[i], rng);
+        metrics_.update_client_time_ms += metrics_.update_client_samples_ms.back();
+        std::vector<std::vector<uint32_t>> ids(S);
+        std::vector<std::vector<const ColumnDelta*>> deltas(S);
+        for (const auto& delta : update.columns) {
+            size_t s = shard_map_.shard_of(delta.partition_id);
+            ids[s].push_back(static_cast<uint32_t>(delta.partition_id));
+            deltas[s].push_back(&delta);
+        }
+        for (size_t s = 0; s < S; s++) {
+            if (ids[s].empty()) continue;
+            Transport::Segments payload;
+            payload.add(ids[s].data(), ids[s].size() * sizeof(uint32_t));
+            for (const auto* delta : deltas[s]) {
+                payload.add(delta->values.data(), d1 * sizeof(uint64_t));
+            }
+            shards[s].send(Transport::FrameType::UpdateColumns, static_cast<uint32_t>(update.client_id),
+                           static_cast<uint32_t>(ids[s].size()), 0, payload);
+        }
+    }
+    metrics_.update_server_time_ms = finish_phase(Transport::FrameType::UpdateDone);
+    metrics_.update_client_comm_bytes = sent() - sent_before;
+    std::cout << "Update阶段完成" << std::endl;
+    std::cout << "  客户端更新耗时: " << metrics_.update_client_time_ms << " ms" << std::endl;
+    std::cout << "  服务器更新耗时: " << metrics_.update_server_time_ms << " ms" << std::endl;
+    std::cout << "  客户端上传通信: " << metrics_.update_client_comm_bytes / (1024.0 * 1024.0) << " MB（实测）" << std::endl;
+    
+    // ===== Query：只有托管客户端0的进程发送查询；先发给所有分片，再依次接收 =====
+    if (first_client == 0) {
+        const size_t L = hypercube_.side();
+        const uint64_t q = config_.modulus;
+        auto exchange = [&](size_t count, const std::vector<Transport::Segments>& requests,
+                            const std::vector<Transport::Segments>& into, double& server_ms) {
+            size_t sent_before = sent(), received_before = received();
+            for (size_t s = 0; s < S; s++) {
+                shards[s].send(Transport::FrameType::QueryBatch, 0, static_cast<uint32_t>(count), 0, requests[s]);
+            }
+            server_ms = 0.0;
+            for (size_t s = 0; s < S; s++) {
+                auto header = shards[s].expect(Transport::FrameType::ResponseBatch);
+                shards[s].receive_payload(header, into[s]);
+                server_ms = std::max(server_ms, from_ns(header.arg));
+            }
+            metrics_.query_comm_bytes += sent() - sent_before;
+            metrics_.response_comm_bytes += received() - received_before;
+        };
+        run_queries(
+            [&](const std::vector<PlainQuery>& queries, double& server_ms) {
+                // 明文查询与分片无关，每个分片收到同一请求并只填写自己的第一维坐标
+                std::vector<uint64_t> heads;
+                Transport::Segments request;
+                for (const auto& query : queries) {
+                    heads.push_back(query.offset);
+                    heads.push_back(query.inner_index);
+                }
+                request.add(heads.data(), heads.size() * sizeof(uint64_t));
+                for (const auto& query : queries) {
+                    request.add(query.window.data(), query.window.size() * sizeof(uint64_t));
+                }
+                std::vector<std::vector<VectorType>> partial(S, std::vector<VectorType>(queries.size(), VectorType(L)));
+                std::vector<Transport::Segments> into(S);
+                for (size_t s = 0; s < S; s++) {
+                    for (const auto& response : partial[s]) {
+                        into[s].add(response.data(), L * sizeof(uint64_t));
+                    }
+                }
+                exchange(queries.size(), std::vector<Transport::Segments>(S, request), into, server_ms);
+                for (size_t s = 0; s < S; s++) {
+                    for (const auto& response : partial[s]) {
+                        if (!reduced(response.data(), L, q)) {
+                            throw std::runtime_error("shard " + std::to_string(s) + " response value out of range");
+                        }
+                    }
+                }
+                std::vector<VectorType> responses = std::move(partial[0]);
+                for (size_t s = 1; s < S; s++) {
+                    for (size_t k = 0; k < responses.size(); k++) {
+                        for (size_t t = 0; t < L; t++) {
+                            responses[k][t] = Utils::add_mod(responses[k][t], partial[s][k][t], q);
+                        }
+                    }
+                }
+                return responses;
+            },
+            [&](const std::vector<RlweQuery>& queries, double& server_ms) {
+                // 每个分片只收到自己第一维坐标的密文；折叠是线性的，部分响应逐组相加
+                std::vector<Transport::Segments> requests(S);
+                std::vector<std::vector<RlweResponse>> partial(
+                    S, std::vector<RlweResponse>(queries.size(), rlwe_response_buffers()));
+                std::vector<Transport::Segments> into(S);
+                for (size_t s = 0; s < S; s++) {
+                    const ShardMap::Range& range = shard_map_.range(s);
+                    for (const auto& query : queries) add_segments(requests[s], query, range.first_row, range.last_row);
+                    for (const auto& response : partial[s]) add_segments(into[s], response);
+                }
+                exchange(queries.size(), requests, into, server_ms);
+                for (size_t s = 0; s < S; s++) {
+                    for (const auto& response : partial[s]) {
+                        for (const auto& ct : response.groups) {
+                            if (!reduced(*rlwe_ctx_, ct)) {
+                                throw std::runtime_error("shard " + std::to_string(s) + " response ciphertext out of range");
+                            }
+                        }
+                    }
+                }
+                std::vector<RlweResponse> responses = std::move(partial[0]);
+                for (size_t s = 1; s < S; s++) {
+                    for (size_t k = 0; k < responses.size(); k++) {
+                        for (size_t g = 0; g < responses[k].groups.size(); g++) {
+                            Rlwe::add_inplace(*rlwe_ctx_, responses[k].groups[g], partial[s][k].groups[g]);
+                        }
+                    }
+                }
+                return responses;
+            });
+    }
+    for (auto& shard : shards) {
+        shard.send(Transport::FrameType::QueryDone, 0, 0, 0);
+    }
 }
@@ -4,6 +4,23 @@
 #include "config.h"
 #include "utils.h"
 #include "matrix.h"
+#include "band_solver.h"
+#include "thread_pool.h"
+#include "partition_index.h"
+#include "flat_hash_set.h"
+#include "prg.h"
+#include "pir_database.h"
+#include "rlwe.h"
+#include "rlwe_database.h"
+#include "hypercube.h"
+#include "shard_map.h"
+#include "matrix_file.h"
+#include "bounded_queue.h"
+#include "transport.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
 #include <vector>
 #include <map>
 #include <set>
@@ -24,30 +41,31 @@ public:
     using VectorType = Matrix::VectorType;
     
     /**
-     * LWE密钥结构：用于PIR查询
-     * LWE密钥是一个长度N_lwe的向量
+     * 明文后端的查询描述符（不展开为稠密选择向量）
+     * - 第一维：RandVector 的w宽窗口起点与窗口内的系数
+     * - 第2..z维：one-hot 选择只需坐标本身，合并为 m = (idx_2, ..., idx_z)
      */
-    struct LWEKey {
-        VectorType secret_key;  // 秘密密钥向量（长度N_lwe）
-        size_t dimension;        // LWE維度N_lwe
+    struct PlainQuery {
+        size_t offset;
+        VectorType window;
+        size_t inner_index;
     };
     
     /**
-     * GSW密文矩阵结构
-     * GSW密文是一个(2*N_lwe) × (2*N_lwe)的矩阵，用于同态评估
+     * RLWE PIR查询（Config::rlwe_pir 启用时）
+     * - first_dim: L个RLWE密文，第idx_1个加密第一维选择多项式 V(X)，其余加密0
+     * - fold_bits: 第2..z维坐标的比特RGSW密文，每维 ceil(log2 L) 个，低比特在前
      */
-    struct GSWCiphertext {
-        MatrixType matrix;  // (2*N_lwe) × (2*N_lwe)的矩阵
-        size_t dimension;   // N_lwe
+    struct RlweQuery {
+        std::vector<Rlwe::Ciphertext> first_dim;
+        std::vector<std::vector<Rlwe::Rgsw>> fold_bits;
     };
     
     /**
-     * LWE密文向量：用于服务器响应
-     * LWE密文是一对(a, b)，其中a是长度N_lwe的向量
+     * RLWE PIR响应：E_total[:, j] 的16位limb分组打包，每组一个RLWE密文
      */
-    struct LWECiphertext {
-        VectorType a;      // 向量部分（长度N_lwe）
-        uint64_t b;         // 标量部分
+    struct RlweResponse {
+        std::vector<Rlwe::Ciphertext> groups;
     };
     
     /**
@@ -55,20 +73,72 @@ public:
      */
     struct Client {
         size_t client_id;
-        std::set<uint64_t> data_set;          // 当前数据集X_i
-        MatrixType encoding_matrix;            // 编码矩阵 E_i
-        MatrixType masked_encoding;            // 掩码编码 Ẽ_i = E_i + S_i
-        MatrixType mask_matrix;                // 掩码矩阵 S_i
+        FlatHashSet data_set;                  // 当前数据集X_i
+        PartitionIndex partition_index;        // 分区 -> 元素索引（与data_set同步）
+        MatrixType encoding_matrix;            // 编码矩阵 E_i（Ẽ_i = E_i + S_i 只在上传分块中出现）
+        Prg::Key mask_seed;                    // 掩码种子：S_i 按列由PRG展开，不再存储
+        std::vector<uint32_t> mask_versions;   // 每列掩码的版本号（更新时递增以重新随机化）
+    };
+    
+    /**
+     * Setup上传分块：客户端的掩码编码 Ẽ_i 中 [first_col, first_col + columns.cols()) 列
+     */
+    struct UploadChunk {
+        size_t client_id = 0;
+        size_t first_col = 0;
+        MatrixType columns;                    // d_1 × 分块列数，列主序
+    };
+    
+    /**
+     * Setup上传轮：若干客户端对同一列区间的上传分块，服务器一次n路归约全部累加
+     */
+    using UploadRound = std::vector<UploadChunk>;
+    
+    /**
+     * 查询数据库：由 E_total 派生的查询布局，发布后只读
+     */
+    struct QueryDatabase {
+        PirDatabase pir_db;                    // 明文后端的分块扫描布局
+        RlweDatabase rlwe_db;                  // RLWE后端的NTT明文多项式
+        uint64_t version = 0;                  // 已应用的Update批次数
     };
     
     /**
      * 服务器端数据结构
+     *
+     * 查询读取 active 指向的快照，Update 不在其上原地修改（双缓冲 + RCU式发布）：
+     *   1. Update 在 standby 上补齐上一版本的改动（standby_stale）并写入本次改动
+     *   2. 交换 active 与 standby；正在执行的查询仍持有旧快照的引用
+     *   3. 下一次Update开始前等待旧快照的读者全部释放
+     * active、standby 的引用计数只在 snapshot_mutex_ 下变化，读者释放与写者修改之间的先后关系由锁保证
+     * 查询不会阻塞在Update上，每个查询看到的是某个完整版本。
      */
     struct Server {
-        MatrixType global_encoding;            // 全局聚合编码 E_total
+        ShardMap::Range shard;                 // 本服务器持有的列区间（不分片时为全部b列）
+        MatrixType global_encoding;            // E_total 的 shard 列（写端主副本），第c列为分区 first_col + c
+        std::shared_ptr<QueryDatabase> active; // 查询使用的当前版本（snapshot_mutex_ 下访问）
+        std::shared_ptr<QueryDatabase> standby; // 备用版本：下一次Update在其上修改
+        std::vector<size_t> standby_stale;     // standby 相对 active 尚未应用改动的列
         std::map<uint64_t, uint64_t> query_log; // 查询日志（用于调试）
     };
     
+    /**
+     * 单个分区列的更新：Δẽ_j = (e_j' - e_j) + (s_j' - s_j)
+     * 编码差值由该列新的掩码差值遮盖，服务器原地加到 E_total[:, j]
+     */
+    struct ColumnDelta {
+        size_t partition_id;                   // 分区下标j
+        VectorType values;                     // d_1个Z_q元素
+    };
+    
+    /**
+     * Update阶段的稀疏上传格式：只包含受影响分区的列
+     */
+    struct SparseUpdate {
+        size_t client_id;
+        std::vector<ColumnDelta> columns;
+    };
+    
     // 性能测量结果
     struct PerformanceMetrics {
         // Setup阶段
@@ -86,8 +156,52 @@ public:
         double query_client_gen_time_ms;        // 客户端查询生成
         double query_server_process_time_ms;    // 服务器处理
         double query_client_decrypt_time_ms;    // 客户端解密
+        double query_server_amortized_time_ms;  // 批处理下每个查询分摊的服务器耗时
         size_t query_comm_bytes;                // 查询通信字节
         size_t response_comm_bytes;             // 响应通信字节
+        size_t query_intersection_hits;         // 判定在交集中的查询数
+        
+        // 并行扩展性
+        size_t num_threads;                     // 编码线程数
+        double setup_encode_work_time_ms;       // 各分区编码耗时之和（等效单线程耗时）
+        double setup_encode_wall_time_ms;       // 并行分区编码的实际耗时
+        
+        // 编码失败率：线性系统不相容的分区（Setup与Update中重新编码的分区都计入）
+        size_t encoded_partitions;              // 编码的分区数
+        size_t inconsistent_partitions;         // 其中不相容的分区数
+        
+        // 联网部署（serve / run_clients）：通信字节数为传输层实测的帧字节（含帧头），
+        // 否则按 Z_q 元素的紧凑编码估计
+        bool comm_measured;
+        double query_network_time_ms;           // 查询往返耗时中服务器处理以外的部分
+        
+        // Query阶段期间并发执行的Update（config.concurrent_updates），不计入Update阶段的指标与编码失败率
+        size_t concurrent_update_rounds;        // 查询期间发布的Update轮数
+        double concurrent_update_server_ms;     // 这些轮次的服务器更新耗时之和
+        
+        // 持久化与热重启（仅在配置了 encoding_file 时）
+        double setup_persist_time_ms;           // 写出 global_encoding 的耗时
+        double setup_restore_time_ms;           // 映射文件并重建查询快照的耗时
+        
+        // 逐操作样本（供基准统计分位数；批处理操作按批内查询数分摊）
+        std::vector<double> setup_client_samples_ms;         // 每个客户端的编码耗时
+        std::vector<double> update_client_samples_ms;        // 每个客户端的增量计算耗时
+        std::vector<double> query_gen_samples_ms;            // 每个查询的生成耗时
+        std::vector<double> query_server_samples_ms;         // 每批服务器耗时 / 批大小
+        std::vector<double> query_decrypt_samples_ms;        // 每批解密耗时 / 批大小
+        
+        /**
+         * 分区编码的并行加速比：等效单线程耗时 / 实际耗时
+         */
+        double setup_encode_speedup() const {
+            return setup_encode_wall_time_ms > 0
+                ? setup_encode_work_time_ms / setup_encode_wall_time_ms : 0.0;
+        }
+        
+        double encode_failure_rate() const {
+            return encoded_partitions > 0
+                ? static_cast<double>(inconsistent_partitions) / encoded_partitions : 0.0;
+        }
     };
     
     /**
@@ -112,9 +226,22 @@ public:
     
     /**
      * Query阶段：PIR查询
+     * config.concurrent_updates 时另起一个写线程，对客户端 1..n-1 持续执行Update轮次
+     * （增量编码、服务器更新并发布新快照），直到全部查询完成；查询批次各自读取发布的快照
      */
     void query_phase();
     
+    /**
+     * 将服务器的 global_encoding 写入矩阵文件（格式见 matrix_file.h）
+     */
+    void save_server_state(const std::string& path) const;
+    
+    /**
+     * 热重启：映射持久化的 global_encoding 作为服务器状态并重建查询快照，
+     * 矩阵内容按页从文件读入，Update只触及被修改的列
+     */
+    void restore_server_state(const std::string& path);
+    
     /**
      * 获取性能指标
      */
@@ -125,61 +252,126 @@ public:
      */
     void reset_metrics();
     
+    // ===== 参数自动调优的标定（见 autotuner.h）=====
+    
+    /**
+     * Setup标定结果：单个客户端的分区编码与服务器聚合
+     */
+    struct SetupCalibration {
+        size_t partitions = 0;               // 参与标定的分区数
+        size_t inconsistent = 0;             // 其中线性系统不相容的分区数
+        double encode_partition_ms = 0;      // 每个分区编码加掩码的墙钟耗时
+        double aggregate_partition_ms = 0;   // 服务器累加一个上传列的耗时
+    };
+    
+    /**
+     * 由客户端0的完整数据集编码前 max_partitions 个分区（0表示全部b个），
+     * 与 setup_phase 使用同一条编码、掩码与聚合路径，不构建查询快照
+     */
+    SetupCalibration calibrate_setup(size_t max_partitions);
+    
+    /**
+     * 查询标定的准备：以随机矩阵代替聚合结果构建查询快照，客户端0只生成
+     * num_queries 个查询元素，之后由 query_phase() 测量查询耗时；返回构建快照的耗时（毫秒）
+     */
+    double prepare_query_calibration();
+    
+    /**
+     * 按配置估计本进程模拟全部客户端与服务器时的驻留内存（字节）：
+     * 各客户端的编码矩阵、数据集与分区索引，服务器的 global_encoding 与两个查询快照
+     */
+    static size_t estimate_memory_bytes(const Config_t& cfg);
+    
+    // ===== 联网部署（帧格式见 transport.h）=====
+    
+    /**
+     * 服务器进程（分片 shard，共 config_.num_shards 个）：只持有该分片的列。
+     * 接受客户端进程的连接直到n个客户端全部登记（各进程的配置指纹须一致），
+     * 然后依次执行三个阶段的服务器端：接收上传分块并聚合、接收稀疏列更新、应答查询批次，
+     * 所有连接发送 QueryDone 后返回
+     */
+    void serve(Transport::Listener& listener, size_t shard = 0);
+    
+    /**
+     * 客户端进程：托管客户端 [first_client, last_client)，shards[s] 为到分片s的连接。
+     * 上传分块与列更新按分区所在的分片路由，查询扇出到所有分片后合并部分响应；
+     * 托管客户端0的进程负责查询。各进程须使用相同的 key_seed 以共享全局密钥
+     */
+    void run_clients(std::vector<Transport::Connection>& shards, size_t first_client, size_t last_client);
+    
 private:
     Config_t config_;
     std::vector<Client> clients_;
     Server server_;
     PerformanceMetrics metrics_;
     
+    // 分区编码线程池
+    std::unique_ptr<ThreadPool> pool_;
+    
+    // 查询处理线程池（与编码分开，Update进行时查询仍可并行执行）
+    std::unique_ptr<ThreadPool> query_pool_;
+    
+    // 查询快照的发布与释放（见 Server）
+    mutable std::mutex snapshot_mutex_;
+    mutable std::condition_variable snapshot_released_;
+    
+    // PIR超立方体几何（L与各维步长）
+    Hypercube hypercube_;
+    
+    // 服务器分片：列按第一维坐标划分（config_.num_shards 个分片）
+    ShardMap shard_map_;
+    
     // 全局密钥
     uint64_t key_k1_;  // F_1: 分区哈希
     uint64_t key_k2_;  // F_2: 随机向量生成
     uint64_t key_kr_;  // F_r: 元素表示
     
-    // LWE密钥（用于PIR查询）
-    LWEKey pir_lwe_key_;
-
-    // 全局掩码矩阵（为所有客户端预生成，不计入计时）
-    std::vector<MatrixType> global_masks_;
+    // RLWE PIR：参数上下文、私钥与采样器（仅客户端持有私钥）
+    std::unique_ptr<Rlwe::Context> rlwe_ctx_;
+    Rlwe::SecretKey rlwe_sk_;
+    Rlwe::Sampler rlwe_sampler_;
+    std::unique_ptr<Rlwe::CoefficientDecryptor> rlwe_decryptor_;  // 只读取响应中存放limb内积的系数
     
+    RlweDatabase::Packing rlwe_packing_;   // E_total 元素的明文打包参数
+
     // ===== PIR相关辅助计算 =====
     
     /**
-     * 计算z维PIR中每个维度的大小L
-     * L = ceil(b^(1/z))，其中b是分区总数
+     * 生成PIR查询使用的RLWE私钥
+     */
+    void initialize_pir_key();
+    
+    /**
+     * 生成明文后端的查询描述符
      */
-    size_t compute_pir_dimension_size();
+    PlainQuery generate_plain_query(uint64_t element);
     
     /**
-     * 将分区索引j映射到z维超立方体坐标
-     * 将j视为基数L的数字，分解为z个坐标：
-     * j = idx_1 * L^(z-1) + idx_2 * L^(z-2) + ... + idx_z * L^0
-     * 
-     * 返回：z个坐标的向量[idx_1, idx_2, ..., idx_z]
+     * 生成RLWE查询：第一维选择多项式与后续维度坐标比特的加密
      */
-    std::vector<size_t> compute_hypercube_coordinates(size_t j);
+    RlweQuery generate_rlwe_query(uint64_t element);
     
     /**
-     * 初始化LWE密钥：生成随机秘密向量
+     * 批量RLWE PIR服务器处理：第一维为密文 × 预处理明文列的乘加（明文在批内复用），
+     * 后续维度用CMux树流式折叠
      */
-    void initialize_lwe_key();
+    std::vector<RlweResponse> server_process_rlwe_query_batch(const std::vector<RlweQuery>& queries);
     
     /**
-     * 生成GSW密文矩阵（模拟加密，不需要正确结果）
-     * 用于客户端查询生成，矩阵大小(2*N_lwe) × (2*N_lwe)
+     * 解密RLWE响应，还原 <v_1, E_total[:, j]> mod q
      */
-    GSWCiphertext generate_gsw_ciphertext_for_coordinate(size_t coordinate, size_t L);
+    uint64_t decrypt_rlwe_response(const RlweResponse& response) const;
     
     /**
-     * 生成z个选择向量，每个对应超立方体中的一个维度
+     * 第2..z维每个坐标的比特数 ceil(log2 L)
      */
-    std::vector<VectorType> generate_z_selection_vectors(size_t element);
+    size_t coordinate_bits() const;
     
     /**
-     * 计算时间消耗：模拟z维PIR折叠过程中的同态乘法
-     * 执行约z×b次矩阵乘法，代表同态扩展的开销
+     * 按实际密文计算的查询/响应字节数
      */
-    size_t simulate_gsw_external_product_cost();
+    size_t rlwe_query_bytes(const RlweQuery& query) const;
+    size_t rlwe_response_bytes(const RlweResponse& response) const;
     
     // ===== 原有函数 =====
     
@@ -189,73 +381,155 @@ private:
     void generate_client_data(Client& client, size_t size);
     
     /**
-     * 客户端本地编码（Setup）
-     * 按照协议文档中的Algorithm 2: ClientEncode
+     * 客户端本地编码（Setup流水线的一个分块）
+     * 按照协议文档中的Algorithm 2: ClientEncode，编码分区 [first, last)：
+     * e_j 写入 client.encoding_matrix，返回加掩码后的上传分块
      */
-    MatrixType client_encode(const std::set<uint64_t>& data_set);
+    UploadChunk client_encode_chunk(Client& client, size_t first, size_t last);
     
     /**
      * 分区编码子算法
      * 按照协议文档中的Algorithm 3: EncodePartition
+     * 输入为分区元素的连续区间 [partition_elements, partition_elements + count)，
+     * 编码 e_j 写入 out[0, d_1)（通常直接是编码矩阵的一列）
      */
-    VectorType encode_partition(const std::vector<uint64_t>& partition_elements);
+    bool encode_partition(const uint64_t* partition_elements, size_t count, uint64_t* out);
     
     /**
-     * 构建带状矩阵和目标向量
+     * 构建带状矩阵和目标向量（每行只存储w宽窗口）
      */
     void build_linear_system(
-        const std::vector<uint64_t>& elements,
-        MatrixType& M,
-        VectorType& y
+        const uint64_t* elements,
+        size_t m,
+        BandSolver::System& sys
     );
     
     /**
-     * 生成稀疏向量
-     * 按照协议文档中的Algorithm 4: RandVector
+     * 生成稀疏向量的紧凑形式
+     * 按照协议文档中的Algorithm 4: RandVector，只输出w宽窗口：
+     * 返回窗口起点，窗口内的w个0/1系数写入 coeffs
      */
-    VectorType generate_rand_vector(uint64_t element);
+    size_t generate_rand_window(uint64_t element, uint64_t* coeffs);
     
     /**
-     * 生成掩码矩阵
+     * 为每个客户端生成掩码种子（Setup阶段初始化）
      */
-    MatrixType generate_mask_matrix(size_t rows, size_t cols);
-
+    void generate_mask_seeds();
+    
     /**
-     * 生成全局掩码矩阵（Setup阶段初始化）
+     * 展开客户端掩码 S_i 的第j列（当前版本）到长度d_1的数组
      */
-    void generate_global_masks();
+    void expand_mask_column(const Client& client, size_t j, uint64_t* out) const;
     
     /**
-     * 服务器端聚合（Setup）
+     * 客户端 [first_client, last_client) 的Setup：建立分区索引，逐列区间编码，
+     * 各客户端同一列区间的分块作为一轮交给 upload（返回false时停止）；
+     * 返回各客户端耗时（不含 upload）
      */
-    void server_aggregate();
+    std::vector<double> client_setup(size_t first_client, size_t last_client,
+                                     const std::function<bool(UploadRound&&)>& upload);
+    
+    /**
+     * 持久化 global_encoding 并由映射热重启（仅在配置了 encoding_file 时）
+     */
+    void persist_server_state();
+    
+    /**
+     * 服务器端聚合（Setup流水线的消费者）：每轮上传分块经一次n路归约累加到 global_encoding，
+     * 直到队列关闭；返回累加耗时（毫秒）
+     */
+    double server_aggregate(BoundedQueue<UploadRound>& uploads);
+    
+    /**
+     * 一个客户端的一轮Update：抽样增删元素、同步数据集与分区索引并增量编码
+     */
+    SparseUpdate client_update(Client& client, Prg::Stream& rng);
     
     /**
      * 客户端增量编码（Update）
+     * 重新编码受影响的分区并重新随机化其掩码列，返回只含这些列的稀疏更新
      */
-    MatrixType client_incremental_update(Client& client, const std::set<uint64_t>& X_add,
-                                                                                      const std::set<uint64_t>& X_del);
+    SparseUpdate client_incremental_update(Client& client, const std::set<uint64_t>& X_add,
+                                           const std::set<uint64_t>& X_del);
     
     /**
-     * 服务器端增量更新（Update）
+     * 服务器端增量更新（Update）：将各列差值原地累加到 global_encoding
      */
-    void server_incremental_update();
+    void server_incremental_update(const std::vector<SparseUpdate>& updates);
     
     /**
-     * 【改进版】服务器处理PIR查询：z维维度折叠
-     * 模拟GSW同态扩展和线性检索的完整过程
-     * - 执行z轮维度折叠
-     * - 每轮使用约b/L^i的矩阵乘法
-     * - 总计约z×b次同态运算
+     * 由 global_encoding 构建当前后端使用的查询布局
      */
-    VectorType server_process_pir_query_z_dimension(
-        const std::vector<VectorType>& z_selection_vectors
-    );
+    void build_query_database(QueryDatabase& db);
+    
+    /**
+     * 由 global_encoding 重建 active 与 standby 两个快照并发布（Setup聚合与热重启）
+     */
+    void rebuild_query_snapshots();
+    
+    /**
+     * 将 touched 列的改动写入备用快照并原子发布为新版本
+     */
+    void publish_query_database(const std::vector<size_t>& touched);
+    
+    /**
+     * 查询开始时获取当前快照（查询期间一直有效）
+     */
+    std::shared_ptr<const QueryDatabase> query_snapshot() const;
+    
+    /**
+     * 【改进版】服务器处理PIR查询：z维维度折叠（明文后端），Q个查询共享一次数据库扫描
+     * - 第一维：w宽选择窗口对分块数据库的扫描，得到长度b的向量
+     * - 第2..z维：one-hot 选择，直接取出 m = (idx_2, ..., idx_z) 对应的L个值
+     * 每个响应为长度L的向量，按第一个超立方体坐标索引
+     */
+    std::vector<VectorType> server_process_pir_query_batch(const std::vector<PlainQuery>& queries);
+    
+    /**
+     * 一批查询的服务器端处理：返回响应，server_ms 为服务器报告的处理耗时
+     * （进程内直接调用批处理函数，联网部署中经连接往返）
+     */
+    using PlainServer = std::function<std::vector<VectorType>(const std::vector<PlainQuery>&, double& server_ms)>;
+    using RlweServer = std::function<std::vector<RlweResponse>(const std::vector<RlweQuery>&, double& server_ms)>;
+    
+    /**
+     * 查询客户端的查询流程（生成、服务器处理、解密与统计），query_phase 与 run_clients 共用
+     */
+    void run_queries(const PlainServer& plain_server, const RlweServer& rlwe_server);
+    
+    /**
+     * query_phase 的写线程：持续执行Update轮次直到 queries_done
+     */
+    void concurrent_updates(const std::atomic<bool>& queries_done);
+    
+    /**
+     * 帧负载布局：查询与响应的各缓冲区依次加入 segments，收发两端使用同一布局；
+     * 接收前先用 *_buffers 按参数分配好形状。RLWE查询只发送分片持有的第一维坐标
+     * [first_row, last_row) 对应的密文与全部坐标比特
+     */
+    void add_segments(Transport::Segments& segments, const RlweQuery& query,
+                      size_t first_row, size_t last_row) const;
+    void add_segments(Transport::Segments& segments, const RlweResponse& response) const;
+    RlweQuery rlwe_query_buffers(size_t rows) const;
+    RlweResponse rlwe_response_buffers() const;
+    
+    /**
+     * 交集成员位图：第k位为1表示第k个查询元素在交集中
+     */
+    using MembershipBitmap = std::vector<uint64_t>;
+    
+    /**
+     * 批量解密和交集判断：responses[k] 对应 elements[k]
+     */
+    MembershipBitmap decrypt_and_judge_batch(const std::vector<RlweResponse>& responses,
+                                             const uint64_t* elements) const;
+    MembershipBitmap decrypt_and_judge_batch(const std::vector<VectorType>& responses,
+                                             const uint64_t* elements) const;
     
     /**
-     * 客户端解密和交集判断
+     * 交集判断：PIR还原的值 values[k] 是否等于 n · F_r(K_r, elements[k]) mod q
      */
-    bool decrypt_and_judge(const VectorType& pir_response, uint64_t element);
+    MembershipBitmap judge_response_values(const uint64_t* values, const uint64_t* elements, size_t n) const;
 };
 
 #endif // PROTOCOL_H
@@ -0,0 +1,780 @@
+#ifndef RLWE_H
+#define RLWE_H
+
+#include "modarith.h"
+#include "prg.h"
+#include "simd_mod.h"
+#include "instrumentation.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+/**
+ * RLWE/RGSW同态加密引擎（PIR查询的密文路径）
+ *
+ * 环 R_Q = Z_Q[X] / (X^N + 1)，N = lwe_dimension（2的幂）
+ *   - Q = q_0 · q_1：两个约50位、满足 q_i ≡ 1 (mod 2N) 的NTT友好素数（RNS表示）
+ *   - 明文模数 t = 2^28，缩放因子 Δ = floor(Q / t)
+ *   - 密钥 s 取三值分布，噪声取中心二项分布（σ ≈ 3.2）
+ *
+ * 多项式按RNS分量连续存放：分量i占 [i·N, (i+1)·N)。密文和RGSW行一律保存为NTT形式，
+ * 乘法为逐点运算；只有外积的分解步骤需要回到系数形式。
+ *
+ * 外积 RGSW(m) ⊡ RLWE(μ) = RLWE(m·μ)：
+ *   将密文 (a, b) 的每个系数经CRT还原为 [0, Q) 中的整数，按基 B = 2^25 分解为ℓ位，
+ *   再与RGSW的2ℓ行做乘加。CMux(bit, c0, c1) = c0 + RGSW(bit) ⊡ (c1 - c0)。
+ *
+ * 注意：N 取配置中的 lwe_dimension，参数组合未按安全级别校验，仅用于性能评估。
+ */
+
+class Rlwe {
+public:
+    using u128 = ModArith::u128;
+    using Poly = std::vector<uint64_t>;
+
+    static constexpr size_t kNumPrimes = 2;
+    static constexpr size_t kPrimeBits = 50;
+    static constexpr size_t kPlainBits = 28;
+    static constexpr size_t kGadgetBits = 25;
+
+    /**
+     * 单个RNS素数上的负循环NTT表（Shoup预计算）
+     */
+    struct NttPrime {
+        uint64_t p;
+        ModArith::Barrett64 mod;
+        std::vector<uint64_t> psi_rev;            // psi^bitrev(k)
+        std::vector<uint64_t> psi_rev_shoup;
+        std::vector<uint64_t> psi_inv_rev;        // psi^-bitrev(k)
+        std::vector<uint64_t> psi_inv_rev_shoup;
+        uint64_t n_inv;
+        uint64_t n_inv_shoup;
+
+        NttPrime(uint64_t prime, size_t n) : p(prime), mod(prime) {
+            size_t log_n = 0;
+            while ((size_t(1) << log_n) < n) log_n++;
+
+            uint64_t psi = find_psi(n);
+            uint64_t psi_inv = ModArith::inverse(mod, psi);
+            psi_rev.resize(n);
+            psi_inv_rev.resize(n);
+            uint64_t pw = 1, pw_inv = 1;
+            for (size_t k = 0; k < n; k++) {
+                size_t r = bit_reverse(k, log_n);
+                psi_rev[r] = pw;
+                psi_inv_rev[r] = pw_inv;
+                pw = mod.mul(pw, psi);
+                pw_inv = mod.mul(pw_inv, psi_inv);
+            }
+            psi_rev_shoup.resize(n);
+            psi_inv_rev_shoup.resize(n);
+            for (size_t k = 0; k < n; k++) {
+                psi_rev_shoup[k] = shoup(psi_rev[k], p);
+                psi_inv_rev_shoup[k] = shoup(psi_inv_rev[k], p);
+            }
+            n_inv = ModArith::inverse(mod, n % p);
+            n_inv_shoup = shoup(n_inv, p);
+        }
+
+        /**
+         * 原地正变换（Cooley-Tukey，输出为比特反转序）
+         */
+        void forward(uint64_t* a, size_t n) const {
+            size_t t = n;
+            for (size_t m = 1; m < n; m <<= 1) {
+                t >>= 1;
+                for (size_t i = 0; i < m; i++) {
+                    const uint64_t w = psi_rev[m + i];
+                    const uint64_t ws = psi_rev_shoup[m + i];
+                    uint64_t* x = a + 2 * i * t;
+                    uint64_t* y = x + t;
+                    for (size_t j = 0; j < t; j++) {
+                        uint64_t u = x[j];
+                        uint64_t v = mul_shoup(y[j], w, ws, p);
+                        x[j] = add(u, v);
+                        y[j] = sub(u, v);
+                    }
+                }
+            }
+        }
+
+        /**
+         * 原地逆变换（Gentleman-Sande，输入为比特反转序），含 N^-1 缩放
+         */
+        void inverse(uint64_t* a, size_t n) const {
+            size_t t = 1;
+            for (size_t m = n; m > 1; m >>= 1) {
+                size_t h = m >> 1;
+                for (size_t i = 0; i < h; i++) {
+                    const uint64_t w = psi_inv_rev[h + i];
+                    const uint64_t ws = psi_inv_rev_shoup[h + i];
+                    uint64_t* x = a + 2 * i * t;
+                    uint64_t* y = x + t;
+                    for (size_t j = 0; j < t; j++) {
+                        uint64_t u = x[j];
+                        uint64_t v = y[j];
+                        x[j] = add(u, v);
+                        y[j] = mul_shoup(sub(u, v), w, ws, p);
+                    }
+                }
+                t <<= 1;
+            }
+            for (size_t j = 0; j < n; j++) {
+                a[j] = mul_shoup(a[j], n_inv, n_inv_shoup, p);
+            }
+        }
+
+        // 条件减法用掩码实现：NTT中的分支几乎随机，预测失败的代价远高于运算本身
+        uint64_t add(uint64_t a, uint64_t b) const {
+            uint64_t s = a + b - p;
+            return s + (p & (0 - (s >> 63)));
+        }
+
+        uint64_t sub(uint64_t a, uint64_t b) const {
+            uint64_t d = a - b;
+            return d + (p & (0 - static_cast<uint64_t>(a < b)));
+        }
+
+        /**
+         * 有符号小整数在 Z_p 中的表示
+         */
+        uint64_t from_signed(int64_t x) const {
+            return x >= 0 ? static_cast<uint64_t>(x) % p
+                          : p - static_cast<uint64_t>(-x) % p;
+        }
+
+        static uint64_t shoup(uint64_t w, uint64_t p) {
+            return static_cast<uint64_t>((static_cast<u128>(w) << 64) / p);
+        }
+
+        static uint64_t mul_shoup(uint64_t x, uint64_t w, uint64_t ws, uint64_t p) {
+            uint64_t q = static_cast<uint64_t>((static_cast<u128>(x) * ws) >> 64);
+            uint64_t r = x * w - q * p - p;
+            return r + (p & (0 - (r >> 63)));
+        }
+
+    private:
+        uint64_t find_psi(size_t n) const {
+            for (uint64_t g = 2; g < p; g++) {
+                uint64_t psi = ModArith::pow(mod, g, (p - 1) / (2 * n));
+                if (ModArith::pow(mod, psi, n) == p - 1) {
+                    return psi;
+                }
+            }
+            throw std::runtime_error("no primitive 2N-th root of unity");
+        }
+
+        static size_t bit_reverse(size_t x, size_t bits) {
+            size_t r = 0;
+            for (size_t i = 0; i < bits; i++) {
+                r = (r << 1) | ((x >> i) & 1);
+            }
+            return r;
+        }
+    };
+
+    /**
+     * 参数上下文：RNS素数、NTT表、Δ、CRT与gadget常数
+     */
+    class Context {
+    public:
+        explicit Context(size_t n) : n_(n) {
+            if (n < 2 || (n & (n - 1)) != 0) {
+                throw std::invalid_argument("RLWE ring dimension must be a power of two");
+            }
+            uint64_t step = 2 * n;
+            uint64_t candidate = ((1ULL << kPrimeBits) - 1) / step * step + 1;
+            while (primes_.size() < kNumPrimes) {
+                if (is_prime(candidate)) {
+                    primes_.emplace_back(candidate, n);
+                }
+                candidate -= step;
+            }
+
+            const uint64_t q0 = primes_[0].p;
+            const uint64_t q1 = primes_[1].p;
+            modulus_ = static_cast<u128>(q0) * q1;
+            q0_inv_mod_q1_ = ModArith::inverse(primes_[1].mod, q0 % q1);
+
+            plain_modulus_ = 1ULL << kPlainBits;
+            delta_ = modulus_ / plain_modulus_;
+            for (const auto& prime : primes_) {
+                delta_rns_.push_back(static_cast<uint64_t>(delta_ % prime.p));
+            }
+
+            size_t q_bits = 0;
+            while (q_bits < 128 && (modulus_ >> q_bits) != 0) q_bits++;
+            gadget_len_ = (q_bits + kGadgetBits - 1) / kGadgetBits;
+        }
+
+        size_t n() const { return n_; }
+        size_t num_primes() const { return primes_.size(); }
+        size_t poly_words() const { return primes_.size() * n_; }
+        const NttPrime& prime(size_t i) const { return primes_[i]; }
+        uint64_t plain_modulus() const { return plain_modulus_; }
+        size_t gadget_len() const { return gadget_len_; }
+
+        Poly zero_poly() const { return Poly(poly_words(), 0); }
+
+        /**
+         * 一次（全部RNS分量的）NTT或逆NTT的模乘次数 K · N/2 · log N，供插桩统计
+         */
+        uint64_t ntt_modmuls() const {
+            uint64_t log_n = 0;
+            while ((size_t(1) << log_n) < n_) log_n++;
+            return primes_.size() * (n_ / 2) * log_n;
+        }
+
+        void ntt(uint64_t* poly) const {
+            for (size_t i = 0; i < primes_.size(); i++) {
+                primes_[i].forward(poly + i * n_, n_);
+            }
+        }
+
+        void intt(uint64_t* poly) const {
+            for (size_t i = 0; i < primes_.size(); i++) {
+                primes_[i].inverse(poly + i * n_, n_);
+            }
+        }
+
+        /**
+         * 有符号系数（长度N）写入所有RNS分量（系数形式）
+         */
+        void from_signed(const int64_t* coeffs, uint64_t* poly) const {
+            for (size_t i = 0; i < primes_.size(); i++) {
+                for (size_t k = 0; k < n_; k++) {
+                    poly[i * n_ + k] = primes_[i].from_signed(coeffs[k]);
+                }
+            }
+        }
+
+        /**
+         * 第k个系数的CRT还原（Garner）：返回 [0, Q) 中的整数
+         */
+        u128 crt(const uint64_t* poly, size_t k) const {
+            return crt(poly[k], poly[n_ + k]);
+        }
+
+        u128 crt(uint64_t x0, uint64_t x1) const {
+            const NttPrime& p0 = primes_[0];
+            const NttPrime& p1 = primes_[1];
+            uint64_t v = p1.mod.mul(p1.sub(x1, x0 % p1.p), q0_inv_mod_q1_);
+            return x0 + static_cast<u128>(p0.p) * v;
+        }
+
+        /**
+         * 解码系数：round(x / Δ) mod t
+         */
+        uint64_t decode(u128 x) const {
+            return static_cast<uint64_t>((x + delta_ / 2) / delta_) & (plain_modulus_ - 1);
+        }
+
+        uint64_t delta_rns(size_t i) const { return delta_rns_[i]; }
+
+    private:
+        size_t n_;
+        std::vector<NttPrime> primes_;
+        u128 modulus_ = 0;
+        uint64_t q0_inv_mod_q1_ = 0;
+        uint64_t plain_modulus_ = 0;
+        u128 delta_ = 0;
+        std::vector<uint64_t> delta_rns_;
+        size_t gadget_len_ = 0;
+
+        /**
+         * 确定性Miller-Rabin（对64位整数使用前12个素数作为底）
+         */
+        static bool is_prime(uint64_t n) {
+            if (n < 2) return false;
+            static const uint64_t bases[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37};
+            for (uint64_t a : bases) {
+                if (n % a == 0) return n == a;
+            }
+            ModArith::Barrett64 mod(n);
+            uint64_t d = n - 1;
+            int r = 0;
+            while ((d & 1) == 0) {
+                d >>= 1;
+                r++;
+            }
+            for (uint64_t a : bases) {
+                uint64_t x = ModArith::pow(mod, a, d);
+                if (x == 1 || x == n - 1) continue;
+                bool composite = true;
+                for (int i = 1; i < r; i++) {
+                    x = mod.mul(x, x);
+                    if (x == n - 1) {
+                        composite = false;
+                        break;
+                    }
+                }
+                if (composite) return false;
+            }
+            return true;
+        }
+    };
+
+    /**
+     * RLWE密文 (a, b)，b = -a·s + e + Δ·μ；两个分量均为NTT形式
+     */
+    struct Ciphertext {
+        Poly a;
+        Poly b;
+    };
+
+    /**
+     * RGSW密文：2ℓ行RLWE密文，前ℓ行在a分量、后ℓ行在b分量上加了 m·B^i
+     */
+    struct Rgsw {
+        std::vector<Ciphertext> rows;
+    };
+
+    struct SecretKey {
+        Poly s;  // NTT形式
+    };
+
+    /**
+     * 基于计数器模式PRG的采样器：每次采样使用新的流号
+     */
+    class Sampler {
+    public:
+        Sampler() : key_(Prg::random_key()) {}
+
+        void uniform(const Context& ctx, uint64_t* poly) {
+            for (size_t i = 0; i < ctx.num_primes(); i++) {
+                Prg::expand_mod(key_, next_stream_++, ctx.prime(i).p, poly + i * ctx.n(), ctx.n());
+            }
+        }
+
+        void ternary(int64_t* out, size_t n) {
+            Prg::Stream stream(key_, next_stream_++);
+            for (size_t k = 0; k < n; k++) {
+                uint64_t v;
+                do {
+                    v = stream.next() & 3;
+                } while (v == 3);
+                out[k] = static_cast<int64_t>(v) - 1;
+            }
+        }
+
+        /**
+         * 中心二项分布 CBD(21)：两组21位的汉明重量之差
+         */
+        void noise(int64_t* out, size_t n) {
+            Prg::Stream stream(key_, next_stream_++);
+            const uint64_t mask = (1ULL << 21) - 1;
+            for (size_t k = 0; k < n; k++) {
+                uint64_t w = stream.next();
+                out[k] = static_cast<int64_t>(__builtin_popcountll(w & mask)) -
+                         static_cast<int64_t>(__builtin_popcountll((w >> 21) & mask));
+            }
+        }
+
+    private:
+        Prg::Key key_;
+        uint64_t next_stream_ = 0;
+    };
+
+    static SecretKey keygen(const Context& ctx, Sampler& sampler) {
+        std::vector<int64_t> s(ctx.n());
+        sampler.ternary(s.data(), s.size());
+        SecretKey sk;
+        sk.s = ctx.zero_poly();
+        ctx.from_signed(s.data(), sk.s.data());
+        ctx.ntt(sk.s.data());
+        return sk;
+    }
+
+    /**
+     * 加密长度N的有符号明文系数（|μ_k| < t）
+     */
+    static Ciphertext encrypt(const Context& ctx, const SecretKey& sk, const int64_t* message,
+                              Sampler& sampler) {
+        const size_t n = ctx.n();
+        std::vector<int64_t> e(n);
+        sampler.noise(e.data(), n);
+
+        Ciphertext ct;
+        ct.a = ctx.zero_poly();
+        ct.b = ctx.zero_poly();
+        sampler.uniform(ctx, ct.a.data());
+
+        // b = e + Δ·μ（系数形式）
+        ctx.from_signed(e.data(), ct.b.data());
+        if (message != nullptr) {
+            for (size_t i = 0; i < ctx.num_primes(); i++) {
+                const NttPrime& P = ctx.prime(i);
+                uint64_t* b = ct.b.data() + i * n;
+                for (size_t k = 0; k < n; k++) {
+                    b[k] = P.add(b[k], P.mod.mul(ctx.delta_rns(i), P.from_signed(message[k])));
+                }
+            }
+        }
+        ctx.ntt(ct.b.data());
+
+        // b -= a·s（NTT域逐点）
+        for (size_t i = 0; i < ctx.num_primes(); i++) {
+            const NttPrime& P = ctx.prime(i);
+            for (size_t k = i * n; k < (i + 1) * n; k++) {
+                ct.b[k] = P.sub(ct.b[k], P.mod.mul(ct.a[k], sk.s[k]));
+            }
+        }
+        return ct;
+    }
+
+    /**
+     * 解密：返回长度N的明文系数（mod t）
+     */
+    static std::vector<uint64_t> decrypt(const Context& ctx, const SecretKey& sk,
+                                         const Ciphertext& ct) {
+        const size_t n = ctx.n();
+        Poly x = ct.b;
+        for (size_t i = 0; i < ctx.num_primes(); i++) {
+            const NttPrime& P = ctx.prime(i);
+            for (size_t k = i * n; k < (i + 1) * n; k++) {
+                x[k] = P.add(x[k], P.mod.mul(ct.a[k], sk.s[k]));
+            }
+        }
+        ctx.intt(x.data());
+
+        std::vector<uint64_t> message(n);
+        for (size_t k = 0; k < n; k++) {
+            message[k] = ctx.decode(ctx.crt(x.data(), k));
+        }
+        return message;
+    }
+
+    /**
+     * 只解密少数几个系数的解密器（PIR响应只需读取固定位置的系数）
+     *
+     * NTT形式下第i个分量是多项式在 ψ^(2·br(i)+1) 处的取值，于是系数k为
+     *   x_k = N^-1 Σ_i x̂_i · ψ^-(2·br(i)+1)·k = <b̂, r_k> + <â, ŝ ∘ r_k>  (mod p)
+     * 权重 r_k 与 ŝ ∘ r_k 对每个素数和每个待读系数预计算一次，
+     * 解密化为两个长度N的内积（SimdMod::dot52），不再需要完整的逆NTT。
+     */
+    class CoefficientDecryptor {
+    public:
+        CoefficientDecryptor(const Context& ctx, const SecretKey& sk, const std::vector<size_t>& coeffs)
+            : ctx_(ctx), coeffs_(coeffs) {
+            const size_t n = ctx.n();
+            size_t log_n = 0;
+            while ((size_t(1) << log_n) < n) log_n++;
+            weights_b_.resize(coeffs.size() * ctx.poly_words());
+            weights_a_.resize(coeffs.size() * ctx.poly_words());
+            for (size_t c = 0; c < coeffs.size(); c++) {
+                for (size_t p = 0; p < ctx.num_primes(); p++) {
+                    const NttPrime& P = ctx.prime(p);
+                    // ψ^-1 = ψ^(2N-1)；r_k[i] = N^-1 · (ψ^-1)^((2·br(i)+1)·k)
+                    uint64_t psi = P.psi_rev[1 << (log_n - 1)];  // psi_rev[br(1)] = ψ^1
+                    uint64_t psi_inv = ModArith::inverse(P.mod, psi);
+                    uint64_t base = ModArith::pow(P.mod, psi_inv, coeffs[c] % (2 * n));
+                    uint64_t* wb = weights_b_.data() + (c * ctx.num_primes() + p) * n;
+                    uint64_t* wa = weights_a_.data() + (c * ctx.num_primes() + p) * n;
+                    for (size_t i = 0; i < n; i++) {
+                        uint64_t e = 2 * bit_reverse(i, log_n) + 1;
+                        wb[i] = P.mod.mul(P.n_inv, ModArith::pow(P.mod, base, e));
+                        wa[i] = P.mod.mul(wb[i], sk.s[p * n + i]);
+                    }
+                }
+            }
+        }
+
+        /**
+         * out[c] = ct 解密后第 coeffs[c] 个系数（mod t）
+         */
+        void decrypt(const Ciphertext& ct, uint64_t* out) const {
+            const size_t n = ctx_.n();
+            const size_t K = ctx_.num_primes();
+            for (size_t c = 0; c < coeffs_.size(); c++) {
+                uint64_t residues[kNumPrimes];
+                for (size_t p = 0; p < K; p++) {
+                    const uint64_t* wb = weights_b_.data() + (c * K + p) * n;
+                    const uint64_t* wa = weights_a_.data() + (c * K + p) * n;
+                    u128 acc = SimdMod::dot52(ct.b.data() + p * n, wb, n);
+                    acc += SimdMod::dot52(ct.a.data() + p * n, wa, n);
+                    residues[p] = ctx_.prime(p).mod.reduce(acc);
+                }
+                out[c] = ctx_.decode(ctx_.crt(residues[0], residues[1]));
+            }
+        }
+
+    private:
+        const Context& ctx_;
+        std::vector<size_t> coeffs_;
+        std::vector<uint64_t> weights_b_;  // [系数][素数][i]
+        std::vector<uint64_t> weights_a_;
+
+        static size_t bit_reverse(size_t x, size_t bits) {
+            size_t r = 0;
+            for (size_t i = 0; i < bits; i++) {
+                r = (r << 1) | ((x >> i) & 1);
+            }
+            return r;
+        }
+    };
+
+    /**
+     * RGSW加密小整数 m（PIR中为选择比特0/1）
+     */
+    static Rgsw encrypt_rgsw(const Context& ctx, const SecretKey& sk, uint64_t m,
+                             Sampler& sampler) {
+        const size_t n = ctx.n();
+        const size_t ell = ctx.gadget_len();
+        Rgsw rgsw;
+        rgsw.rows.reserve(2 * ell);
+        for (size_t r = 0; r < 2 * ell; r++) {
+            rgsw.rows.push_back(encrypt(ctx, sk, nullptr, sampler));
+        }
+        if (m == 0) {
+            return rgsw;
+        }
+        // 常数多项式在NTT域中是所有位置上的同一个值
+        for (size_t g = 0; g < ell; g++) {
+            for (size_t i = 0; i < ctx.num_primes(); i++) {
+                const NttPrime& P = ctx.prime(i);
+                uint64_t gadget = static_cast<uint64_t>(
+                    (static_cast<u128>(m) << (g * kGadgetBits)) % P.p);
+                uint64_t* a = rgsw.rows[g].a.data() + i * n;
+                uint64_t* b = rgsw.rows[ell + g].b.data() + i * n;
+                for (size_t k = 0; k < n; k++) {
+                    a[k] = P.add(a[k], gadget);
+                    b[k] = P.add(b[k], gadget);
+                }
+            }
+        }
+        return rgsw;
+    }
+
+    /**
+     * 外积：out = RGSW ⊡ in
+     */
+    static Ciphertext external_product(const Context& ctx, const Rgsw& rgsw, const Ciphertext& in) {
+        const size_t n = ctx.n();
+        const size_t ell = ctx.gadget_len();
+        const size_t words = ctx.poly_words();
+        MFUPSI_SCOPE(ExternalProduct);
+        MFUPSI_COUNT(ExternalProduct, words,
+                     (2 * ell + 2) * 2 * words * sizeof(uint64_t),
+                     (2 + 2 * ell) * ctx.ntt_modmuls() + 2 * 2 * ell * words);
+        const uint64_t digit_mask = (1ULL << kGadgetBits) - 1;
+
+        // 分解：a、b 各得到ℓ个数字多项式（数字小于所有素数，各RNS分量相同）
+        Poly coeff_a = in.a;
+        Poly coeff_b = in.b;
+        ctx.intt(coeff_a.data());
+        ctx.intt(coeff_b.data());
+        std::vector<Poly> digits(2 * ell, Poly(words));
+        for (size_t k = 0; k < n; k++) {
+            u128 xa = ctx.crt(coeff_a.data(), k);
+            u128 xb = ctx.crt(coeff_b.data(), k);
+            for (size_t g = 0; g < ell; g++) {
+                uint64_t da = static_cast<uint64_t>(xa >> (g * kGadgetBits)) & digit_mask;
+                uint64_t db = static_cast<uint64_t>(xb >> (g * kGadgetBits)) & digit_mask;
+                for (size_t i = 0; i < ctx.num_primes(); i++) {
+                    digits[g][i * n + k] = da;
+                    digits[ell + g][i * n + k] = db;
+                }
+            }
+        }
+        for (auto& d : digits) {
+            ctx.ntt(d.data());
+        }
+
+        // 乘加：128位惰性累加，每个位置最后约减一次
+        Ciphertext out;
+        out.a.resize(words);
+        out.b.resize(words);
+        for (size_t i = 0; i < ctx.num_primes(); i++) {
+            const NttPrime& P = ctx.prime(i);
+            for (size_t k = i * n; k < (i + 1) * n; k++) {
+                u128 acc_a = 0, acc_b = 0;
+                for (size_t r = 0; r < 2 * ell; r++) {
+                    acc_a += static_cast<u128>(digits[r][k]) * rgsw.rows[r].a[k];
+                    acc_b += static_cast<u128>(digits[r][k]) * rgsw.rows[r].b[k];
+                }
+                out.a[k] = P.mod.reduce(acc_a);
+                out.b[k] = P.mod.reduce(acc_b);
+            }
+        }
+        return out;
+    }
+
+    /**
+     * CMux：bit = 0 时得到 c0，bit = 1 时得到 c1
+     */
+    static Ciphertext cmux(const Context& ctx, const Rgsw& bit, const Ciphertext& c0,
+                           const Ciphertext& c1) {
+        Ciphertext diff = c1;
+        sub_inplace(ctx, diff, c0);
+        Ciphertext out = external_product(ctx, bit, diff);
+        add_inplace(ctx, out, c0);
+        return out;
+    }
+
+    static Ciphertext zero_ciphertext(const Context& ctx) {
+        return Ciphertext{ctx.zero_poly(), ctx.zero_poly()};
+    }
+
+    static void add_inplace(const Context& ctx, Ciphertext& x, const Ciphertext& y) {
+        binary_inplace(ctx, x, y, [](const NttPrime& P, uint64_t a, uint64_t b) { return P.add(a, b); });
+    }
+
+    static void sub_inplace(const Context& ctx, Ciphertext& x, const Ciphertext& y) {
+        binary_inplace(ctx, x, y, [](const NttPrime& P, uint64_t a, uint64_t b) { return P.sub(a, b); });
+    }
+
+    /**
+     * 密文 × 明文多项式的惰性累加器：Σ_t ct_t ⊙ pt_t（NTT域），结束时一次约减
+     * 每项小于 2^(2·kPrimeBits)，128位累加器可容纳 2^(128 - 2·kPrimeBits) 项
+     */
+    class Accumulator {
+    public:
+        explicit Accumulator(const Context& ctx) : acc_a_(ctx.poly_words(), 0), acc_b_(ctx.poly_words(), 0) {}
+
+        void reset() {
+            std::fill(acc_a_.begin(), acc_a_.end(), 0);
+            std::fill(acc_b_.begin(), acc_b_.end(), 0);
+        }
+
+        void mac(const Ciphertext& ct, const uint64_t* pt) {
+            const size_t words = acc_a_.size();
+            for (size_t k = 0; k < words; k++) {
+                acc_a_[k] += static_cast<u128>(ct.a[k]) * pt[k];
+                acc_b_[k] += static_cast<u128>(ct.b[k]) * pt[k];
+            }
+        }
+
+        Ciphertext reduce(const Context& ctx) const {
+            const size_t n = ctx.n();
+            Ciphertext out{Poly(acc_a_.size()), Poly(acc_b_.size())};
+            for (size_t i = 0; i < ctx.num_primes(); i++) {
+                const NttPrime& P = ctx.prime(i);
+                for (size_t k = i * n; k < (i + 1) * n; k++) {
+                    out.a[k] = P.mod.reduce(acc_a_[k]);
+                    out.b[k] = P.mod.reduce(acc_b_[k]);
+                }
+            }
+            return out;
+        }
+
+    private:
+        std::vector<u128> acc_a_;
+        std::vector<u128> acc_b_;
+    };
+
+    /**
+     * 流式CMux折叠：从按顺序到达的密文流 c_0, c_1, ..., c_{L^D - 1} 中同态选出 c_m
+     *
+     * m 按L进制视为D位数字（最高位在前），每一位由其各比特的RGSW密文选择：
+     *   - 每一位对应一棵二叉CMux树，树的第l层以该位的第l比特为选择位，
+     *     不足2的幂时用零密文补齐
+     *   - 最低位的树每收满L个输入产生一个输出，作为上一位树的输入
+     * 每层只保留一个待配对的密文，内存为 O(D·log L) 个密文，与 L^D 无关。
+     *
+     * 只折叠 [first_digit, last_digit) 这几位时，输入流为这些位组成的子立方体：
+     * 可以把各最高位取值对应的子流分别折叠，再用最高位折叠这些子结果。
+     */
+    class Folder {
+    public:
+        /**
+         * digit_bits[d] 为第d位（最高位在前）的比特RGSW密文，低比特在前
+         */
+        Folder(const Context& ctx, const std::vector<std::vector<Rgsw>>& digit_bits, size_t L,
+               size_t first_digit = 0, size_t last_digit = SIZE_MAX)
+            : ctx_(ctx), digit_bits_(digit_bits), L_(L), first_digit_(first_digit),
+              trees_(std::min(last_digit, digit_bits.size()) - first_digit) {
+            for (size_t d = 0; d < trees_.size(); d++) {
+                trees_[d].pending.resize(digit_bits[first_digit_ + d].size());
+                trees_[d].has_pending.assign(digit_bits[first_digit_ + d].size(), false);
+            }
+        }
+
+        void push(Ciphertext ct) {
+            if (trees_.empty()) {
+                result_ = std::move(ct);
+                return;
+            }
+            push_digit(trees_.size() - 1, std::move(ct));
+        }
+
+        /**
+         * 所有 L^D 个输入到达后的选择结果
+         */
+        const Ciphertext& result() const { return result_; }
+
+    private:
+        struct Tree {
+            std::vector<Ciphertext> pending;  // 每层等待配对的左孩子
+            std::vector<bool> has_pending;
+            size_t count = 0;                 // 本轮已输入的叶子数（含补齐）
+        };
+
+        const Context& ctx_;
+        const std::vector<std::vector<Rgsw>>& digit_bits_;
+        size_t L_;
+        size_t first_digit_;
+        std::vector<Tree> trees_;
+        Ciphertext result_;
+
+        void push_digit(size_t d, Ciphertext ct) {
+            Tree& tree = trees_[d];
+            const size_t leaves = size_t(1) << tree.pending.size();
+
+            insert_leaf(d, std::move(ct));
+            if (tree.count == L_) {
+                for (size_t pad = L_; pad < leaves; pad++) {
+                    insert_leaf(d, zero_ciphertext(ctx_));
+                }
+            }
+        }
+
+        void insert_leaf(size_t d, Ciphertext ct) {
+            Tree& tree = trees_[d];
+            tree.count++;
+            for (size_t l = 0; l < tree.pending.size(); l++) {
+                if (!tree.has_pending[l]) {
+                    tree.pending[l] = std::move(ct);
+                    tree.has_pending[l] = true;
+                    return;
+                }
+                ct = cmux(ctx_, digit_bits_[first_digit_ + d][l], tree.pending[l], ct);
+                tree.has_pending[l] = false;
+            }
+            // 整棵树完成：输出交给上一位
+            tree.count = 0;
+            if (d == 0) {
+                result_ = std::move(ct);
+            } else {
+                push_digit(d - 1, std::move(ct));
+            }
+        }
+    };
+
+    /**
+     * 序列化字节数：每个RNS残差按8字节计
+     */
+    static size_t ciphertext_bytes(const Context& ctx) {
+        return 2 * ctx.poly_words() * sizeof(uint64_t);
+    }
+
+    static size_t rgsw_bytes(const Context& ctx) {
+        return 2 * ctx.gadget_len() * ciphertext_bytes(ctx);
+    }
+
+private:
+    template <typename Op>
+    static void binary_inplace(const Context& ctx, Ciphertext& x, const Ciphertext& y, Op op) {
+        const size_t n = ctx.n();
+        for (size_t i = 0; i < ctx.num_primes(); i++) {
+            const NttPrime& P = ctx.prime(i);
+            for (size_t k = i * n; k < (i + 1) * n; k++) {
+                x.a[k] = op(P, x.a[k], y.a[k]);
+                x.b[k] = op(P, x.b[k], y.b[k]);
+            }
+        }
+    }
+};
+
+#endif // RLWE_H
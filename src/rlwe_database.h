@@ -0,0 +1,119 @@
+#ifndef RLWE_DATABASE_H
+#define RLWE_DATABASE_H
+
+#include "dense_matrix.h"
+#include "rlwe.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+/**
+ * RLWE PIR数据库：E_total 预处理为NTT形式的明文多项式，供查询直接做逐点乘加
+ *
+ * 明文打包：每个元素拆成 num_limbs 个16位limb，每个多项式容纳 limbs_per_poly 个limb，
+ * 第c列的第g组为 P_(c,g)(X) = Σ_l X^(l·d_1) Σ_i limb_(g·lpp + l)(E[i, c]) X^i。
+ *
+ * 布局按超立方体坐标：列 c = t·H + m（t = idx_1，m 为其余坐标组成的数，H = L^(z-1)），
+ * 槽位 (m·L + t)·G + g。服务器处理第m个第一维输出时读取的 L×G 个多项式连续存放。
+ * 超出b的槽位保持为零多项式。
+ *
+ * 预处理在Setup聚合后整体完成，Update只重新变换被修改的列，
+ * 查询不再承担任何编码或NTT开销。
+ */
+
+class RlweDatabase {
+public:
+    static constexpr size_t kLimbBits = 16;
+
+    /**
+     * 明文打包参数（客户端解码响应时使用同一组参数）
+     */
+    struct Packing {
+        size_t num_limbs = 0;       // 每个Z_q元素的limb数
+        size_t limbs_per_poly = 0;  // 每个多项式容纳的limb数
+        size_t num_groups = 0;      // 每列的多项式数
+
+        static Packing create(uint64_t modulus, size_t ring_dimension, size_t rows) {
+            size_t q_bits = 0;
+            while (q_bits < 64 && ((modulus - 1) >> q_bits) != 0) q_bits++;
+            Packing packing;
+            packing.num_limbs = (q_bits + kLimbBits - 1) / kLimbBits;
+            packing.limbs_per_poly = std::min(packing.num_limbs, ring_dimension / rows);
+            packing.num_groups = (packing.num_limbs + packing.limbs_per_poly - 1) / packing.limbs_per_poly;
+            return packing;
+        }
+    };
+
+    RlweDatabase() = default;
+
+    /**
+     * 对 E（d_1 × b）的所有列做编码与NTT；L为每维大小，H = L^(z-1)
+     */
+    void build(const Rlwe::Context& ctx, const Packing& packing, const DenseMatrix& E,
+               size_t L, size_t H, ThreadPool& pool) {
+        ctx_ = &ctx;
+        packing_ = packing;
+        rows_ = E.rows();
+        cols_ = E.cols();
+        L_ = L;
+        H_ = H;
+        words_ = ctx.poly_words();
+        data_.assign(L_ * H_ * packing_.num_groups * words_, 0);
+        pool.parallel_for(cols_, [&](size_t c) {
+            update_col(c, E);
+        });
+    }
+
+    /**
+     * 重新编码并变换第c列（Update只需调用被修改的列）
+     */
+    void update_col(size_t c, const DenseMatrix& E) {
+        const size_t n = ctx_->n();
+        const uint64_t limb_mask = (1ULL << kLimbBits) - 1;
+        auto column = E.col(c);
+        for (size_t g = 0; g < packing_.num_groups; g++) {
+            uint64_t* poly = slot(c / H_, c % H_, g);
+            std::fill_n(poly, words_, 0);
+            for (size_t l = 0; l < packing_.limbs_per_poly; l++) {
+                size_t limb = g * packing_.limbs_per_poly + l;
+                if (limb >= packing_.num_limbs) break;
+                for (size_t i = 0; i < rows_; i++) {
+                    poly[l * rows_ + i] = (column[i] >> (limb * kLimbBits)) & limb_mask;
+                }
+            }
+            // limb小于所有RNS素数，各分量的系数相同
+            for (size_t p = 1; p < ctx_->num_primes(); p++) {
+                std::copy_n(poly, n, poly + p * n);
+            }
+            ctx_->ntt(poly);
+        }
+    }
+
+    const Packing& packing() const { return packing_; }
+    size_t cols() const { return cols_; }
+
+    /**
+     * 第一维坐标 t、其余坐标 m 处的列的第g组明文（NTT形式）
+     */
+    const uint64_t* plaintext(size_t t, size_t m, size_t g) const {
+        return data_.data() + ((m * L_ + t) * packing_.num_groups + g) * words_;
+    }
+
+private:
+    const Rlwe::Context* ctx_ = nullptr;
+    Packing packing_;
+    size_t rows_ = 0;
+    size_t cols_ = 0;
+    size_t L_ = 1;
+    size_t H_ = 1;
+    size_t words_ = 0;
+    std::vector<uint64_t> data_;
+
+    uint64_t* slot(size_t t, size_t m, size_t g) {
+        return data_.data() + ((m * L_ + t) * packing_.num_groups + g) * words_;
+    }
+};
+
+#endif // RLWE_DATABASE_H
@@ -0,0 +1,82 @@
+#ifndef SHARD_MAP_H
+#define SHARD_MAP_H
+
+#include "hypercube.h"
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * 服务器分片：E_total 的列（分区）按第一维超立方体坐标划分到 S 个分片
+ *
+ * 列 c = t·H + m（t = idx_1，H = L^(z-1)），分片s持有第一维坐标 t ∈ [first_row, last_row)，
+ * 即连续的列区间 [first_row·H, min(last_row·H, b))，每个分片内仍包含全部 m。
+ * 只有前 ceil(b/H) 个第一维坐标对应非空的列，它们被均分到各分片。
+ *
+ * PIR的各维折叠对第一维累加结果是线性的（CMux(b, x0, x1) = x0 + b ⊡ (x1 - x0)），
+ * 因此每个分片只用自己的行独立完成整个查询，全部分片的响应相加即为完整响应：
+ *   - RLWE：各分片响应密文逐组相加（噪声随分片数线性增长）
+ *   - 明文：各分片只填写自己的第一维坐标，其余为0，逐元素模q相加
+ */
+
+class ShardMap {
+public:
+    /**
+     * 一个分片持有的第一维坐标与列区间
+     */
+    struct Range {
+        size_t first_row = 0;
+        size_t last_row = 0;
+        size_t first_col = 0;
+        size_t last_col = 0;
+
+        size_t rows() const { return last_row - first_row; }
+        size_t cols() const { return last_col - first_col; }
+        bool contains(size_t j) const { return j >= first_col && j < last_col; }
+    };
+
+    ShardMap() = default;
+
+    ShardMap(const Hypercube& hypercube, size_t num_partitions, size_t num_shards) {
+        const size_t H = hypercube.inner_size();
+        const size_t used_rows = (num_partitions + H - 1) / H;
+        if (num_shards == 0 || num_shards > std::max<size_t>(used_rows, 1)) {
+            throw std::invalid_argument("number of shards must be in [1, " +
+                                        std::to_string(std::max<size_t>(used_rows, 1)) + "]");
+        }
+        ranges_.resize(num_shards);
+        for (size_t s = 0; s < num_shards; s++) {
+            Range& r = ranges_[s];
+            r.first_row = s * used_rows / num_shards;
+            r.last_row = (s + 1) * used_rows / num_shards;
+            r.first_col = std::min(r.first_row * H, num_partitions);
+            r.last_col = std::min(r.last_row * H, num_partitions);
+        }
+        // 单个分片持有整个超立方体（包括超出b的第一维坐标），与不分片时的布局一致
+        if (num_shards == 1) {
+            ranges_[0].last_row = hypercube.side();
+        }
+        H_ = H;
+    }
+
+    size_t num_shards() const { return ranges_.size(); }
+    const Range& range(size_t s) const { return ranges_.at(s); }
+
+    /**
+     * 分区j所在的分片：第一个 last_row 大于 j 的第一维坐标的分片
+     */
+    size_t shard_of(size_t j) const {
+        const size_t t = j / H_;
+        auto it = std::upper_bound(ranges_.begin(), ranges_.end(), t,
+                                   [](size_t row, const Range& r) { return row < r.last_row; });
+        return std::min(static_cast<size_t>(it - ranges_.begin()), ranges_.size() - 1);
+    }
+
+private:
+    std::vector<Range> ranges_{Range{}};
+    size_t H_ = 1;
+};
+
+#endif // SHARD_MAP_H
@@ -0,0 +1,205 @@
+#ifndef SIMD_MOD_H
+#define SIMD_MOD_H
+
+#include "modarith.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+/**
+ * 向量化的逐元素Z_q累加核（服务器聚合的热点）
+ *
+ * 两类核：
+ *   - wide:   任意 q < 2^64。s = a + b 可能溢出64位，
+ *             溢出或 s >= q 时减去q（按2^64取模的减法对两种情况都成立）
+ *   - narrow: q = 2^32 - C，元素小于2^32。多路求和时在64位通道内直接累加
+ *             （最多2^32路不会溢出），最后用伪梅森折叠一次性约减
+ *
+ * 另有52位元素的精确内积核（RLWE解密），有 AVX-512 IFMA 时使用 vpmadd52。
+ *
+ * 编译时按 __AVX512F__ / __AVX2__ 选择指令集（CMake使用 -march=native），
+ * 否则退化为标量循环；尾部元素总是走标量路径。
+ */
+
+class SimdMod {
+public:
+    /**
+     * dst[i] = (dst[i] + src[i]) mod q，按模运算策略选择核
+     */
+    template <typename Mod>
+    static void add_inplace(uint64_t* dst, const uint64_t* src, size_t n, const Mod& mod) {
+        const uint64_t* srcs[1] = {src};
+        accumulate(dst, srcs, 1, n, mod);
+    }
+
+    /**
+     * dst[i] = (dst[i] + Σ_k srcs[k][i]) mod q
+     * 单次遍历：每个dst块只读写一次，所有源在寄存器中累加
+     */
+    template <typename Mod>
+    static void accumulate(uint64_t* dst, const uint64_t* const* srcs, size_t k, size_t n,
+                           const Mod& mod) {
+        if (k == 0) return;
+        if constexpr (is_mersenne32<Mod>::value) {
+            accumulate_narrow<is_mersenne32<Mod>::C>(dst, srcs, k, n);
+        } else {
+            accumulate_wide(dst, srcs, k, n, mod.modulus());
+        }
+    }
+
+    /**
+     * 任意 q < 2^64 的多路累加
+     */
+    static void accumulate_wide(uint64_t* dst, const uint64_t* const* srcs, size_t k, size_t n,
+                                uint64_t q) {
+        size_t i = 0;
+#if defined(__AVX512F__)
+        const __m512i vq = _mm512_set1_epi64(static_cast<long long>(q));
+        for (; i + 8 <= n; i += 8) {
+            __m512i acc = _mm512_loadu_si512(dst + i);
+            for (size_t s = 0; s < k; s++) {
+                __m512i b = _mm512_loadu_si512(srcs[s] + i);
+                __m512i sum = _mm512_add_epi64(acc, b);
+                __mmask8 wrap = _mm512_cmplt_epu64_mask(sum, acc) | _mm512_cmpge_epu64_mask(sum, vq);
+                acc = _mm512_mask_sub_epi64(sum, wrap, sum, vq);
+            }
+            _mm512_storeu_si512(dst + i, acc);
+        }
+#elif defined(__AVX2__)
+        const __m256i vq = _mm256_set1_epi64x(static_cast<long long>(q));
+        const __m256i sign = _mm256_set1_epi64x(static_cast<long long>(0x8000000000000000ULL));
+        const __m256i vq_s = _mm256_xor_si256(vq, sign);
+        for (; i + 4 <= n; i += 4) {
+            __m256i acc = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+            for (size_t s = 0; s < k; s++) {
+                __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(srcs[s] + i));
+                __m256i sum = _mm256_add_epi64(acc, b);
+                __m256i sum_s = _mm256_xor_si256(sum, sign);
+                // 无符号比较：异或符号位后做有符号比较
+                __m256i carry = _mm256_cmpgt_epi64(_mm256_xor_si256(acc, sign), sum_s);
+                __m256i below_q = _mm256_cmpgt_epi64(vq_s, sum_s);
+                __m256i wrap = _mm256_or_si256(carry, _mm256_andnot_si256(below_q, _mm256_set1_epi64x(-1)));
+                acc = _mm256_sub_epi64(sum, _mm256_and_si256(wrap, vq));
+            }
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), acc);
+        }
+#endif
+        for (; i < n; i++) {
+            uint64_t acc = dst[i];
+            for (size_t s = 0; s < k; s++) {
+                uint64_t sum = acc + srcs[s][i];
+                bool wrap = (sum < acc) | (sum >= q);
+                acc = wrap ? sum - q : sum;
+            }
+            dst[i] = acc;
+        }
+    }
+
+    /**
+     * q = 2^32 - C 的多路累加：64位通道内惰性求和，最后统一折叠约减
+     */
+    template <uint64_t C>
+    static void accumulate_narrow(uint64_t* dst, const uint64_t* const* srcs, size_t k, size_t n) {
+        constexpr uint64_t q = (1ULL << 32) - C;
+        size_t i = 0;
+#if defined(__AVX512F__)
+        const __m512i vq = _mm512_set1_epi64(static_cast<long long>(q));
+        const __m512i vc = _mm512_set1_epi64(static_cast<long long>(C));
+        const __m512i lo_mask = _mm512_set1_epi64(0xFFFFFFFFLL);
+        for (; i + 8 <= n; i += 8) {
+            __m512i acc = _mm512_loadu_si512(dst + i);
+            for (size_t s = 0; s < k; s++) {
+                acc = _mm512_add_epi64(acc, _mm512_loadu_si512(srcs[s] + i));
+            }
+            // x = (x >> 32) * C + (x & 0xFFFFFFFF)，两次折叠后小于 q + C^2
+            for (int f = 0; f < 2; f++) {
+                acc = _mm512_add_epi64(_mm512_mul_epu32(_mm512_srli_epi64(acc, 32), vc),
+                                       _mm512_and_si512(acc, lo_mask));
+            }
+            __mmask8 ge = _mm512_cmpge_epu64_mask(acc, vq);
+            acc = _mm512_mask_sub_epi64(acc, ge, acc, vq);
+            _mm512_storeu_si512(dst + i, acc);
+        }
+#elif defined(__AVX2__)
+        // 元素小于2^33，可直接用有符号比较
+        const __m256i vq = _mm256_set1_epi64x(static_cast<long long>(q));
+        const __m256i vq_minus1 = _mm256_set1_epi64x(static_cast<long long>(q - 1));
+        const __m256i vc = _mm256_set1_epi64x(static_cast<long long>(C));
+        const __m256i lo_mask = _mm256_set1_epi64x(0xFFFFFFFFLL);
+        for (; i + 4 <= n; i += 4) {
+            __m256i acc = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+            for (size_t s = 0; s < k; s++) {
+                acc = _mm256_add_epi64(acc, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(srcs[s] + i)));
+            }
+            for (int f = 0; f < 2; f++) {
+                acc = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(acc, 32), vc),
+                                       _mm256_and_si256(acc, lo_mask));
+            }
+            __m256i ge = _mm256_cmpgt_epi64(acc, vq_minus1);
+            acc = _mm256_sub_epi64(acc, _mm256_and_si256(ge, vq));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), acc);
+        }
+#endif
+        for (; i < n; i++) {
+            uint64_t acc = dst[i];
+            for (size_t s = 0; s < k; s++) {
+                acc += srcs[s][i];
+            }
+            acc = (acc >> 32) * C + (acc & 0xFFFFFFFFULL);
+            acc = (acc >> 32) * C + (acc & 0xFFFFFFFFULL);
+            dst[i] = (acc >= q) ? acc - q : acc;
+        }
+    }
+
+    /**
+     * 52位以内元素的精确内积 Σ a[i]·b[i]（128位结果，调用方最后一次性约减）
+     *
+     * AVX-512 IFMA 下 vpmadd52lo/hi 一次完成8个52×52位乘积低、高52位的累加：
+     * 每个通道的两个累加器每步增加不足2^52，每 2^12 步合并到128位和一次，不会溢出。
+     */
+    static ModArith::u128 dot52(const uint64_t* a, const uint64_t* b, size_t n) {
+        ModArith::u128 sum = 0;
+        size_t i = 0;
+#if defined(__AVX512IFMA__)
+        constexpr size_t kFlush = 8 << 12;
+        while (i + 8 <= n) {
+            __m512i lo = _mm512_setzero_si512();
+            __m512i hi = _mm512_setzero_si512();
+            size_t end = std::min(n - n % 8, i + kFlush);
+            for (; i < end; i += 8) {
+                __m512i va = _mm512_loadu_si512(a + i);
+                __m512i vb = _mm512_loadu_si512(b + i);
+                lo = _mm512_madd52lo_epu64(lo, va, vb);
+                hi = _mm512_madd52hi_epu64(hi, va, vb);
+            }
+            alignas(64) uint64_t lo_lanes[8], hi_lanes[8];
+            _mm512_store_si512(lo_lanes, lo);
+            _mm512_store_si512(hi_lanes, hi);
+            for (int l = 0; l < 8; l++) {
+                sum += lo_lanes[l];
+                sum += static_cast<ModArith::u128>(hi_lanes[l]) << 52;
+            }
+        }
+#endif
+        for (; i < n; i++) {
+            sum += static_cast<ModArith::u128>(a[i]) * b[i];
+        }
+        return sum;
+    }
+
+private:
+    template <typename Mod>
+    struct is_mersenne32 : std::false_type {};
+
+    template <uint64_t C_>
+    struct is_mersenne32<ModArith::PseudoMersenne32<C_>> : std::true_type {
+        static constexpr uint64_t C = C_;
+    };
+};
+
+#endif // SIMD_MOD_H
@@ -0,0 +1,204 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * 工作窃取线程池（用于并行的分区编码等相互独立的任务）
+ *
+ * parallel_for(n, fn) 将 [0, n) 均分给各工作线程的本地队列：
+ *   - 线程从自己队列的头部逐个取任务
+ *   - 本地队列为空时，从其他线程队列的尾部窃取一半剩余任务
+ * 分区大小受哈希影响并不均匀，窃取保证先完成的线程能分担慢线程的工作。
+ *
+ * 调用线程本身也作为0号工作线程参与执行；num_threads = 1 时退化为顺序循环。
+ * 多个线程同时调用 parallel_for 时按提交顺序依次执行（不可在任务内部嵌套调用）。
+ */
+
+class ThreadPool {
+public:
+    /**
+     * num_threads = 0 表示使用全部硬件线程
+     */
+    explicit ThreadPool(size_t num_threads) {
+        if (num_threads == 0) {
+            num_threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+        }
+        queues_.resize(num_threads);
+        for (auto& q : queues_) {
+            q = std::make_unique<WorkQueue>();
+        }
+        for (size_t id = 1; id < num_threads; id++) {
+            workers_.emplace_back([this, id] { worker_loop(id); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        job_cv_.notify_all();
+        for (auto& t : workers_) {
+            t.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const { return queues_.size(); }
+
+    /**
+     * 并行执行 fn(i), i ∈ [0, n)，阻塞直到全部完成
+     * fn 抛出的第一个异常会在调用线程中重新抛出
+     */
+    template <typename F>
+    void parallel_for(size_t n, F&& fn) {
+        if (n == 0) return;
+        if (size() == 1 || n == 1) {
+            for (size_t i = 0; i < n; i++) {
+                fn(i);
+            }
+            return;
+        }
+
+        std::lock_guard<std::mutex> submit(submit_mutex_);
+        std::function<void(size_t)> task(std::forward<F>(fn));
+        size_t generation;
+        {
+            // 先发布任务与计数再填充队列：队列中的下标一旦可见，对应批次的 task_ 与 pending_ 已就绪
+            std::lock_guard<std::mutex> lock(mutex_);
+            task_ = &task;
+            pending_.store(n);
+            error_ = nullptr;
+            generation = ++generation_;
+            const size_t T = size();
+            for (size_t id = 0; id < T; id++) {
+                std::lock_guard<std::mutex> qlock(queues_[id]->mutex);
+                queues_[id]->generation = generation;
+                queues_[id]->begin = n * id / T;
+                queues_[id]->end = n * (id + 1) / T;
+            }
+        }
+        job_cv_.notify_all();
+
+        run_tasks(0, generation, &task);
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_cv_.wait(lock, [this] { return pending_.load() == 0 && active_ == 0; });
+        task_ = nullptr;
+        if (error_) {
+            std::rethrow_exception(error_);
+        }
+    }
+
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        size_t generation = 0;  // [begin, end) 所属的批次
+        size_t begin = 0;
+        size_t end = 0;
+    };
+
+    std::vector<std::unique_ptr<WorkQueue>> queues_;
+    std::vector<std::thread> workers_;
+
+    std::mutex submit_mutex_;  // 串行化来自不同线程的 parallel_for
+    std::mutex mutex_;
+    std::condition_variable job_cv_;
+    std::condition_variable done_cv_;
+    std::function<void(size_t)>* task_ = nullptr;
+    std::atomic<size_t> pending_{0};
+    size_t active_ = 0;        // 正在执行当前任务批次的后台线程数
+    size_t generation_ = 0;
+    bool stopping_ = false;
+    std::exception_ptr error_;
+
+    void worker_loop(size_t id) {
+        size_t seen = 0;
+        while (true) {
+            std::function<void(size_t)>* task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                job_cv_.wait(lock, [&] { return stopping_ || generation_ != seen; });
+                if (stopping_) return;
+                seen = generation_;
+                task = task_;
+                active_++;
+            }
+            run_tasks(id, seen, task);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                active_--;
+            }
+            done_cv_.notify_all();
+        }
+    }
+
+    /**
+     * 执行本地任务，本地队列耗尽后尝试窃取，直到所有队列都为空
+     * 只取属于 generation 批次的下标：迟醒的线程不会取走下一批次的任务
+     */
+    void run_tasks(size_t id, size_t generation, std::function<void(size_t)>* task) {
+        size_t i;
+        while (pop_local(id, generation, i) || steal(id, generation, i)) {
+            try {
+                (*task)(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!error_) error_ = std::current_exception();
+            }
+            if (pending_.fetch_sub(1) == 1) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                done_cv_.notify_all();
+            }
+        }
+    }
+
+    bool pop_local(size_t id, size_t generation, size_t& i) {
+        WorkQueue& q = *queues_[id];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (q.generation != generation || q.begin >= q.end) return false;
+        i = q.begin++;
+        return true;
+    }
+
+    /**
+     * 从其他队列尾部窃取一半任务放入本地队列，并立即取出第一个
+     */
+    bool steal(size_t id, size_t generation, size_t& i) {
+        const size_t T = size();
+        for (size_t k = 1; k < T; k++) {
+            WorkQueue& victim = *queues_[(id + k) % T];
+            size_t lo, hi;
+            {
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                if (victim.generation != generation || victim.begin >= victim.end) continue;
+                size_t remaining = victim.end - victim.begin;
+                hi = victim.end;
+                lo = hi - (remaining + 1) / 2;
+                victim.end = lo;
+            }
+            WorkQueue& own = *queues_[id];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            i = lo;
+            own.generation = generation;
+            own.begin = lo + 1;
+            own.end = hi;
+            return true;
+        }
+        return false;
+    }
+};
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,332 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+/**
+ * 客户端进程与服务器进程之间的分帧二进制传输（TCP）
+ *
+ * 每帧为 32 字节的 FrameHeader 加 payload_bytes 字节的负载（小端，本机字节序）：
+ *   [0, 4)    magic "MFUF"
+ *   [4, 6)    协议版本
+ *   [6, 8)    帧类型（FrameType）
+ *   [8, 12)   客户端编号（或首个客户端编号）
+ *   [12, 16)  条目数（列数 / 查询数 / 托管的客户端数）
+ *   [16, 24)  参数（起始列 / 服务器耗时纳秒等，由帧类型决定）
+ *   [24, 32)  负载字节数
+ * 负载以分散/聚集方式收发：发送方把帧头与各缓冲区（矩阵列块、密文多项式）
+ * 组成 iovec 列表一次 sendmsg，接收方按同样的布局 readv 直接写入目标缓冲区，
+ * 两端都不做序列化拷贝。元素按内存中的64位字发送。
+ */
+
+class Transport {
+public:
+    static constexpr uint32_t kMagic = 0x4655464D;  // "MFUF"
+    static constexpr uint16_t kVersion = 1;
+
+    enum class FrameType : uint16_t {
+        Hello = 1,          // 客户端 -> 服务器：托管的客户端范围与配置指纹
+        SetupChunk,         // 客户端 -> 服务器：Ẽ_i 的一个上传分块
+        SetupDone,          // 客户端 -> 服务器：本进程的全部上传分块已发送
+        UpdateColumns,      // 客户端 -> 服务器：一个客户端的稀疏列更新
+        UpdateDone,         // 客户端 -> 服务器：本进程的全部更新已发送
+        Ack,                // 服务器 -> 客户端：阶段完成，参数为服务器耗时（纳秒）
+        QueryBatch,         // 客户端 -> 服务器：一批PIR查询
+        ResponseBatch,      // 服务器 -> 客户端：一批PIR响应，参数为服务器耗时（纳秒）
+        QueryDone           // 客户端 -> 服务器：本进程不再发送查询
+    };
+
+    struct FrameHeader {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t type;
+        uint32_t client_id;
+        uint32_t count;
+        uint64_t arg;
+        uint64_t payload_bytes;
+    };
+    static_assert(sizeof(FrameHeader) == 32, "frame header must stay 32 bytes");
+
+    /**
+     * 负载的分散/聚集描述：依次引用的缓冲区
+     */
+    class Segments {
+    public:
+        void add(const void* data, size_t bytes) {
+            if (bytes == 0) return;
+            iov_.push_back({const_cast<void*>(data), bytes});
+            bytes_ += bytes;
+        }
+
+        size_t bytes() const { return bytes_; }
+        const std::vector<iovec>& iov() const { return iov_; }
+
+    private:
+        std::vector<iovec> iov_;
+        size_t bytes_ = 0;
+    };
+
+    /**
+     * 一条TCP连接（独占文件描述符，可移动不可复制），累计收发的字节数
+     */
+    class Connection {
+    public:
+        Connection() = default;
+        explicit Connection(int fd) : fd_(fd) {
+            int one = 1;
+            setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        }
+        ~Connection() { close(); }
+
+        Connection(Connection&& other) noexcept { *this = std::move(other); }
+        Connection& operator=(Connection&& other) noexcept {
+            if (this != &other) {
+                close();
+                std::swap(fd_, other.fd_);
+                bytes_sent_ = other.bytes_sent_;
+                bytes_received_ = other.bytes_received_;
+            }
+            return *this;
+        }
+        Connection(const Connection&) = delete;
+        Connection& operator=(const Connection&) = delete;
+
+        bool is_open() const { return fd_ >= 0; }
+        size_t bytes_sent() const { return bytes_sent_; }
+        size_t bytes_received() const { return bytes_received_; }
+
+        /**
+         * 发送一帧：帧头与负载各段在同一次 sendmsg 中发出（部分写入时继续发送剩余部分）
+         */
+        void send(FrameType type, uint32_t client_id, uint32_t count, uint64_t arg,
+                  const Segments& payload) {
+            FrameHeader header{kMagic, kVersion, static_cast<uint16_t>(type), client_id, count, arg,
+                               payload.bytes()};
+            std::vector<iovec> iov;
+            iov.reserve(payload.iov().size() + 1);
+            iov.push_back({&header, sizeof(header)});
+            iov.insert(iov.end(), payload.iov().begin(), payload.iov().end());
+            transfer(iov, true);
+            bytes_sent_ += sizeof(header) + payload.bytes();
+        }
+
+        /**
+         * 发送无负载的控制帧
+         */
+        void send(FrameType type, uint32_t client_id, uint32_t count, uint64_t arg) {
+            send(type, client_id, count, arg, Segments());
+        }
+
+        /**
+         * 接收下一帧的帧头；连接被关闭或帧头非法时抛出异常
+         */
+        FrameHeader receive_header() {
+            FrameHeader header;
+            std::vector<iovec> iov{{&header, sizeof(header)}};
+            transfer(iov, false);
+            bytes_received_ += sizeof(header);
+            if (header.magic != kMagic || header.version != kVersion) {
+                throw std::runtime_error("malformed frame header");
+            }
+            return header;
+        }
+
+        /**
+         * 接收指定类型的帧头，类型不符时抛出异常
+         */
+        FrameHeader expect(FrameType type) {
+            FrameHeader header = receive_header();
+            if (header.type != static_cast<uint16_t>(type)) {
+                throw std::runtime_error("unexpected frame type " + std::to_string(header.type) +
+                                         " (expected " + std::to_string(static_cast<uint16_t>(type)) + ")");
+            }
+            return header;
+        }
+
+        /**
+         * 将帧负载直接读入 into 描述的缓冲区，其总长度必须等于帧头中的负载字节数
+         */
+        void receive_payload(const FrameHeader& header, const Segments& into) {
+            if (into.bytes() != header.payload_bytes) {
+                throw std::runtime_error("frame payload is " + std::to_string(header.payload_bytes) +
+                                         " bytes, expected " + std::to_string(into.bytes()));
+            }
+            std::vector<iovec> iov = into.iov();
+            transfer(iov, false);
+            bytes_received_ += into.bytes();
+        }
+
+        void close() {
+            if (fd_ >= 0) {
+                ::close(fd_);
+                fd_ = -1;
+            }
+        }
+
+    private:
+        int fd_ = -1;
+        size_t bytes_sent_ = 0;
+        size_t bytes_received_ = 0;
+
+        /**
+         * 收发 iov 描述的全部字节；每次最多提交 IOV_MAX 段，按实际传输的字节数推进
+         */
+        void transfer(std::vector<iovec>& iov, bool sending) {
+            size_t i = 0;
+            while (i < iov.size()) {
+                int segments = static_cast<int>(std::min<size_t>(iov.size() - i, IOV_MAX));
+                ssize_t n;
+                if (sending) {
+                    msghdr msg{};
+                    msg.msg_iov = &iov[i];
+                    msg.msg_iovlen = segments;
+                    n = ::sendmsg(fd_, &msg, MSG_NOSIGNAL);
+                } else {
+                    n = ::readv(fd_, &iov[i], segments);
+                }
+                if (n < 0) {
+                    if (errno == EINTR) continue;
+                    throw std::runtime_error(std::string(sending ? "send" : "receive") + " failed: " +
+                                             std::strerror(errno));
+                }
+                if (n == 0 && !sending) {
+                    throw std::runtime_error("connection closed by peer");
+                }
+                size_t done = static_cast<size_t>(n);
+                while (i < iov.size() && done >= iov[i].iov_len) {
+                    done -= iov[i].iov_len;
+                    i++;
+                }
+                if (done > 0) {
+                    iov[i].iov_base = static_cast<char*>(iov[i].iov_base) + done;
+                    iov[i].iov_len -= done;
+                }
+            }
+        }
+    };
+
+    /**
+     * 监听套接字（服务器进程）；port 为0时由系统分配端口
+     */
+    class Listener {
+    public:
+        explicit Listener(uint16_t port) {
+            fd_ = ::socket(AF_INET6, SOCK_STREAM, 0);
+            if (fd_ < 0) {
+                throw std::runtime_error(std::string("cannot create socket: ") + std::strerror(errno));
+            }
+            int one = 1, zero = 0;
+            setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            setsockopt(fd_, IPPROTO_IPV6, IPV6_V6ONLY, &zero, sizeof(zero));  // 同时接受IPv4
+            sockaddr_in6 addr{};
+            addr.sin6_family = AF_INET6;
+            addr.sin6_addr = in6addr_any;
+            addr.sin6_port = htons(port);
+            if (::bind(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(fd_, 64) != 0) {
+                int err = errno;
+                ::close(fd_);
+                throw std::runtime_error("cannot listen on port " + std::to_string(port) + ": " + std::strerror(err));
+            }
+            socklen_t len = sizeof(addr);
+            getsockname(fd_, reinterpret_cast<sockaddr*>(&addr), &len);
+            port_ = ntohs(addr.sin6_port);
+        }
+        ~Listener() { ::close(fd_); }
+
+        Listener(const Listener&) = delete;
+        Listener& operator=(const Listener&) = delete;
+
+        uint16_t port() const { return port_; }
+
+        Connection accept() {
+            for (;;) {
+                int fd = ::accept(fd_, nullptr, nullptr);
+                if (fd >= 0) return Connection(fd);
+                if (errno != EINTR) {
+                    throw std::runtime_error(std::string("accept failed: ") + std::strerror(errno));
+                }
+            }
+        }
+
+    private:
+        int fd_ = -1;
+        uint16_t port_ = 0;
+    };
+
+    /**
+     * 连接服务器；服务器尚未监听时每100毫秒重试，直到 timeout_s 秒
+     */
+    static Connection connect(const std::string& host, uint16_t port, double timeout_s = 30.0) {
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* addrs = nullptr;
+        int rc = getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addrs);
+        if (rc != 0) {
+            throw std::runtime_error("cannot resolve " + host + ": " + gai_strerror(rc));
+        }
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(timeout_s);
+        int err = 0;
+        for (;;) {
+            for (addrinfo* a = addrs; a; a = a->ai_next) {
+                int fd = ::socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+                if (fd < 0) continue;
+                if (::connect(fd, a->ai_addr, a->ai_addrlen) == 0) {
+                    freeaddrinfo(addrs);
+                    return Connection(fd);
+                }
+                err = errno;
+                ::close(fd);
+            }
+            if (std::chrono::steady_clock::now() >= deadline) break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        freeaddrinfo(addrs);
+        throw std::runtime_error("cannot connect to " + host + ":" + std::to_string(port) + ": " + std::strerror(err));
+    }
+
+    /**
+     * 解析 "HOST:PORT"（IPv6地址写作 "[addr]:PORT"）
+     */
+    static std::pair<std::string, uint16_t> parse_endpoint(const std::string& text) {
+        size_t colon = text.rfind(':');
+        if (colon == std::string::npos || colon + 1 == text.size()) {
+            throw std::invalid_argument("endpoint must be HOST:PORT: " + text);
+        }
+        std::string host = text.substr(0, colon);
+        if (host.size() >= 2 && host.front() == '[' && host.back() == ']') {
+            host = host.substr(1, host.size() - 2);
+        }
+        return {host.empty() ? "localhost" : host, parse_port(text.substr(colon + 1))};
+    }
+
+    static uint16_t parse_port(const std::string& text) {
+        char* end = nullptr;
+        unsigned long port = std::strtoul(text.c_str(), &end, 10);
+        if (text.empty() || *end != '\0' || port > 65535) {
+            throw std::invalid_argument("invalid port: " + text);
+        }
+        return static_cast<uint16_t>(port);
+    }
+};
+
+#endif // TRANSPORT_H
@@ -26,6 +26,129 @@ public:
         return h;
     }
     
+    /**
+     * 稀疏向量带状窗口的起始位置，取值范围 [0, d_1 - w]
+     */
+    static size_t band_position(
+        const uint64_t& k2,
+        const uint64_t& element,
+        size_t dimension,
+        size_t band_width
+    ) {
+        uint64_t h_pos = hash_partition(k2, element);
+        return h_pos % (dimension - band_width + 1);
+    }
+
+    /**
+     * 带状窗口系数位图的第t个64位字（系数 64t .. 64t+63）
+     * 每个字是一次独立的带密钥哈希（密钥 k2 + (t+1)·kBandKeyStep），一个窗口共 ceil(w/64) 次，
+     * w <= 128 时为两次，不再逐位哈希；hash_partition 之后多一轮乘法-移位混合，使字内各位相互独立
+     */
+    static uint64_t band_word(const uint64_t& k2, const uint64_t& element, size_t t) {
+        uint64_t h = hash_partition(k2 + (t + 1) * kBandKeyStep, element);
+        h *= kBandMix;
+        h ^= h >> 31;
+        return h;
+    }
+
+    /**
+     * 稀疏向量带状窗口内的w个0/1系数，写入 window[0..w)（与 band_bits 的位一致）
+     */
+    template <typename T>
+    static void band_coefficients(
+        const uint64_t& k2,
+        const uint64_t& element,
+        size_t band_width,
+        T* window
+    ) {
+        for (size_t t = 0; t * 64 < band_width; t++) {
+            uint64_t word = band_word(k2, element, t);
+            size_t count = std::min<size_t>(64, band_width - t * 64);
+            for (size_t i = 0; i < count; i++) {
+                window[t * 64 + i] = static_cast<T>((word >> i) & 1);
+            }
+        }
+    }
+
+    /**
+     * 稀疏向量带状窗口的位打包形式：第i个系数存放在 words[i/64] 的第 i%64 位
+     * words 长度为 ceil(w/64)，整体覆盖写入（最后一个字中超出w的位为0）
+     */
+    static void band_bits(
+        const uint64_t& k2,
+        const uint64_t& element,
+        size_t band_width,
+        uint64_t* words
+    ) {
+        const size_t num_words = (band_width + 63) / 64;
+        for (size_t t = 0; t < num_words; t++) {
+            words[t] = band_word(k2, element, t);
+        }
+        words[num_words - 1] &= tail_mask(band_width);
+    }
+
+    /**
+     * 批量哈希：out[i] = hash_partition(k1, elements[i])
+     * 以 kHashLanes 个元素为一组在向量上计算（-march=native 下为 AVX2/AVX-512 指令），尾部逐个计算
+     */
+    static void hash_partition_batch(uint64_t k1, const uint64_t* elements, size_t n, uint64_t* out) {
+        const size_t vector_end = n - n % kHashLanes;
+        size_t i = 0;
+        for (; i < vector_end; i += kHashLanes) {
+            HashLanes h;
+            std::memcpy(&h, elements + i, sizeof(h));
+            h ^= k1;
+            mix(h);
+            std::memcpy(out + i, &h, sizeof(h));
+        }
+        for (; i < n; i++) {
+            out[i] = hash_partition(k1, elements[i]);
+        }
+    }
+
+    /**
+     * 批量PRF：out[i] = prf_value(key, inputs[i])
+     */
+    static void prf_value_batch(uint64_t key, const uint64_t* inputs, size_t n, uint64_t* out) {
+        hash_partition_batch(key, inputs, n, out);
+    }
+
+    /**
+     * 批量位图：n 个元素的窗口位图连续写入 rows（每个元素 ceil(w/64) 个字，与 band_bits 一致）
+     * 每组 kHashLanes 个元素对每个字t做一次向量化的带密钥哈希，与 band_word 逐位相同
+     */
+    static void band_bits_batch(
+        uint64_t k2,
+        const uint64_t* elements,
+        size_t n,
+        size_t band_width,
+        uint64_t* rows
+    ) {
+        const size_t num_words = (band_width + 63) / 64;
+        const uint64_t last_mask = tail_mask(band_width);
+        const size_t vector_end = n - n % kHashLanes;
+        size_t i = 0;
+        for (; i < vector_end; i += kHashLanes) {
+            HashLanes x;
+            std::memcpy(&x, elements + i, sizeof(x));
+            for (size_t t = 0; t < num_words; t++) {
+                HashLanes h = x ^ (k2 + (t + 1) * kBandKeyStep);
+                mix(h);
+                h *= kBandMix;
+                h ^= h >> 31;
+                if (t == num_words - 1) {
+                    h &= last_mask;
+                }
+                for (size_t l = 0; l < kHashLanes; l++) {
+                    rows[(i + l) * num_words + t] = h[l];
+                }
+            }
+        }
+        for (; i < n; i++) {
+            band_bits(k2, elements[i], band_width, rows + i * num_words);
+        }
+    }
+
     /**
      * 生成稀疏向量
      * 模拟RandVector(K_2, x, d_1, w)
@@ -37,15 +160,8 @@ public:
         size_t band_width
     ) {
         std::vector<uint8_t> v(dimension, 0);
-        
-        uint64_t h_pos = hash_partition(k2, element);
-        size_t pos = h_pos % (dimension - band_width + 1);
-        
-        for (size_t i = 0; i < band_width; i++) {
-            uint64_t h = hash_partition(k2 ^ (element + i), element);
-            v[pos + i] = (h % 2);
-        }
-        
+        size_t pos = band_position(k2, element, dimension, band_width);
+        band_coefficients(k2, element, band_width, v.data() + pos);
         return v;
     }
     
@@ -61,43 +177,66 @@ public:
     }
     
     /**
-     * 矩阵转为字节大小（用于计算通信开销）
+     * 矩阵在内存中的字节大小（每个元素一个64位字，用于内存流量与驻留估计）
      */
     static size_t matrix_size_bytes(size_t rows, size_t cols) {
         return rows * cols * 8;
     }
     
+    /**
+     * Z_q 元素紧凑编码的字节数：q < 2^32 时为4字节，否则为8字节
+     */
+    static size_t element_bytes(uint64_t q) {
+        return q <= (1ULL << 32) ? 4 : 8;
+    }
+    
+    /**
+     * 矩阵按 Z_q 元素紧凑编码的字节大小（用于计算通信开销）
+     */
+    static size_t matrix_size_bytes(size_t rows, size_t cols, uint64_t q) {
+        return rows * cols * element_bytes(q);
+    }
+    
+    /**
+     * 稀疏列更新的通信量：每列一个32位分区下标加rows个元素
+     */
+    static size_t column_delta_size_bytes(size_t rows, size_t num_columns, uint64_t q) {
+        return num_columns * (sizeof(uint32_t) + matrix_size_bytes(rows, 1, q));
+    }
+    
     /**
      * 计时类：用于精确测量各阶段耗时
+     * 使用单调的 steady_clock，以纳秒为单位计数；elapsed_ms/us 返回带小数的换算值，
+     * 亚毫秒级的操作不会被截断为0
      */
     class Timer {
     private:
-        std::chrono::high_resolution_clock::time_point start_time;
-        std::chrono::high_resolution_clock::time_point end_time;
+        std::chrono::steady_clock::time_point start_time;
+        std::chrono::steady_clock::time_point end_time;
         
     public:
         Timer() = default;
         
         void start() {
-            start_time = std::chrono::high_resolution_clock::now();
+            start_time = std::chrono::steady_clock::now();
         }
         
         void stop() {
-            end_time = std::chrono::high_resolution_clock::now();
+            end_time = std::chrono::steady_clock::now();
         }
         
-        double elapsed_ms() const {
-            auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+        int64_t elapsed_ns() const {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
                 end_time - start_time
-            );
-            return duration.count();
+            ).count();
         }
         
         double elapsed_us() const {
-            auto duration = std::chrono::duration_cast<std::chrono::microseconds>(
-                end_time - start_time
-            );
-            return duration.count();
+            return elapsed_ns() / 1e3;
+        }
+        
+        double elapsed_ms() const {
+            return elapsed_ns() / 1e6;
         }
     };
     
@@ -106,18 +245,21 @@ public:
     
     /**
      * 在有限域Z_q中进行加法
+     * 前置条件：a, b < q；和小于2q，一次条件减法即可，无需除法
      */
     static uint64_t add_mod(uint64_t a, uint64_t b, uint64_t q) {
-        __uint128_t sum = (__uint128_t)a + (__uint128_t)b;
-        return static_cast<uint64_t>(sum % q);
+        uint64_t s = a + b;
+        bool wrap = (s < a) | (s >= q);
+        return wrap ? s - q : s;
     }
     
     /**
      * 在有限域Z_q中进行减法
+     * 前置条件：a, b < q；借位时加回q即可
      */
     static uint64_t sub_mod(uint64_t a, uint64_t b, uint64_t q) {
-        __uint128_t result = (__uint128_t)a + ((__uint128_t)q - (__uint128_t)b);
-        return static_cast<uint64_t>(result % q);
+        uint64_t d = a - b;
+        return (a < b) ? d + q : d;
     }
     
     /**
@@ -166,6 +308,32 @@ public:
         
         return fast_pow(a, q - 2, q);
     }
+
+
+private:
+    static constexpr size_t kHashLanes = 8;
+    static constexpr uint64_t kHashPrime = 11400714819323198485ULL;
+    static constexpr uint64_t kBandKeyStep = 0x9E3779B97F4A7C15ULL;
+    static constexpr uint64_t kBandMix = 0xBF58476D1CE4E5B9ULL;
+
+    // kHashLanes 个64位通道（GCC/Clang向量扩展，无SIMD时退化为标量）
+    using HashLanes = uint64_t __attribute__((vector_size(kHashLanes * sizeof(uint64_t))));
+
+    /**
+     * hash_partition 的混合步骤在向量上的版本（按引用传递，见 Prg::Stream）
+     */
+    static void mix(HashLanes& h) {
+        h ^= h >> 33;
+        h *= kHashPrime;
+        h ^= h >> 33;
+    }
+
+    /**
+     * w位窗口最后一个字的有效位掩码
+     */
+    static uint64_t tail_mask(size_t band_width) {
+        return (band_width % 64 == 0) ? ~0ULL : (1ULL << (band_width % 64)) - 1;
+    }
 };
 
 #endif // UTILS_H
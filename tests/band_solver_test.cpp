@@ -0,0 +1,144 @@
+/**
+ * BandSolver 正确性测试：与稠密高斯消元（Matrix::gaussian_elimination）对照
+ *
+ * 随机生成带状系统（每行一个宽w的0/1窗口），同时构造稠密系数矩阵交给高斯消元：
+ *   - 相容性以 M · e_gauss == y 为准（相容时高斯消元必给出一个解）
+ *   - BandSolver::solve 的返回值须与之一致
+ *   - 相容时两者的主元列相同、自由变量都取0，解应逐元素相等
+ * 覆盖欠定、方阵与超定系统，以及重复行（右侧相同/不同）和全零行，
+ * 另对每种模运算特化（2^64 - 59、2^32 - 5、Barrett）各跑一遍。
+ */
+
+#include "band_solver.h"
+#include "matrix.h"
+#include "prg.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+struct Case {
+    Matrix::MatrixType M;
+    Matrix::VectorType y;
+    BandSolver::System sys;
+};
+
+/**
+ * m 行、d1 列、带宽 w 的随机系统；duplicates 行复制已有行（一半改写右侧），
+ * zero_rows 行没有系数（右侧随机，通常不相容）
+ */
+Case random_case(Prg::Stream& rng, uint64_t q, size_t m, size_t d1, size_t w,
+                 size_t duplicates, size_t zero_rows) {
+    Case c;
+    c.M = Matrix::MatrixType(m + duplicates + zero_rows, d1, Matrix::Layout::RowMajor);
+    c.sys.reset(d1, w, m + duplicates + zero_rows);
+    std::vector<size_t> starts;
+    std::vector<std::vector<uint64_t>> rows;
+
+    auto add = [&](size_t start, const std::vector<uint64_t>& bits, uint64_t rhs) {
+        const size_t i = c.y.size();
+        uint64_t* row = c.sys.add_row(start, rhs);
+        for (size_t t = 0; t < w; t++) {
+            if ((bits[t / 64] >> (t % 64)) & 1) {
+                row[t / 64] |= 1ULL << (t % 64);
+                c.M(i, start + t) = 1;
+            }
+        }
+        c.y.push_back(rhs);
+    };
+
+    for (size_t i = 0; i < m; i++) {
+        const size_t start = rng.next() % (d1 - w + 1);
+        std::vector<uint64_t> bits(c.sys.words_per_row);
+        for (auto& word : bits) word = rng.next();
+        if (w % 64) bits.back() &= (1ULL << (w % 64)) - 1;
+        starts.push_back(start);
+        rows.push_back(bits);
+        add(start, bits, rng.next() % q);
+    }
+    for (size_t k = 0; k < duplicates; k++) {
+        const size_t src = rng.next() % m;
+        const uint64_t rhs = (k % 2 == 0) ? c.y[src] : (c.y[src] + 1) % q;
+        add(starts[src], rows[src], rhs);
+    }
+    for (size_t k = 0; k < zero_rows; k++) {
+        add(rng.next() % (d1 - w + 1), std::vector<uint64_t>(c.sys.words_per_row, 0), rng.next() % q);
+    }
+    return c;
+}
+
+bool satisfies(const Case& c, const Matrix::VectorType& e, uint64_t q) {
+    for (size_t i = 0; i < c.M.rows(); i++) {
+        uint64_t sum = 0;
+        for (size_t j = 0; j < c.M.cols(); j++) {
+            if (c.M(i, j)) sum = Utils::add_mod(sum, Utils::mul_mod(c.M(i, j), e[j], q), q);
+        }
+        if (sum != c.y[i]) return false;
+    }
+    return true;
+}
+
+struct Shape {
+    size_t m, d1, w, duplicates, zero_rows;
+};
+
+}  // namespace
+
+int main() {
+    const uint64_t moduli[] = {ModArith::Mod64::kModulus, ModArith::Mod32::kModulus,
+                               (1ULL << 61) - 1, 97};
+    const Shape shapes[] = {
+        {40, 64, 16, 0, 0},    // 欠定
+        {64, 64, 16, 0, 0},    // 方阵，通常秩亏
+        {90, 64, 16, 0, 0},    // 超定，通常不相容
+        {50, 80, 70, 0, 0},    // 宽带（两个位图字）
+        {45, 64, 16, 6, 0},    // 重复行：一半相容、一半矛盾
+        {45, 64, 16, 0, 1},    // 全零行
+        {120, 256, 80, 4, 0},
+    };
+    const size_t kTrials = 40;
+
+    Prg::Stream rng(Prg::Key{1, 2, 3, 4, 5, 6, 7, 8}, 0);
+    size_t failures = 0, consistent = 0, inconsistent = 0;
+    for (uint64_t q : moduli) {
+        for (const Shape& shape : shapes) {
+            for (size_t trial = 0; trial < kTrials; trial++) {
+                Case c = random_case(rng, q, shape.m, shape.d1, shape.w, shape.duplicates, shape.zero_rows);
+                Matrix::VectorType expected = Matrix::gaussian_elimination(c.M, c.y, q);
+                const bool expect_ok = satisfies(c, expected, q);
+                Matrix::VectorType result;
+                const bool ok = BandSolver::solve(c.sys, q, result);
+
+                bool pass = ok == expect_ok;
+                if (expect_ok) {
+                    pass = pass && result == expected && satisfies(c, result, q);
+                    consistent++;
+                } else {
+                    inconsistent++;
+                }
+                if (!pass) {
+                    failures++;
+                    std::cerr << "band_solver_test: mismatch q=" << q << " m=" << c.M.rows() << " d1=" << shape.d1
+                              << " w=" << shape.w << " consistent=" << expect_ok << " solver=" << ok << std::endl;
+                }
+            }
+        }
+    }
+
+    // 每类情形都须出现，否则上面的对照没有意义
+    if (consistent == 0 || inconsistent == 0) {
+        std::cerr << "band_solver_test: degenerate sample (" << consistent << " consistent, "
+                  << inconsistent << " inconsistent)" << std::endl;
+        failures++;
+    }
+    if (failures) {
+        std::cerr << "band_solver_test: " << failures << " failures" << std::endl;
+        return 1;
+    }
+    std::cout << "band_solver_test: ok (" << consistent << " consistent, " << inconsistent
+              << " inconsistent)" << std::endl;
+    return 0;
+}
@@ -0,0 +1,150 @@
+/**
+ * ModArith 模运算策略测试：以 __uint128_t % q 为参照
+ *
+ * 对 PseudoMersenne64<59>（2^64 - 59）、PseudoMersenne32<5>（2^32 - 5）与若干 Barrett64 模数
+ * （含 2^64 - 59 本身与 2^64 以下的奇数）检查：
+ *   - add/sub/mul 在边界值（0、1、q-1、q-2 等）与随机已约化输入上
+ *   - reduce 在任意128位输入上（含 (q-1)^2、2^64 - 1、2^128 - 1）
+ *   - mac 惰性累加大量 (q-1)^2 项后一次 reduce，以及累加到 kMacTerms 项上限时不溢出
+ *   - dispatch 选择的特化、inverse 与 batch_inverse
+ */
+
+#include "modarith.h"
+#include "prg.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace {
+
+using u128 = ModArith::u128;
+
+size_t failures = 0;
+
+void check(bool ok, const std::string& what, uint64_t q) {
+    if (!ok) {
+        failures++;
+        if (failures <= 20) {
+            std::cerr << "modarith_test: " << what << " failed for q=" << q << std::endl;
+        }
+    }
+}
+
+template <typename Mod>
+void test_policy(const Mod& mod, Prg::Stream& rng) {
+    const uint64_t q = mod.modulus();
+    std::vector<uint64_t> values = {0, 1, 2, q / 2, q - 2, q - 1};
+    for (size_t i = 0; i < 200; i++) {
+        values.push_back(rng.next() % q);
+    }
+
+    for (uint64_t a : values) {
+        for (uint64_t b : values) {
+            check(mod.add(a, b) == static_cast<uint64_t>((static_cast<u128>(a) + b) % q), "add", q);
+            check(mod.sub(a, b) == static_cast<uint64_t>((static_cast<u128>(a) + q - b) % q), "sub", q);
+            check(mod.mul(a, b) == static_cast<uint64_t>(static_cast<u128>(a) * b % q), "mul", q);
+        }
+    }
+
+    // reduce 接受任意128位整数
+    const u128 all_ones = ~static_cast<u128>(0);
+    std::vector<u128> wide = {0, 1, q - 1, q, static_cast<u128>(q) + 1, ~0ULL,
+                              static_cast<u128>(~0ULL) + 1, static_cast<u128>(q - 1) * (q - 1),
+                              static_cast<u128>(q) * q, all_ones, all_ones - q, static_cast<u128>(1) << 127};
+    for (size_t i = 0; i < 2000; i++) {
+        wide.push_back((static_cast<u128>(rng.next()) << 64) | rng.next());
+    }
+    for (u128 x : wide) {
+        check(mod.reduce(x) == static_cast<uint64_t>(x % q), "reduce", q);
+    }
+
+    // 惰性累加：最坏情况的 (q-1)^2 项与随机项混合
+    for (size_t terms : {1, 2, 1000, 100000}) {
+        u128 acc = 0;
+        uint64_t expected = 0;
+        for (size_t k = 0; k < terms; k++) {
+            uint64_t a = (k % 3 == 0) ? rng.next() % q : q - 1;
+            uint64_t b = (k % 5 == 0) ? rng.next() % q : q - 1;
+            mod.mac(acc, a, b);
+            expected = static_cast<uint64_t>((static_cast<u128>(a) * b % q + expected) % q);
+        }
+        check(mod.reduce(acc) == expected, "mac(" + std::to_string(terms) + " terms)", q);
+    }
+
+    // 项数上限：预置 kMacTerms - 1 个 (q-1)^2 项，再 mac 一项后累加器不得回绕
+    u128 term = 0;
+    mod.mac(term, q - 1, q - 1);
+    u128 acc = term * (Mod::kMacTerms - 1);
+    mod.mac(acc, q - 1, q - 1);
+    check(acc / term == Mod::kMacTerms && acc % term == 0, "mac(kMacTerms) overflow", q);
+    check(mod.reduce(acc) == mod.mul(Mod::kMacTerms % q, mod.mul(q - 1, q - 1)), "mac(kMacTerms)", q);
+}
+
+/**
+ * 模逆与批量求逆（q 为素数）
+ */
+template <typename Mod>
+void test_inverse(const Mod& mod, Prg::Stream& rng) {
+    const uint64_t q = mod.modulus();
+    std::vector<uint64_t> values = {1, 2, q - 1, q - 2};
+    for (size_t i = 0; i < 500; i++) {
+        values.push_back(1 + rng.next() % (q - 1));
+    }
+    check(ModArith::inverse(mod, 0) == 0, "inverse(0)", q);
+    for (uint64_t a : values) {
+        check(mod.mul(a, ModArith::inverse(mod, a)) == 1, "inverse", q);
+    }
+    std::vector<uint64_t> inv = values;
+    ModArith::batch_inverse(mod, inv);
+    for (size_t i = 0; i < values.size(); i++) {
+        check(mod.mul(values[i], inv[i]) == 1, "batch_inverse", q);
+    }
+}
+
+}  // namespace
+
+// 文档中的项数下界
+static_assert(ModArith::Mod64::kMacTerms >= (1ULL << 57), "2^64 - 59 must allow 2^57 mac terms");
+static_assert(ModArith::PseudoMersenne64<(1ULL << 16) - 1>::kMacTerms >= (1ULL << 48) - 1,
+              "C < 2^16 must allow about 2^48 mac terms");
+
+int main() {
+    Prg::Stream rng(Prg::Key{11, 12, 13, 14, 15, 16, 17, 18}, 0);
+
+    test_policy(ModArith::Mod64{}, rng);
+    test_policy(ModArith::Mod32{}, rng);
+    test_policy(ModArith::PseudoMersenne64<(1ULL << 16) - 1>{}, rng);  // C 取上限时 kMacTerms 最小
+    test_inverse(ModArith::Mod64{}, rng);
+    test_inverse(ModArith::Mod32{}, rng);
+
+    // Barrett：与特化相同的模数、2^64 以下的最大奇数、61位素数与小模数
+    const uint64_t barrett_moduli[] = {ModArith::Mod64::kModulus, ModArith::Mod32::kModulus, ~0ULL,
+                                       (1ULL << 63) + 1, (1ULL << 61) - 1, 1000003, 3};
+    for (uint64_t q : barrett_moduli) {
+        test_policy(ModArith::Barrett64(q), rng);
+    }
+    test_inverse(ModArith::Barrett64(ModArith::Mod64::kModulus), rng);
+    test_inverse(ModArith::Barrett64((1ULL << 61) - 1), rng);
+
+    // dispatch 对两个实验模数选择特化，对其余模数使用Barrett
+    auto specialised = [](uint64_t q) {
+        return ModArith::dispatch(q, [](const auto& mod) {
+            using M = std::decay_t<decltype(mod)>;
+            return !std::is_same<M, ModArith::Barrett64>::value;
+        });
+    };
+    check(specialised(ModArith::Mod64::kModulus), "dispatch(2^64-59)", ModArith::Mod64::kModulus);
+    check(specialised(ModArith::Mod32::kModulus), "dispatch(2^32-5)", ModArith::Mod32::kModulus);
+    check(!specialised(97), "dispatch(97)", 97);
+
+    if (failures) {
+        std::cerr << "modarith_test: " << failures << " failures" << std::endl;
+        return 1;
+    }
+    std::cout << "modarith_test: ok" << std::endl;
+    return 0;
+}
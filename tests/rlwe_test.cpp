@@ -0,0 +1,221 @@
+/**
+ * RLWE/RGSW 引擎正确性测试（N = 512，与测试配置的 lwe_dimension 相同）
+ *
+ *   - encrypt/decrypt 往返，密文加减同态
+ *   - 密文 × 明文惰性累加（Accumulator）与负循环卷积 mod t 的参照值比较
+ *   - external_product：RGSW(1) 保持明文、RGSW(0) 得到零；cmux 按选择位取值，
+ *     连续多层 cmux 后仍能正确解密
+ *   - Folder 的完整折叠与按最高位拆分后的两段折叠都选出目标密文
+ *   - CoefficientDecryptor 与完整 decrypt 的对应系数逐个相等
+ */
+
+#include "rlwe.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+size_t failures = 0;
+
+void check(bool ok, const std::string& what) {
+    if (!ok) {
+        failures++;
+        std::cerr << "rlwe_test: " << what << " failed" << std::endl;
+    }
+}
+
+struct Fixture {
+    Rlwe::Context ctx{512};
+    Rlwe::Sampler sampler;
+    Rlwe::SecretKey sk = Rlwe::keygen(ctx, sampler);
+    Prg::Stream rng{Prg::Key{21, 22, 23, 24, 25, 26, 27, 28}, 0};
+
+    std::vector<uint64_t> random_message() {
+        std::vector<uint64_t> m(ctx.n());
+        for (auto& v : m) v = rng.next() % ctx.plain_modulus();
+        return m;
+    }
+
+    Rlwe::Ciphertext encrypt(const std::vector<uint64_t>& m) {
+        std::vector<int64_t> signed_m(m.begin(), m.end());
+        return Rlwe::encrypt(ctx, sk, signed_m.data(), sampler);
+    }
+
+    std::vector<uint64_t> decrypt(const Rlwe::Ciphertext& ct) const {
+        return Rlwe::decrypt(ctx, sk, ct);
+    }
+};
+
+/**
+ * 负循环卷积 x · y mod (X^N + 1, t)，t 为2的幂
+ */
+std::vector<uint64_t> negacyclic_mul(const std::vector<uint64_t>& x, const std::vector<int64_t>& y,
+                                     uint64_t t) {
+    const size_t n = x.size();
+    std::vector<uint64_t> out(n, 0);
+    for (size_t i = 0; i < n; i++) {
+        for (size_t j = 0; j < n; j++) {
+            if (y[j] == 0) continue;
+            uint64_t term = x[i] * static_cast<uint64_t>(y[j]);
+            if (i + j < n) {
+                out[i + j] += term;
+            } else {
+                out[i + j - n] -= term;
+            }
+        }
+    }
+    for (auto& v : out) v &= t - 1;
+    return out;
+}
+
+void test_roundtrip(Fixture& f) {
+    const uint64_t t = f.ctx.plain_modulus();
+    auto m1 = f.random_message();
+    auto m2 = f.random_message();
+    auto c1 = f.encrypt(m1);
+    auto c2 = f.encrypt(m2);
+    check(f.decrypt(c1) == m1, "encrypt/decrypt");
+    check(f.decrypt(Rlwe::encrypt(f.ctx, f.sk, nullptr, f.sampler)) == std::vector<uint64_t>(f.ctx.n(), 0),
+          "encrypt(0)");
+
+    std::vector<uint64_t> sum(m1.size()), diff(m1.size());
+    for (size_t k = 0; k < m1.size(); k++) {
+        sum[k] = (m1[k] + m2[k]) & (t - 1);
+        diff[k] = (m1[k] - m2[k]) & (t - 1);
+    }
+    auto s = c1;
+    Rlwe::add_inplace(f.ctx, s, c2);
+    check(f.decrypt(s) == sum, "add_inplace");
+    auto d = c1;
+    Rlwe::sub_inplace(f.ctx, d, c2);
+    check(f.decrypt(d) == diff, "sub_inplace");
+}
+
+void test_accumulator(Fixture& f) {
+    const size_t n = f.ctx.n();
+    const uint64_t t = f.ctx.plain_modulus();
+    Rlwe::Accumulator acc(f.ctx);
+    std::vector<uint64_t> expected(n, 0);
+    for (size_t term = 0; term < 8; term++) {
+        auto m = f.random_message();
+        std::vector<int64_t> p(n, 0);
+        for (size_t k = 0; k < 16; k++) p[f.rng.next() % n] = static_cast<int64_t>(f.rng.next() % 16);
+        Rlwe::Poly pt = f.ctx.zero_poly();
+        f.ctx.from_signed(p.data(), pt.data());
+        f.ctx.ntt(pt.data());
+        acc.mac(f.encrypt(m), pt.data());
+        auto product = negacyclic_mul(m, p, t);
+        for (size_t k = 0; k < n; k++) expected[k] = (expected[k] + product[k]) & (t - 1);
+    }
+    check(f.decrypt(acc.reduce(f.ctx)) == expected, "Accumulator");
+}
+
+void test_external_product(Fixture& f) {
+    auto m0 = f.random_message();
+    auto m1 = f.random_message();
+    auto c0 = f.encrypt(m0);
+    auto c1 = f.encrypt(m1);
+    auto one = Rlwe::encrypt_rgsw(f.ctx, f.sk, 1, f.sampler);
+    auto zero = Rlwe::encrypt_rgsw(f.ctx, f.sk, 0, f.sampler);
+
+    check(f.decrypt(Rlwe::external_product(f.ctx, one, c0)) == m0, "external_product(RGSW(1))");
+    check(f.decrypt(Rlwe::external_product(f.ctx, zero, c0)) == std::vector<uint64_t>(f.ctx.n(), 0),
+          "external_product(RGSW(0))");
+    check(f.decrypt(Rlwe::cmux(f.ctx, zero, c0, c1)) == m0, "cmux(0)");
+    check(f.decrypt(Rlwe::cmux(f.ctx, one, c0, c1)) == m1, "cmux(1)");
+
+    // 噪声随层数增长：连续12层（超过PIR中折叠树的深度）后仍须正确
+    auto chain = c0;
+    std::vector<uint64_t> expected = m0;
+    for (size_t level = 0; level < 12; level++) {
+        auto other_m = f.random_message();
+        auto other = f.encrypt(other_m);
+        const bool bit = level % 2 == 1;
+        chain = Rlwe::cmux(f.ctx, bit ? one : zero, chain, other);
+        if (bit) expected = other_m;
+    }
+    check(f.decrypt(chain) == expected, "cmux chain");
+}
+
+/**
+ * L = 3、D = 2 的折叠：每位用 ceil(log2 L) 个比特的RGSW密文，低比特在前
+ */
+void test_folder(Fixture& f) {
+    const size_t L = 3, D = 2, bits = 2;
+    std::vector<std::vector<uint64_t>> messages;
+    std::vector<Rlwe::Ciphertext> inputs;
+    for (size_t i = 0; i < L * L; i++) {
+        messages.push_back(f.random_message());
+        inputs.push_back(f.encrypt(messages.back()));
+    }
+    for (size_t target : {size_t(0), size_t(5), L * L - 1}) {
+        const size_t digits[D] = {target / L, target % L};
+        std::vector<std::vector<Rlwe::Rgsw>> digit_bits(D);
+        for (size_t d = 0; d < D; d++) {
+            for (size_t b = 0; b < bits; b++) {
+                digit_bits[d].push_back(Rlwe::encrypt_rgsw(f.ctx, f.sk, (digits[d] >> b) & 1, f.sampler));
+            }
+        }
+
+        Rlwe::Folder whole(f.ctx, digit_bits, L);
+        for (const auto& ct : inputs) whole.push(ct);
+        check(f.decrypt(whole.result()) == messages[target], "Folder (target " + std::to_string(target) + ")");
+
+        // 先按最高位的各取值分别折叠低位，再用最高位折叠各子结果
+        Rlwe::Folder top(f.ctx, digit_bits, L, 0, 1);
+        for (size_t hi = 0; hi < L; hi++) {
+            Rlwe::Folder low(f.ctx, digit_bits, L, 1);
+            for (size_t lo = 0; lo < L; lo++) low.push(inputs[hi * L + lo]);
+            top.push(low.result());
+        }
+        check(f.decrypt(top.result()) == messages[target],
+              "split Folder (target " + std::to_string(target) + ")");
+    }
+}
+
+void test_coefficient_decryptor(Fixture& f) {
+    const size_t n = f.ctx.n();
+    const std::vector<size_t> coeffs = {0, 1, 37, n / 2, n - 1};
+    Rlwe::CoefficientDecryptor decryptor(f.ctx, f.sk, coeffs);
+    auto one = Rlwe::encrypt_rgsw(f.ctx, f.sk, 1, f.sampler);
+
+    // 新鲜密文、同态运算后的密文与外积输出（噪声更大）
+    std::vector<Rlwe::Ciphertext> cts;
+    cts.push_back(f.encrypt(f.random_message()));
+    cts.push_back(Rlwe::encrypt(f.ctx, f.sk, nullptr, f.sampler));
+    auto sum = f.encrypt(f.random_message());
+    Rlwe::add_inplace(f.ctx, sum, cts[0]);
+    cts.push_back(sum);
+    cts.push_back(Rlwe::external_product(f.ctx, one, cts[0]));
+
+    for (const auto& ct : cts) {
+        auto full = f.decrypt(ct);
+        std::vector<uint64_t> partial(coeffs.size());
+        decryptor.decrypt(ct, partial.data());
+        bool ok = true;
+        for (size_t c = 0; c < coeffs.size(); c++) ok = ok && partial[c] == full[coeffs[c]];
+        check(ok, "CoefficientDecryptor");
+    }
+}
+
+}  // namespace
+
+int main() {
+    Fixture f;
+    test_roundtrip(f);
+    test_accumulator(f);
+    test_external_product(f);
+    test_folder(f);
+    test_coefficient_decryptor(f);
+
+    if (failures) {
+        std::cerr << "rlwe_test: " << failures << " failures" << std::endl;
+        return 1;
+    }
+    std::cout << "rlwe_test: ok" << std::endl;
+    return 0;
+}
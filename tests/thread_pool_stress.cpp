@@ -0,0 +1,55 @@
+/**
+ * ThreadPool 压力测试：大量背靠背的小规模 parallel_for
+ *
+ * 每轮的下标数很小，工作线程经常在上一轮结束后才醒来；若迟醒的线程取走下一轮的下标，
+ * 会调用错误的任务或丢失 pending 计数（表现为结果错误或挂起，由 ctest 超时捕获）。
+ */
+
+#include "thread_pool.h"
+
+#include <atomic>
+#include <cstddef>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+int main() {
+    const size_t kRounds = 20000;
+    size_t failures = 0;
+
+    for (size_t threads : {2, 4, 8}) {
+        ThreadPool pool(threads);
+        for (size_t round = 0; round < kRounds; round++) {
+            const size_t n = 2 + round % 7;
+            std::vector<std::atomic<int>> hits(n);
+            std::atomic<size_t> sum{0};
+            pool.parallel_for(n, [&](size_t i) {
+                hits[i].fetch_add(1);
+                sum.fetch_add(round + i);
+            });
+            bool ok = sum.load() == n * round + n * (n - 1) / 2;
+            for (const auto& h : hits) ok = ok && h.load() == 1;
+            if (!ok) failures++;
+        }
+
+        // 异常在调用线程中重新抛出，之后线程池仍可继续使用
+        bool caught = false;
+        try {
+            pool.parallel_for(3, [](size_t i) {
+                if (i == 1) throw std::runtime_error("task failed");
+            });
+        } catch (const std::runtime_error&) {
+            caught = true;
+        }
+        std::atomic<size_t> after{0};
+        pool.parallel_for(5, [&](size_t) { after.fetch_add(1); });
+        if (!caught || after.load() != 5) failures++;
+    }
+
+    if (failures) {
+        std::cerr << "thread_pool_stress: " << failures << " failed rounds" << std::endl;
+        return 1;
+    }
+    std::cout << "thread_pool_stress: ok" << std::endl;
+    return 0;
+}